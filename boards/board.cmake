@@ -0,0 +1,194 @@
+# Board description (boards/<name>.json) to a generated C header.
+#
+#   include(boards/board.cmake)
+#   phac_generate_board(boards/phac.json ${CMAKE_CURRENT_BINARY_DIR}/generated/phac_board.h)
+#
+# The header defines the pin numbers, counts and per-button tables as
+# constants (see config.h), so nothing board-specific lives in the sources.
+# It is rewritten only when its contents change, and CMake re-runs when the
+# JSON is edited. Needs CMake 3.19 for string(JSON).
+
+function(phac_board_fail json message)
+    message(FATAL_ERROR "${json}: ${message}")
+endfunction()
+
+# Claims a GPIO for one function; fails on an out of range or reused pin
+macro(phac_board_claim pin what)
+    if(${pin} LESS 0 OR ${pin} GREATER 29)
+        phac_board_fail(${json} "${what}: GPIO ${pin} does not exist")
+    endif()
+    if(DEFINED used_${pin})
+        phac_board_fail(${json} "${what}: GPIO ${pin} already used by ${used_${pin}}")
+    endif()
+    set(used_${pin} "${what}")
+endmacro()
+
+function(phac_generate_board json header)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${json})
+    file(READ ${json} board)
+
+    string(JSON name GET "${board}" name)
+    get_filename_component(source ${json} NAME)
+
+    # Buttons; bit i of every button state is buttons[i]
+    string(JSON count LENGTH "${board}" buttons)
+    if(count LESS 1 OR count GREATER 16)
+        phac_board_fail(${json} "${count} buttons, 1 to 16 are supported")
+    endif()
+    string(JSON pixels GET "${board}" leds count)
+    string(JSON status GET "${board}" leds status)
+
+    set(defines "")
+    set(pins "")
+    set(leds "")
+    set(keys "")
+    set(gamepad "")
+    set(colors "")
+    set(mask 0)
+    set(status_pixel "")
+    set(role_defines "")
+    math(EXPR last "${count} - 1")
+    foreach(i RANGE ${last})
+        string(JSON button GET "${board}" buttons ${i} name)
+        string(JSON pin GET "${board}" buttons ${i} pin)
+        string(JSON led GET "${board}" buttons ${i} led)
+        string(JSON key GET "${board}" buttons ${i} key)
+        string(JSON pad GET "${board}" buttons ${i} gamepad)
+        string(JSON r GET "${board}" buttons ${i} color 0)
+        string(JSON g GET "${board}" buttons ${i} color 1)
+        string(JSON b GET "${board}" buttons ${i} color 2)
+        string(JSON role ERROR_VARIABLE no_role GET "${board}" buttons ${i} role)
+
+        phac_board_claim(${pin} "button ${button}")
+        if(led GREATER_EQUAL pixels)
+            phac_board_fail(${json} "button ${button}: LED ${led} is past the ${pixels} pixels")
+        endif()
+        if(DEFINED led_${led})
+            phac_board_fail(${json} "button ${button}: LED ${led} already used by button ${led_${led}}")
+        endif()
+        set(led_${led} ${button})
+        if(pad GREATER 31)
+            phac_board_fail(${json} "button ${button}: gamepad button ${pad} is past 31")
+        endif()
+        if(DEFINED pad_${pad})
+            phac_board_fail(${json} "button ${button}: gamepad button ${pad} already used by button ${pad_${pad}}")
+        endif()
+        set(pad_${pad} ${button})
+        if(button STREQUAL status)
+            set(status_pixel ${led})
+        endif()
+        if(NOT no_role)
+            if(NOT role MATCHES "^(bootloader|mode_keyboard|mode_gamepad)$")
+                phac_board_fail(${json} "button ${button}: unknown role \"${role}\"")
+            endif()
+            if(DEFINED role_${role})
+                phac_board_fail(${json} "button ${button}: role ${role} already taken by button ${role_${role}}")
+            endif()
+            set(role_${role} ${button})
+            string(TOUPPER ${role} role_macro)
+            string(APPEND role_defines "#define BOARD_${role_macro}_PIN ${pin} // ${button}\n")
+        endif()
+
+        if(i GREATER 0)
+            string(APPEND pins ", ")
+            string(APPEND leds ", ")
+            string(APPEND keys ", ")
+            string(APPEND gamepad ", ")
+            string(APPEND colors ", ")
+        endif()
+        string(APPEND defines "#define BTN_${button} ${pin}\n")
+        string(APPEND pins "${pin}")
+        string(APPEND leds "${led}")
+        string(APPEND keys "${key}")
+        string(APPEND gamepad "${pad}")
+        string(APPEND colors "{${r}, ${g}, ${b}}")
+        math(EXPR mask "${mask} | (1 << ${pin})" OUTPUT_FORMAT HEXADECIMAL)
+    endforeach()
+
+    if(status_pixel STREQUAL "")
+        phac_board_fail(${json} "status LED \"${status}\" is not a button")
+    endif()
+    foreach(role bootloader mode_keyboard mode_gamepad)
+        if(NOT DEFINED role_${role})
+            phac_board_fail(${json} "no button has the role ${role}")
+        endif()
+    endforeach()
+
+    # Encoders; the quadrature PIO program reads pin_a and pin_a + 1
+    string(JSON encoders LENGTH "${board}" encoders)
+    math(EXPR last "${encoders} - 1")
+    set(encoder_defines "")
+    foreach(i RANGE ${last})
+        string(JSON axis MEMBER "${board}" encoders ${i})
+        string(JSON pin_a GET "${board}" encoders ${axis} pin_a)
+        string(JSON pin_b GET "${board}" encoders ${axis} pin_b)
+        math(EXPR next "${pin_a} + 1")
+        if(NOT pin_b EQUAL next)
+            phac_board_fail(${json} "encoder ${axis}: pin_b must be pin_a + 1")
+        endif()
+        phac_board_claim(${pin_a} "encoder ${axis}")
+        phac_board_claim(${pin_b} "encoder ${axis}")
+        string(APPEND encoder_defines "#define ENCODER_${axis}_PIN_A ${pin_a}\n")
+        string(APPEND encoder_defines "#define ENCODER_${axis}_PIN_B ${pin_b}\n")
+    endforeach()
+
+    string(JSON led_pin GET "${board}" leds pin)
+    phac_board_claim(${led_pin} "WS2812 data")
+
+    # Optional parallel strips (ws2812_parallel), on consecutive pins
+    set(strips 0)
+    set(strip_pin_base 0)
+    set(strip_pixels 0)
+    string(JSON strips_type ERROR_VARIABLE no_strips TYPE "${board}" strips)
+    if(NOT no_strips)
+        string(JSON strips GET "${board}" strips count)
+        string(JSON strip_pin_base GET "${board}" strips pin_base)
+        string(JSON strip_pixels GET "${board}" strips pixels)
+        if(strips LESS 1 OR strips GREATER 8)
+            phac_board_fail(${json} "${strips} strips, 1 to 8 are supported")
+        endif()
+        if(strip_pixels LESS 1 OR strip_pixels GREATER 64)
+            phac_board_fail(${json} "${strip_pixels} pixels per strip, 1 to 64 are supported")
+        endif()
+        math(EXPR last "${strips} - 1")
+        foreach(i RANGE ${last})
+            math(EXPR pin "${strip_pin_base} + ${i}")
+            phac_board_claim(${pin} "strip ${i}")
+        endforeach()
+    endif()
+
+    file(CONFIGURE OUTPUT ${header} @ONLY CONTENT
+"// Generated from boards/${source} by boards/board.cmake; edit the JSON.
+#ifndef PHAC_BOARD_H
+#define PHAC_BOARD_H
+
+#define BOARD_NAME \"${name}\"
+
+// Buttons, in state bit order
+#define BUTTON_COUNT ${count}
+${defines}#define BUTTON_PIN_MASK ${mask}u
+
+// Held at power-up: enter the bootloader, or switch the USB mode
+${role_defines}
+// Initialisers for the per-button tables in config.h
+#define BOARD_BUTTON_PINS {${pins}}
+#define BOARD_BUTTON_LEDS {${leds}}
+#define BOARD_KEYMAP_KEYBOARD {${keys}}
+#define BOARD_KEYMAP_GAMEPAD {${gamepad}}
+#define BOARD_BUTTON_COLORS {${colors}}
+
+// Encoders
+${encoder_defines}
+// WS2812 chain
+#define WS2812_PIN ${led_pin}
+#define NUM_PIXELS ${pixels}
+#define STATUS_PIXEL ${status_pixel} // ${status}
+
+// Parallel strips; WS2812_STRIPS is 0 without a \"strips\" entry
+#define WS2812_STRIPS ${strips}
+#define WS2812_STRIPS_PIN_BASE ${strip_pin_base}
+#define WS2812_STRIP_PIXELS ${strip_pixels}
+
+#endif
+")
+endfunction()
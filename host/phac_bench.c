@@ -0,0 +1,345 @@
+// Host benchmarks for the input-to-report hot path and LED encoding.
+//
+//   phac_bench [--min-ms N] [filter]
+//
+// Every case prints one JSON object per line:
+//   {"bench":"debounce_update","case":"chatter_7","iters":...,"ns_per_op":...,
+//    "ops_per_s":...,"items_per_op":...}
+// items_per_op is the work unit of the case (keys, pixels, ...), so
+// throughput per item is ops_per_s * items_per_op. Cases run on wall-clock
+// time against the simulated hardware, whose clock only moves where a case
+// advances it. Build with CMAKE_BUILD_TYPE=Release for meaningful numbers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim/sim.h"
+#include "config.h"
+#include "modules/debounce/debounce.h"
+#include "modules/encoder/ec11.h"
+#include "modules/remap/remap.h"
+#include "modules/action/action.h"
+#include "modules/report/report.h"
+#include "modules/rgb/ws2812.h"
+#include "modules/rgb/effects.h"
+
+#define BENCH_DEFAULT_MIN_MS 200
+
+typedef void (*bench_fn)(uint32_t iter);
+
+static uint64_t min_ns = BENCH_DEFAULT_MIN_MS * 1000000ull;
+static const char *filter;
+
+static DebounceState debounce;
+static EC11_Encoder encoder_x, encoder_y;
+static uint bench_keys;
+static volatile uint32_t sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Doubles the batch size until a batch takes min_ns, then reports that batch
+static void run(const char *bench, const char *variant, uint items, bench_fn fn)
+{
+    char name[96];
+    snprintf(name, sizeof(name), "%s/%s", bench, variant);
+    if (filter && !strstr(name, filter))
+        return;
+
+    uint64_t iters = 16;
+    uint64_t elapsed;
+    for (;;)
+    {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iters; i++)
+            fn((uint32_t)i);
+        elapsed = now_ns() - start;
+        if (elapsed >= min_ns || iters >= (1ull << 40))
+            break;
+        iters *= 2;
+    }
+
+    double ns_per_op = (double)elapsed / iters;
+    printf("{\"bench\":\"%s\",\"case\":\"%s\",\"iters\":%llu,\"ns_per_op\":%.2f,\"ops_per_s\":%.0f,\"items_per_op\":%u}\n",
+           bench, variant, (unsigned long long)iters, ns_per_op, 1e9 / ns_per_op, items);
+    fflush(stdout);
+}
+
+// Fresh simulated hardware and firmware state for each group
+static void setup(void)
+{
+    sim_reset();
+    debounce_init(&debounce);
+    ec11_init(&encoder_x, ENCODER_X_PIN_A, ENCODER_X_PIN_B, NULL, NULL);
+    ec11_init(&encoder_y, ENCODER_Y_PIN_A, ENCODER_Y_PIN_B, NULL, NULL);
+    ws2812_init();
+    effects_init(board_button_led_map);
+    remap_init();
+    action_init();
+    report_reset();
+}
+
+static void set_keys(uint count, bool pressed)
+{
+    for (uint i = 0; i < count; i++)
+        sim_gpio_set(board_button_pins[i], !pressed);
+}
+
+//--------------------------------------------------------------------+
+// Debounce
+//--------------------------------------------------------------------+
+static void debounce_steady(uint32_t iter)
+{
+    debounce_update(&debounce);
+}
+
+// Contacts flip on every scan, so the filter never settles
+static void debounce_chatter(uint32_t iter)
+{
+    set_keys(bench_keys, iter & 1);
+    debounce_update(&debounce);
+}
+
+// Clean press and release every 64 scans, 100us apart
+static void debounce_cycle(uint32_t iter)
+{
+    if ((iter & 63) == 0)
+        set_keys(bench_keys, iter & 64);
+    sim_advance_us(100);
+    debounce_update(&debounce);
+}
+
+static void bench_debounce(void)
+{
+    static const uint key_counts[] = {1, 4, BUTTON_COUNT};
+    static const struct
+    {
+        const char *name;
+        DebounceMode mode;
+    } modes[] = {{"debounce_update", ASYM_EAGER_DEFER_PK}, {"debounce_update_none", DEBOUNCE_NONE}};
+    char variant[32];
+
+    for (uint m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        setup();
+        debounce_set_mode(&debounce, modes[m].mode);
+        run(modes[m].name, "idle", BUTTON_COUNT, debounce_steady);
+
+        set_keys(BUTTON_COUNT, true);
+        sim_advance_us(20000);
+        run(modes[m].name, "held", BUTTON_COUNT, debounce_steady);
+
+        for (uint k = 0; k < sizeof(key_counts) / sizeof(key_counts[0]); k++)
+        {
+            bench_keys = key_counts[k];
+            setup();
+            debounce_set_mode(&debounce, modes[m].mode);
+            snprintf(variant, sizeof(variant), "chatter_%u", bench_keys);
+            run(modes[m].name, variant, BUTTON_COUNT, debounce_chatter);
+            snprintf(variant, sizeof(variant), "cycle_%u", bench_keys);
+            run(modes[m].name, variant, BUTTON_COUNT, debounce_cycle);
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// Encoder
+//--------------------------------------------------------------------+
+static void ec11_idle(uint32_t iter)
+{
+    ec11_update(&encoder_x);
+}
+
+// One count per poll; the smoothing queue saturates and stays full
+static void ec11_spin(uint32_t iter)
+{
+    sim_encoder_turn(ENCODER_X_PIN_A, 1);
+    ec11_update(&encoder_x);
+}
+
+// Four counts per poll with a direction change every poll
+static void ec11_reverse(uint32_t iter)
+{
+    sim_encoder_turn(ENCODER_X_PIN_A, (iter & 1) ? -4 : 4);
+    ec11_update(&encoder_x);
+}
+
+static void bench_encoder(void)
+{
+    setup();
+    run("ec11_update", "idle", 1, ec11_idle);
+    run("ec11_update", "spin", 1, ec11_spin);
+    run("ec11_update", "reverse", 1, ec11_reverse);
+}
+
+//--------------------------------------------------------------------+
+// Report building
+//--------------------------------------------------------------------+
+
+// Alternate between two chords so every call builds and sends a report
+static void keyboard_toggle(uint32_t iter)
+{
+    action_process((iter & 1) ? 0x05 : 0x0A, sim_now_us());
+    report_send_keyboard();
+}
+
+static void keyboard_unchanged(uint32_t iter)
+{
+    report_send_keyboard();
+}
+
+static void mouse_motion(uint32_t iter)
+{
+    report_add_mouse_motion(REPORT_AXIS_X, ENCODER_BASE_SENSITIVITY);
+    report_send_mouse();
+}
+
+static void gamepad_report(uint32_t iter)
+{
+    report_add_gamepad_motion(REPORT_AXIS_X, GAMEPAD_SENSITIVITY);
+    report_send_gamepad(iter & 0x7F);
+}
+
+static void bench_report(void)
+{
+    setup();
+    run("report_send_keyboard", "changed", 1, keyboard_toggle);
+    run("report_send_keyboard", "unchanged", 1, keyboard_unchanged);
+    run("report_send_mouse", "motion", 1, mouse_motion);
+    run("report_send_gamepad", "motion", 1, gamepad_report);
+}
+
+//--------------------------------------------------------------------+
+// Remap commands
+//--------------------------------------------------------------------+
+static uint8_t command[64];
+static uint16_t command_len;
+
+static void remap_command(uint32_t iter)
+{
+    sink = remap_process_command(command, command_len);
+}
+
+static void bench_remap(void)
+{
+    setup();
+
+    // 0x01: keyboard keymap
+    command[0] = 0x01;
+    command[1] = BUTTON_COUNT;
+    memcpy(&command[2], default_keymap_keyboard_mode, BUTTON_COUNT);
+    command_len = 2 + BUTTON_COUNT;
+    run("remap_process_command", "keymap", 1, remap_command);
+
+    // 0x03: button colors
+    command[0] = 0x03;
+    command[1] = BUTTON_COUNT * 3;
+    memcpy(&command[2], default_button_colors, BUTTON_COUNT * 3);
+    command_len = 2 + BUTTON_COUNT * 3;
+    run("remap_process_command", "colors", 1, remap_command);
+
+    // 0x04: brightness, which also rebuilds the LED output tables
+    command[0] = 0x04;
+    command[1] = 1;
+    command[2] = 128;
+    command_len = 3;
+    run("remap_process_command", "brightness", 1, remap_command);
+
+    // 0x10: layer 1 actions
+    command[0] = 0x10;
+    command[1] = 1 + BUTTON_COUNT * 2;
+    command[2] = 1;
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        command[3 + i * 2] = 0x00;
+        command[4 + i * 2] = HID_KEY_A + i;
+    }
+    command_len = 2 + command[1];
+    run("remap_process_command", "layer", 1, remap_command);
+
+    // Rejected: length mismatch
+    command[0] = 0x01;
+    command[1] = BUTTON_COUNT - 1;
+    command_len = 2 + BUTTON_COUNT - 1;
+    run("remap_process_command", "invalid", 1, remap_command);
+}
+
+//--------------------------------------------------------------------+
+// LED encoding
+//--------------------------------------------------------------------+
+static uint8_t frame_rgb[NUM_PIXELS * 3];
+
+static void encode_color(uint32_t iter)
+{
+    sink = ws2812_encode_color(iter, iter >> 8, iter >> 16);
+}
+
+static void encode_frame(uint32_t iter)
+{
+    ws2812_begin_frame();
+    ws2812_encode_frame(0, frame_rgb, NUM_PIXELS);
+    ws2812_present();
+}
+
+static void effects_frame(uint32_t iter)
+{
+    effects_invalidate();
+    sim_advance_us(1000);
+    effects_task(sim_now_us());
+}
+
+#if WS2812_DITHER
+static void dither_frame(uint32_t iter)
+{
+    ws2812_present();
+    ws2812_dither_task();
+}
+#endif
+
+static void bench_led(void)
+{
+    setup();
+    for (uint i = 0; i < sizeof(frame_rgb); i++)
+        frame_rgb[i] = (uint8_t)(i * 7);
+
+    run("ws2812_encode_color", "rgb", 1, encode_color);
+    run("ws2812_encode_frame", "full", NUM_PIXELS, encode_frame);
+#if WS2812_DITHER
+    run("ws2812_dither_task", "full", NUM_PIXELS, dither_frame);
+#endif
+
+    effects_set_base(EFFECT_BASE_OFF);
+    run("effects_task", "off", NUM_PIXELS, effects_frame);
+    effects_set_base(EFFECT_BASE_RAINBOW);
+    run("effects_task", "rainbow", NUM_PIXELS, effects_frame);
+    effects_set_base(EFFECT_BASE_BREATHE);
+    run("effects_task", "breathe", NUM_PIXELS, effects_frame);
+
+    // Every button held with ripples running
+    effects_set_base(EFFECT_BASE_RAINBOW);
+    effects_input((1u << BUTTON_COUNT) - 1, sim_now_us());
+    run("effects_task", "rainbow_reactive", NUM_PIXELS, effects_frame);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc)
+            min_ns = strtoull(argv[++i], NULL, 10) * 1000000ull;
+        else
+            filter = argv[i];
+    }
+
+    bench_debounce();
+    bench_encoder();
+    bench_report();
+    bench_remap();
+    bench_led();
+    return 0;
+}
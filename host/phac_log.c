@@ -0,0 +1,127 @@
+// Expands a capture of the deferred UART log (modules/log) back into text.
+//
+//   phac_log [file]            (stdin without a file)
+//
+// file is the raw bytes from the log UART (LOG_UART_TX_PIN, 8N1). One line
+// per message, with the firmware timestamp in seconds; printf() text is
+// reassembled from its TEXT records and printed per line. Records dropped
+// on a full ring show up as a "records lost" line from the gap in the
+// sequence numbers. Bytes that do not start a valid record (a capture
+// started mid-record, line noise) are skipped until the stream resyncs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "modules/log/log.h"
+#include "modules/be/be.h"
+
+#define TEXT_LINE_MAX 256
+
+static const char *const formats[LOG_MESSAGE_COUNT] = {
+#define LOG_ID_FORMAT(id, format) format,
+    LOG_MESSAGES(LOG_ID_FORMAT)
+#undef LOG_ID_FORMAT
+};
+
+static char text[TEXT_LINE_MAX + 1];
+static size_t text_len;
+static uint32_t text_us;
+
+static void print_time(uint32_t us)
+{
+    printf("[%5lu.%06lu] ", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+static void flush_text(void)
+{
+    if (!text_len)
+        return;
+    text[text_len] = '\0';
+    print_time(text_us);
+    printf("%s\n", text);
+    text_len = 0;
+}
+
+static void add_text(const uint8_t *chars, uint32_t us)
+{
+    for (int i = 0; i < 8 && chars[i]; i++)
+    {
+        if (chars[i] == '\r')
+            continue;
+        if (chars[i] == '\n' || text_len == TEXT_LINE_MAX)
+        {
+            flush_text();
+            if (chars[i] == '\n')
+                continue;
+        }
+        if (!text_len)
+            text_us = us;
+        text[text_len++] = (char)chars[i];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f = stdin;
+    if (argc > 1 && !(f = fopen(argv[1], "rb")))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t record[LOG_RECORD_SIZE];
+    size_t have = 0;
+    bool synced = false;
+    uint16_t next_seq = 0;
+    unsigned long records = 0, lost = 0, skipped = 0;
+    int c;
+
+    while ((c = fgetc(f)) != EOF)
+    {
+        record[have++] = (uint8_t)c;
+        if (have < LOG_RECORD_SIZE)
+            continue;
+
+        uint8_t id = record[1];
+        if (record[0] != LOG_SYNC || id >= LOG_MESSAGE_COUNT)
+        {
+            // Slide one byte and look for the next sync
+            memmove(record, record + 1, --have);
+            skipped++;
+            synced = false;
+            continue;
+        }
+        have = 0;
+        records++;
+
+        uint16_t seq = get_be16(record + 2);
+        uint32_t us = get_be32(record + 4);
+        if (synced && seq != next_seq)
+        {
+            flush_text();
+            print_time(us);
+            printf("-- %u records lost --\n", (uint16_t)(seq - next_seq));
+            lost += (uint16_t)(seq - next_seq);
+        }
+        synced = true;
+        next_seq = seq + 1;
+
+        if (id == LOG_TEXT)
+        {
+            add_text(record + 8, us);
+            continue;
+        }
+
+        flush_text();
+        print_time(us);
+        printf(formats[id], (unsigned)get_be32(record + 8), (unsigned)get_be32(record + 12));
+        printf("\n");
+    }
+    flush_text();
+    if (f != stdin)
+        fclose(f);
+
+    fprintf(stderr, "%lu records, %lu lost, %lu bytes skipped\n", records, lost, skipped + have);
+    return 0;
+}
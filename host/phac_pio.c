@@ -0,0 +1,522 @@
+// Runs the real PIO programs from generated/*.pio.h on the cycle-level
+// emulator in sim/pio_emu.c and checks what they put on the pins.
+//
+//   phac_pio [--sys-hz N]
+//
+// ws2812: streams a test frame through the program at several clock
+// dividers, decodes the waveform back into bits and measures every high and
+// low phase against the WS2812B timing windows.
+//
+// ws2812_parallel: runs modules/rgb/ws2812_parallel.c on the simulated HAL,
+// streams the bit planes its DMA wrote through the ws2812_parallel program
+// and decodes every strip's pin back into the pixels that were set, with
+// the same timing windows.
+//
+// quadrature_encoder: drives a Gray-code waveform into the A/B inputs at
+// rising step rates and checks the count the program pushes, reporting the
+// fastest rate each divider decodes without losing steps.
+//
+// Results are printed as one JSON object per line, followed by the
+// emulator's own speed. Exits non-zero if the divider the firmware uses for
+// WS2812 fails either check, if the parallel strips do not decode, or if
+// the firmware's quadrature divider is out of range or cannot keep up with
+// ENCODER_MIN_STEP_RATE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim/pio_emu.h"
+#include "sim/sim.h"
+#include "modules/rgb/ws2812_parallel.h"
+
+#define PICO_NO_HARDWARE 1
+#include "generated/ws2812.pio.h"
+#include "generated/ec11.pio.h"
+
+#define DEFAULT_SYS_HZ 125000000u // clk_sys after SDK start-up
+#define WS2812_FREQ 800000u       // As passed by modules/rgb/ws2812.c
+#define WS2812_PIN 0
+#define WS2812_OFFSET 28 // pio_add_program() fills memory from the top
+#define WS2812_TEST_WORDS 24
+#define PARALLEL_PIN_BASE 12
+#define PARALLEL_STRIPS 4
+#define PARALLEL_PIXELS 8
+#define PARALLEL_OFFSET 28
+#define ENCODER_PIN 4
+#define ENCODER_TEST_STEPS 40
+#define ENCODER_TEST_SIGN -1       // The program counts down while A leads B
+#define ENCODER_MIN_STEP_RATE 1000 // 24-detent EC11 at 10 rev/s, 4 steps a detent
+#define MAX_EDGES 4096
+
+// WS2812B datasheet windows (nominal +-150 ns), in ns
+#define T0H_MIN 250
+#define T0H_MAX 550
+#define T1H_MIN 650
+#define T1H_MAX 950
+#define T0L_MIN 700
+#define T0L_MAX 1000
+#define T1L_MIN 300
+#define T1L_MAX 600
+
+static uint32_t sys_hz = DEFAULT_SYS_HZ;
+static uint64_t emu_ticks;
+static uint64_t emu_ns;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t sm_ticks(const PioEmu *pio)
+{
+    uint64_t ticks = 0;
+    for (int i = 0; i < PIO_EMU_SMS; i++)
+        ticks += pio->sm[i].ticks;
+    return ticks;
+}
+
+static double cycles_to_ns(uint64_t cycles)
+{
+    return cycles * 1e9 / sys_hz;
+}
+
+//--------------------------------------------------------------------+
+// WS2812 bit timing
+//--------------------------------------------------------------------+
+typedef struct
+{
+    uint64_t cycle[MAX_EDGES];
+    bool level[MAX_EDGES];
+    unsigned count;
+} EdgeLog;
+
+typedef struct
+{
+    double min, max;
+} Range;
+
+static void log_edge(uint64_t cycle, uint32_t pins, void *ctx)
+{
+    EdgeLog *log = ctx;
+    if (log->count < MAX_EDGES)
+    {
+        log->cycle[log->count] = cycle;
+        log->level[log->count] = (pins >> WS2812_PIN) & 1;
+        log->count++;
+    }
+}
+
+static void range_add(Range *range, double value)
+{
+    if (value < range->min)
+        range->min = value;
+    if (value > range->max)
+        range->max = value;
+}
+
+static bool range_within(const Range *range, double lo, double hi)
+{
+    return range->min >= lo && range->max <= hi;
+}
+
+// Same configuration as ws2812_program_init(); the first word after every
+// reset gap is the one the strip latches on
+static bool check_ws2812(const char *name, float div)
+{
+    static PioEmu pio;
+    static EdgeLog log;
+    uint32_t words[WS2812_TEST_WORDS];
+
+    for (int i = 0; i < WS2812_TEST_WORDS; i++)
+        words[i] = (uint32_t)(i * 0x9E3779B1u) & 0xFFFFFF00u;
+    words[0] = 0xFFFFFF00u;
+    words[1] = 0x00000000u;
+
+    pio_emu_init(&pio);
+    memset(&log, 0, sizeof(log));
+    pio_emu_load(&pio, ws2812_program_instructions, sizeof(ws2812_program_instructions) / sizeof(uint16_t), WS2812_OFFSET);
+
+    PioEmuConfig c = pio_emu_default_config();
+    c.wrap_target = (WS2812_OFFSET + ws2812_wrap_target) & 0x1F;
+    c.wrap = (WS2812_OFFSET + ws2812_wrap) & 0x1F;
+    c.sideset_count = 1;
+    c.sideset_base = WS2812_PIN;
+    c.out_shift_right = false;
+    c.autopull = true;
+    c.pull_threshold = 24;
+    c.join = PIO_EMU_JOIN_TX;
+    if (!pio_emu_set_clkdiv(&c, div))
+    {
+        printf("{\"check\":\"ws2812_timing\",\"config\":\"%s\",\"clkdiv\":%.3f,\"valid\":false}\n", name, div);
+        return false;
+    }
+
+    pio_emu_set_pindirs(&pio, WS2812_PIN, 1, true);
+    pio_emu_set_trace(&pio, log_edge, &log);
+    pio_emu_sm_start(&pio, 0, WS2812_OFFSET, &c);
+
+    // Keep the FIFO topped up the way the DMA channel does
+    uint64_t start = now_ns();
+    unsigned sent = 0;
+    while (sent < WS2812_TEST_WORDS)
+    {
+        while (sent < WS2812_TEST_WORDS && pio_emu_tx_put(&pio, 0, words[sent]))
+            sent++;
+        pio_emu_run(&pio, 64);
+    }
+    while (pio_emu_tx_level(&pio, 0) || pio.sm[0].osr_count < 24)
+        pio_emu_run(&pio, 64);
+    pio_emu_run(&pio, sys_hz / 10000); // 100 us of reset gap
+    emu_ns += now_ns() - start;
+    emu_ticks += sm_ticks(&pio);
+
+    // Every bit is a rising edge, a falling edge and the next rising edge
+    Range t0h = {1e9, 0}, t0l = {1e9, 0}, t1h = {1e9, 0}, t1l = {1e9, 0}, period = {1e9, 0};
+    unsigned bits = 0, errors = 0;
+    for (unsigned i = 0; i + 1 < log.count; i++)
+    {
+        if (!log.level[i])
+            continue;
+        uint64_t rise = log.cycle[i];
+        uint64_t fall = log.cycle[i + 1];
+        double high = cycles_to_ns(fall - rise);
+        bool last = i + 2 >= log.count;
+        double low = last ? 0 : cycles_to_ns(log.cycle[i + 2] - fall);
+        double bit_ns = high + low;
+
+        // The last bit has no next rising edge; judge it against the one before
+        double ref_ns = last && i >= 2 ? cycles_to_ns(rise - log.cycle[i - 2]) : bit_ns;
+        bool decoded = high > ref_ns / 2;
+        unsigned word = bits / 24;
+        bool expected = word < WS2812_TEST_WORDS && ((words[word] >> (31 - bits % 24)) & 1);
+        if (decoded != expected)
+            errors++;
+
+        if (!last)
+        {
+            range_add(&period, bit_ns);
+            range_add(decoded ? &t1l : &t0l, low);
+        }
+        range_add(decoded ? &t1h : &t0h, high);
+        bits++;
+    }
+
+    bool decoded_ok = bits == WS2812_TEST_WORDS * 24 && errors == 0;
+    bool in_spec = range_within(&t0h, T0H_MIN, T0H_MAX) && range_within(&t1h, T1H_MIN, T1H_MAX) &&
+                   range_within(&t0l, T0L_MIN, T0L_MAX) && range_within(&t1l, T1L_MIN, T1L_MAX);
+
+    printf("{\"check\":\"ws2812_timing\",\"config\":\"%s\",\"clkdiv\":%.3f,\"valid\":true,"
+           "\"bits\":%u,\"bit_errors\":%u,\"bit_ns\":[%.1f,%.1f],"
+           "\"t0h_ns\":[%.1f,%.1f],\"t0l_ns\":[%.1f,%.1f],\"t1h_ns\":[%.1f,%.1f],\"t1l_ns\":[%.1f,%.1f],"
+           "\"decoded\":%s,\"in_spec\":%s}\n",
+           name, pio_emu_clkdiv(&c), bits, errors, period.min, period.max,
+           t0h.min, t0h.max, t0l.min, t0l.max, t1h.min, t1h.max, t1l.min, t1l.max,
+           decoded_ok ? "true" : "false", in_spec ? "true" : "false");
+    return decoded_ok && in_spec;
+}
+
+//--------------------------------------------------------------------+
+// Parallel WS2812 strips
+//--------------------------------------------------------------------+
+typedef struct
+{
+    uint64_t cycle[MAX_EDGES];
+    uint32_t pins[MAX_EDGES];
+    unsigned count;
+} PinLog;
+
+static void log_pins(uint64_t cycle, uint32_t pins, void *ctx)
+{
+    PinLog *log = ctx;
+    if (log->count < MAX_EDGES)
+    {
+        log->cycle[log->count] = cycle;
+        log->pins[log->count] = pins;
+        log->count++;
+    }
+}
+
+// Same configuration as ws2812_parallel_program_init(). Every bit time
+// starts with all strips rising together; each pin then falls early (0) or
+// late (1).
+static bool check_ws2812_parallel(const char *name, float div)
+{
+    static PioEmu pio;
+    static PinLog log;
+    static uint32_t pixels[PARALLEL_STRIPS][PARALLEL_PIXELS];
+    const uint32_t mask = ((1u << PARALLEL_STRIPS) - 1) << PARALLEL_PIN_BASE;
+
+    // The driver, through the simulated HAL
+    sim_reset();
+    ws2812_parallel_init(PARALLEL_PIN_BASE, PARALLEL_STRIPS, PARALLEL_PIXELS, hal_alarm_pool_create(1));
+    for (uint s = 0; s < PARALLEL_STRIPS; s++)
+    {
+        for (uint i = 0; i < PARALLEL_PIXELS; i++)
+        {
+            pixels[s][i] = (uint32_t)((i + 1) * 0x9E3779B1u ^ (s + 1) * 0x7F4A7C15u) & 0xFFFFFF00u;
+            ws2812_parallel_set_pixel(s, i, pixels[s][i]);
+        }
+    }
+    pixels[0][0] = 0xFFFFFF00u;
+    pixels[1][0] = 0x00000000u;
+    ws2812_parallel_set_pixel(0, 0, pixels[0][0]);
+    ws2812_parallel_set_pixel(1, 0, pixels[1][0]);
+    ws2812_parallel_present();
+    sim_advance_us(10000);
+
+    uint plane_count;
+    const uint8_t *planes = sim_ws2812_planes(PARALLEL_PIN_BASE, &plane_count);
+    bool sent = !ws2812_parallel_is_busy() && plane_count == PARALLEL_PIXELS * 24;
+    ws2812_parallel_cleanup();
+
+    pio_emu_init(&pio);
+    memset(&log, 0, sizeof(log));
+    pio_emu_load(&pio, ws2812_parallel_program_instructions,
+                 sizeof(ws2812_parallel_program_instructions) / sizeof(uint16_t), PARALLEL_OFFSET);
+
+    PioEmuConfig c = pio_emu_default_config();
+    c.wrap_target = (PARALLEL_OFFSET + ws2812_parallel_wrap_target) & 0x1F;
+    c.wrap = (PARALLEL_OFFSET + ws2812_parallel_wrap) & 0x1F;
+    c.out_base = PARALLEL_PIN_BASE;
+    c.out_count = PARALLEL_STRIPS;
+    c.out_shift_right = true;
+    c.autopull = true;
+    c.pull_threshold = 32;
+    c.join = PIO_EMU_JOIN_TX;
+    if (!pio_emu_set_clkdiv(&c, div) || !sent)
+    {
+        printf("{\"check\":\"ws2812_parallel\",\"config\":\"%s\",\"clkdiv\":%.3f,\"valid\":false,"
+               "\"plane_bytes\":%u}\n", name, div, plane_count);
+        return false;
+    }
+
+    pio_emu_set_pindirs(&pio, PARALLEL_PIN_BASE, PARALLEL_STRIPS, true);
+    pio_emu_set_trace(&pio, log_pins, &log);
+    pio_emu_sm_start(&pio, 0, PARALLEL_OFFSET, &c);
+
+    // An 8-bit DMA write repeats the byte across the FIFO word
+    uint64_t start = now_ns();
+    unsigned queued = 0;
+    while (queued < plane_count)
+    {
+        while (queued < plane_count && pio_emu_tx_put(&pio, 0, planes[queued] * 0x01010101u))
+            queued++;
+        pio_emu_run(&pio, 64);
+    }
+    while (pio_emu_tx_level(&pio, 0) || pio.sm[0].osr_count < 32)
+        pio_emu_run(&pio, 64);
+    pio_emu_run(&pio, sys_hz / 10000); // 100 us of reset gap
+    emu_ns += now_ns() - start;
+    emu_ticks += sm_ticks(&pio);
+
+    Range t0h = {1e9, 0}, t0l = {1e9, 0}, t1h = {1e9, 0}, t1l = {1e9, 0};
+    unsigned bits = 0, errors = 0;
+    uint64_t last_period = 0;
+    for (unsigned i = 0; i < log.count; i++)
+    {
+        bool rise = (log.pins[i] & mask) == mask && (i == 0 || (log.pins[i - 1] & mask) != mask);
+        if (!rise)
+            continue;
+
+        unsigned next = i + 1;
+        while (next < log.count && !((log.pins[next] & mask) == mask && (log.pins[next - 1] & mask) != mask))
+            next++;
+        uint64_t period = next < log.count ? log.cycle[next] - log.cycle[i] : last_period;
+        last_period = period;
+
+        for (uint s = 0; s < PARALLEL_STRIPS; s++)
+        {
+            uint32_t pin = 1u << (PARALLEL_PIN_BASE + s);
+            unsigned fall = i + 1;
+            while (fall < log.count && (log.pins[fall] & pin))
+                fall++;
+            if (fall >= log.count)
+                break;
+
+            double high = cycles_to_ns(log.cycle[fall] - log.cycle[i]);
+            bool decoded = high > cycles_to_ns(period) / 2;
+            unsigned pixel = bits / 24;
+            bool expected = pixel < PARALLEL_PIXELS && ((pixels[s][pixel] >> (31 - bits % 24)) & 1);
+            if (decoded != expected)
+                errors++;
+
+            range_add(decoded ? &t1h : &t0h, high);
+            if (next < log.count)
+                range_add(decoded ? &t1l : &t0l, cycles_to_ns(log.cycle[next] - log.cycle[fall]));
+        }
+        bits++;
+    }
+
+    bool decoded_ok = bits == PARALLEL_PIXELS * 24 && errors == 0;
+    bool in_spec = range_within(&t0h, T0H_MIN, T0H_MAX) && range_within(&t1h, T1H_MIN, T1H_MAX) &&
+                   range_within(&t0l, T0L_MIN, T0L_MAX) && range_within(&t1l, T1L_MIN, T1L_MAX);
+
+    printf("{\"check\":\"ws2812_parallel\",\"config\":\"%s\",\"clkdiv\":%.3f,\"valid\":true,"
+           "\"strips\":%d,\"plane_bytes\":%u,\"bits\":%u,\"bit_errors\":%u,"
+           "\"t0h_ns\":[%.1f,%.1f],\"t0l_ns\":[%.1f,%.1f],\"t1h_ns\":[%.1f,%.1f],\"t1l_ns\":[%.1f,%.1f],"
+           "\"decoded\":%s,\"in_spec\":%s}\n",
+           name, pio_emu_clkdiv(&c), PARALLEL_STRIPS, plane_count, bits, errors,
+           t0h.min, t0h.max, t0l.min, t0l.max, t1h.min, t1h.max, t1l.min, t1l.max,
+           decoded_ok ? "true" : "false", in_spec ? "true" : "false");
+    return decoded_ok && in_spec;
+}
+
+//--------------------------------------------------------------------+
+// Quadrature decoding
+//--------------------------------------------------------------------+
+static const uint8_t gray[4] = {0x0, 0x1, 0x3, 0x2}; // B:A
+
+static void set_phase(PioEmu *pio, unsigned phase)
+{
+    pio_emu_set_input(pio, ENCODER_PIN, gray[phase & 3] & 1);
+    pio_emu_set_input(pio, ENCODER_PIN + 1, gray[phase & 3] >> 1);
+}
+
+// As quadrature_encoder_get_count(): the program pushes without blocking,
+// so a full RX FIFO holds stale counts. Drain it, then block for a fresh one.
+static int32_t read_count(PioEmu *pio)
+{
+    uint32_t word;
+    while (pio_emu_rx_get(pio, 0, &word))
+        ;
+    while (!pio_emu_rx_get(pio, 0, &word))
+        pio_emu_run(pio, 1);
+    return (int32_t)word;
+}
+
+// Turns forward (A leading) then back again at step_rate; passes if the
+// count follows every step in the expected direction and ends where it
+// started
+static bool decode_at(const PioEmuConfig *c, uint32_t step_rate, int32_t *seen)
+{
+    static PioEmu pio;
+    uint64_t interval = sys_hz / step_rate;
+    unsigned phase = 0;
+    int32_t peak = 0;
+
+    pio_emu_init(&pio);
+    pio_emu_load(&pio, quadrature_encoder_program_instructions,
+                 sizeof(quadrature_encoder_program_instructions) / sizeof(uint16_t), 0);
+    set_phase(&pio, phase);
+    pio_emu_sm_start(&pio, 0, 0, c);
+
+    uint64_t start = now_ns();
+    // Settle on the starting phase before moving
+    pio_emu_run(&pio, interval * 4);
+    int32_t origin = read_count(&pio);
+
+    for (int i = 0; i < ENCODER_TEST_STEPS * 2; i++)
+    {
+        phase += i < ENCODER_TEST_STEPS ? 1 : -1;
+        set_phase(&pio, phase);
+        pio_emu_run(&pio, interval);
+        if (i == ENCODER_TEST_STEPS - 1)
+            peak = read_count(&pio) - origin;
+    }
+    pio_emu_run(&pio, interval * 4);
+    int32_t count = read_count(&pio);
+    emu_ns += now_ns() - start;
+    emu_ticks += sm_ticks(&pio);
+
+    *seen = peak;
+    return peak == ENCODER_TEST_SIGN * ENCODER_TEST_STEPS && count == origin;
+}
+
+// What sm_config_set_clkdiv() programs in a release build: the 1..65536
+// range check is a compiled-out assert, and the integer part is cut to the
+// 16-bit register field.
+static void sdk_set_clkdiv(PioEmuConfig *c, float div)
+{
+    uint32_t whole = (uint32_t)div;
+    c->clkdiv_int = (uint16_t)whole;
+    c->clkdiv_frac = (uint8_t)(uint32_t)((div - (float)whole) * 256.0f);
+}
+
+static bool check_quadrature(const char *name, float div)
+{
+    static const uint32_t rates[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000,
+                                     500000, 1000000, 2000000, 5000000, 10000000};
+
+    // Same configuration as quadrature_encoder_program_init()
+    PioEmuConfig c = pio_emu_default_config();
+    c.wrap_target = quadrature_encoder_wrap_target;
+    c.wrap = quadrature_encoder_wrap;
+    c.in_base = ENCODER_PIN;
+    c.jmp_pin = ENCODER_PIN;
+    c.in_shift_right = false;
+    bool valid = pio_emu_set_clkdiv(&c, div);
+    if (!valid)
+        sdk_set_clkdiv(&c, div);
+
+    uint32_t max_ok = 0, failed_at = 0;
+    int32_t seen = 0;
+    for (unsigned i = 0; i < sizeof(rates) / sizeof(rates[0]) && rates[i] <= sys_hz / 2; i++)
+    {
+        if (!decode_at(&c, rates[i], &seen))
+        {
+            failed_at = rates[i];
+            break;
+        }
+        max_ok = rates[i];
+    }
+
+    printf("{\"check\":\"quadrature_decode\",\"config\":\"%s\",\"clkdiv\":%.1f,\"programmed_clkdiv\":%.3f,"
+           "\"valid\":%s,\"max_step_rate\":%u,\"first_failing_rate\":%u,\"steps_seen_at_failure\":%d,"
+           "\"steps_sent\":%d}\n",
+           name, div, pio_emu_clkdiv(&c), valid ? "true" : "false", max_ok, failed_at, failed_at ? seen : 0,
+           ENCODER_TEST_SIGN * ENCODER_TEST_STEPS);
+    return valid && max_ok >= ENCODER_MIN_STEP_RATE;
+}
+
+// quadrature_encoder_program_init(pio, sm, pin, max_step_rate, debounce, level)
+static float quadrature_div(int max_step_rate, bool debounce, int debounce_level)
+{
+    float div;
+    if (debounce)
+    {
+        div = 1000.0f * debounce_level;
+        if (max_step_rate > 0)
+        {
+            float max_div = (float)sys_hz / (10 * max_step_rate);
+            if (div < max_div)
+                div = max_div;
+        }
+    }
+    else
+        div = max_step_rate == 0 ? 1.0f : (float)sys_hz / (10 * max_step_rate);
+    return div;
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--sys-hz") == 0 && i + 1 < argc)
+            sys_hz = strtoul(argv[++i], NULL, 10);
+    }
+
+    int cycles_per_bit = ws2812_T1 + ws2812_T2 + ws2812_T3;
+    bool firmware_ok = check_ws2812("firmware", (float)sys_hz / ((float)WS2812_FREQ * cycles_per_bit));
+    check_ws2812("div_10", 10.0f);
+    check_ws2812("div_12.5", 12.5f);
+    check_ws2812("div_20", 20.0f);
+    check_ws2812("div_25", 25.0f);
+
+    // ws2812_parallel_program_init(pio, sm, offset, pin_base, pin_count, 800000)
+    int parallel_cycles = ws2812_parallel_T1 + ws2812_parallel_T2 + ws2812_parallel_T3;
+    firmware_ok &= check_ws2812_parallel("firmware", (float)sys_hz / ((float)WS2812_FREQ * parallel_cycles));
+
+    // hal_pico: quadrature_encoder_mechanical_init(pio, sm, pin_a)
+    firmware_ok &= check_quadrature("firmware", quadrature_div(0, true, 3));
+    check_quadrature("max_step_rate_3", quadrature_div(3, true, 3));
+    check_quadrature("debounce_1", quadrature_div(0, true, 1));
+    check_quadrature("div_100", 100.0f);
+    check_quadrature("full_speed", quadrature_div(0, false, 0));
+
+    printf("{\"bench\":\"pio_emu\",\"case\":\"all\",\"sm_clocks\":%llu,\"ns_per_clock\":%.2f,\"clocks_per_s\":%.0f}\n",
+           (unsigned long long)emu_ticks, (double)emu_ns / emu_ticks, emu_ticks * 1e9 / emu_ns);
+    return firmware_ok ? 0 : 1;
+}
@@ -0,0 +1,598 @@
+// Replays a raw input trace through the simulated firmware pipeline
+// (sampling, debounce, action/remap, HID reports) and measures it.
+//
+//   phac_replay [options] trace.bin
+//   phac_replay [options] --synth bounce|spin|mash
+//
+//   --mode keyboard|gamepad  report path to drive (default keyboard)
+//   --settle-us N            how long a raw level must hold to count as a
+//                            transition (default 1000)
+//   --seed N                 seed for the synthetic traces
+//   --write FILE             save the trace that was replayed
+//   --events                 print every button transition as well
+//
+// Traces are the records read out of the firmware over raw HID 0x86,
+// concatenated in the wire format of modules/input/input_trace.h. Bit i of
+// the button field is board_button_pins[i].
+//
+// A raw transition is a pin level that differs from the last stable level
+// and then holds for --settle-us; shorter excursions are bounce. Each raw
+// transition is matched to the debounced transition it caused, and then to
+// the first report on the mode's interface after that; press and release
+// latencies are measured from the first raw edge to that report. Unmatched
+// raw transitions are dropped; unmatched debounced ones are spurious. The
+// summary is one JSON object.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim/sim.h"
+#include "config.h"
+#include "modules/debounce/debounce.h"
+#include "modules/encoder/ec11.h"
+#include "modules/input/input.h"
+#include "modules/input/input_trace.h"
+#include "modules/remap/remap.h"
+#include "modules/action/action.h"
+#include "modules/report/report_task.h"
+#include "modules/sched/sched.h"
+
+#define REPLAY_TICK_US 10
+#define REPLAY_START_US 10000 // Trace time 0 on the simulated clock
+#define REPLAY_TAIL_US 50000  // Run on after the last record
+#define DEFAULT_SETTLE_US 1000
+
+#define ITF_KEYBOARD 0
+#define ITF_MOUSE 1
+#define ITF_GAMEPAD 2
+
+typedef struct
+{
+    uint8_t button;
+    bool level;
+    uint64_t at_us; // Raw: first edge of the burst. Debounced: sample time.
+    uint64_t report_us;
+} Transition;
+
+typedef struct
+{
+    Transition *items;
+    size_t count;
+    size_t capacity;
+} TransitionList;
+
+static DebounceState debounce;
+static EC11_Encoder encoder_x, encoder_y;
+static bool gamepad_mode;
+
+static TransitionList raw_transitions;
+static TransitionList debounced;
+static size_t awaiting_report; // First debounced transition without a report
+
+static uint32_t reports[4];
+static int64_t counts_out[2];
+static int64_t travel_out[2]; // Sum of |delta|
+
+static InputTraceRecord *trace;
+static size_t trace_len;
+static size_t trace_capacity;
+
+static Transition *list_add(TransitionList *list)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->items = realloc(list->items, list->capacity * sizeof(Transition));
+        if (!list->items)
+            abort();
+    }
+    Transition *t = &list->items[list->count++];
+    memset(t, 0, sizeof(*t));
+    return t;
+}
+
+static void trace_add(uint32_t timestamp_us, uint16_t buttons, int8_t dx, int8_t dy)
+{
+    if (trace_len == trace_capacity)
+    {
+        trace_capacity = trace_capacity ? trace_capacity * 2 : 1024;
+        trace = realloc(trace, trace_capacity * sizeof(InputTraceRecord));
+        if (!trace)
+            abort();
+    }
+    trace[trace_len++] = (InputTraceRecord){timestamp_us, buttons, dx, dy};
+}
+
+//--------------------------------------------------------------------+
+// Trace files
+//--------------------------------------------------------------------+
+static bool load_trace(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    uint8_t bytes[INPUT_TRACE_RECORD_SIZE];
+    while (fread(bytes, 1, sizeof(bytes), f) == sizeof(bytes))
+    {
+        InputTraceRecord record;
+        input_trace_decode(bytes, &record);
+        trace_add(record.timestamp_us, record.buttons, record.delta_x, record.delta_y);
+    }
+    fclose(f);
+    return trace_len > 0;
+}
+
+static bool save_trace(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    uint8_t bytes[INPUT_TRACE_RECORD_SIZE];
+    for (size_t i = 0; i < trace_len; i++)
+    {
+        input_trace_encode(&trace[i], bytes);
+        fwrite(bytes, 1, sizeof(bytes), f);
+    }
+    return fclose(f) == 0;
+}
+
+//--------------------------------------------------------------------+
+// Synthetic traces
+//--------------------------------------------------------------------+
+typedef struct
+{
+    uint32_t at_us;
+    int8_t button; // -1 for encoder motion
+    bool level;
+    int8_t dx, dy;
+    uint32_t seq; // Keeps equal timestamps in generation order
+} SynthEdge;
+
+static SynthEdge *edges;
+static size_t edge_count, edge_capacity;
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rng() % (hi - lo + 1);
+}
+
+static void edge_add(uint32_t at_us, int8_t button, bool level, int8_t dx, int8_t dy)
+{
+    if (edge_count == edge_capacity)
+    {
+        edge_capacity = edge_capacity ? edge_capacity * 2 : 1024;
+        edges = realloc(edges, edge_capacity * sizeof(SynthEdge));
+        if (!edges)
+            abort();
+    }
+    edges[edge_count] = (SynthEdge){at_us, button, level, dx, dy, (uint32_t)edge_count};
+    edge_count++;
+}
+
+// A contact closing or opening with a burst of bounces before it settles
+static uint32_t bouncy_edge(uint32_t at_us, int button, bool level, uint max_bounces)
+{
+    uint bounces = rng_range(0, max_bounces);
+    for (uint i = 0; i < bounces; i++)
+    {
+        edge_add(at_us, button, level, 0, 0);
+        at_us += rng_range(10, 300);
+        edge_add(at_us, button, !level, 0, 0);
+        at_us += rng_range(10, 300);
+    }
+    edge_add(at_us, button, level, 0, 0);
+    return at_us;
+}
+
+static void synth_bounce(void)
+{
+    uint32_t t = 1000;
+    for (int button = 0; button < BUTTON_COUNT; button++)
+    {
+        for (int press = 0; press < 4; press++)
+        {
+            t = bouncy_edge(t, button, true, 6) + rng_range(20000, 60000);
+            t = bouncy_edge(t, button, false, 6) + rng_range(20000, 60000);
+        }
+        // One short spike on an idle line
+        edge_add(t, button, true, 0, 0);
+        edge_add(t + 40, button, false, 0, 0);
+        t += 20000;
+    }
+}
+
+static void synth_spin(void)
+{
+    // X ramps up to 20 counts/ms and back, then reverses; Y turns slowly.
+    // Fractions accumulate so every count is emitted once.
+    const uint32_t slot_us = 100, slots = 10000;
+    int32_t acc_x = 0, acc_y = 0;
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        uint32_t phase = i % (slots / 2);
+        int32_t rate = (int32_t)(phase < slots / 4 ? phase : slots / 2 - phase) * 20 * 256 / (slots / 4);
+        acc_x += (i < slots / 2 ? rate : -rate) * (int32_t)slot_us / 1000;
+        acc_y += 256 / 10;
+
+        int8_t dx = (int8_t)(acc_x / 256);
+        int8_t dy = (int8_t)(acc_y / 256);
+        acc_x -= dx * 256;
+        acc_y -= dy * 256;
+        if (dx || dy)
+            edge_add(1000 + i * slot_us, -1, false, dx, dy);
+    }
+}
+
+static void synth_mash(void)
+{
+    // BT-A..D alternating hands, 8ms down and 8ms up, with occasional chords
+    uint32_t t = 1000;
+    for (int i = 0; i < 120; i++)
+    {
+        int button = i % 4;
+        int chord = (i % 7 == 0) ? (button + 2) % 4 : -1;
+        uint32_t down = bouncy_edge(t, button, true, 3);
+        if (chord >= 0)
+            bouncy_edge(t + rng_range(0, 500), chord, true, 3);
+        uint32_t up = down + 8000;
+        bouncy_edge(up, button, false, 3);
+        if (chord >= 0)
+            bouncy_edge(up + rng_range(0, 500), chord, false, 3);
+        t = up + 8000;
+    }
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+    const SynthEdge *x = a, *y = b;
+    if (x->at_us != y->at_us)
+        return x->at_us < y->at_us ? -1 : 1;
+    return x->seq < y->seq ? -1 : 1;
+}
+
+// Fold the edges into records the way the firmware recorder would
+static void edges_to_trace(void)
+{
+    qsort(edges, edge_count, sizeof(SynthEdge), compare_edges);
+
+    uint16_t buttons = 0;
+    trace_add(0, 0, 0, 0);
+    for (size_t i = 0; i < edge_count; i++)
+    {
+        const SynthEdge *e = &edges[i];
+        if (e->button >= 0)
+            buttons = e->level ? buttons | (1u << e->button) : buttons & ~(1u << e->button);
+
+        InputTraceRecord *last = &trace[trace_len - 1];
+        if (last->timestamp_us == e->at_us)
+        {
+            last->buttons = buttons;
+            last->delta_x += e->dx;
+            last->delta_y += e->dy;
+        }
+        else
+            trace_add(e->at_us, buttons, e->dx, e->dy);
+    }
+}
+
+static bool synthesize(const char *kind)
+{
+    if (strcmp(kind, "bounce") == 0)
+        synth_bounce();
+    else if (strcmp(kind, "spin") == 0)
+        synth_spin();
+    else if (strcmp(kind, "mash") == 0)
+        synth_mash();
+    else
+        return false;
+    edges_to_trace();
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// Raw transitions
+//--------------------------------------------------------------------+
+
+// A level counts once it has held for settle_us; anything shorter is part
+// of the burst that started at the first edge after the last stable level
+static void find_raw_transitions(uint32_t settle_us)
+{
+    for (int b = 0; b < BUTTON_COUNT; b++)
+    {
+        bool stable = (trace[0].buttons >> b) & 1;
+        bool level = stable;
+        bool in_burst = false;
+        uint64_t burst_start = 0, level_since = trace[0].timestamp_us;
+
+        for (size_t i = 1; i <= trace_len; i++)
+        {
+            bool end = i == trace_len;
+            bool next = end ? level : (trace[i].buttons >> b) & 1;
+            if (!end && next == level)
+                continue;
+
+            uint64_t now = end ? UINT64_MAX : trace[i].timestamp_us;
+            if (now - level_since >= settle_us)
+            {
+                if (level != stable)
+                {
+                    Transition *t = list_add(&raw_transitions);
+                    t->button = b;
+                    t->level = level;
+                    t->at_us = REPLAY_START_US + (in_burst ? burst_start : level_since);
+                    stable = level;
+                }
+                in_burst = false;
+            }
+            if (end)
+                break;
+
+            if (!in_burst && next != stable)
+            {
+                in_burst = true;
+                burst_start = now;
+            }
+            level = next;
+            level_since = now;
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// Pipeline hooks; the pipeline itself is modules/report/report_task
+//--------------------------------------------------------------------+
+static void on_event(const InputEvent *event, uint32_t prev_state, void *ctx)
+{
+    (void)ctx;
+    counts_out[0] += event->delta_x;
+    counts_out[1] += event->delta_y;
+    travel_out[0] += abs(event->delta_x);
+    travel_out[1] += abs(event->delta_y);
+
+    uint32_t changed = event->btn_state ^ prev_state;
+    for (int b = 0; b < BUTTON_COUNT; b++)
+    {
+        if ((changed >> b) & 1)
+        {
+            Transition *t = list_add(&debounced);
+            t->button = b;
+            t->level = (event->btn_state >> b) & 1;
+            t->at_us = event->timestamp_us;
+        }
+    }
+}
+
+static void hid_task(void *ctx)
+{
+    (void)ctx;
+    report_task_run();
+}
+
+static void on_report(const SimHidReport *report, void *ctx)
+{
+    (void)ctx;
+    reports[report->itf & 3]++;
+    if (report->itf != (gamepad_mode ? ITF_GAMEPAD : ITF_KEYBOARD))
+        return;
+    for (; awaiting_report < debounced.count; awaiting_report++)
+        debounced.items[awaiting_report].report_us = report->timestamp_us;
+}
+
+static void apply_record(const InputTraceRecord *record)
+{
+    for (int b = 0; b < BUTTON_COUNT; b++)
+        sim_gpio_set(board_button_pins[b], !((record->buttons >> b) & 1));
+    if (record->delta_x)
+        sim_encoder_turn(ENCODER_X_PIN_A, record->delta_x);
+    if (record->delta_y)
+        sim_encoder_turn(ENCODER_Y_PIN_A, record->delta_y);
+}
+
+static void replay(void)
+{
+    Scheduler core0, core1;
+
+    sim_reset();
+    sim_hid_set_hook(on_report, NULL);
+
+    debounce_init(&debounce);
+    ec11_init(&encoder_x, ENCODER_X_PIN_A, ENCODER_X_PIN_B, report_encoder_x_callback, NULL);
+    ec11_init(&encoder_y, ENCODER_Y_PIN_A, ENCODER_Y_PIN_B, report_encoder_y_callback, NULL);
+    report_task_init(gamepad_mode ? REPORT_MODE_GAMEPAD : REPORT_MODE_KEYBOARD, &encoder_x, &encoder_y);
+    report_task_set_event_hook(on_event, NULL);
+    input_init(&debounce, &encoder_x, &encoder_y);
+
+    sched_init(&core1);
+    input_start();
+
+    remap_init();
+    action_init();
+
+    sched_init(&core0);
+    sched_add(&core0, "hid", hid_task, NULL, 100, 1);
+
+    uint64_t end_us = REPLAY_START_US + trace[trace_len - 1].timestamp_us + REPLAY_TAIL_US;
+    size_t next = 0;
+    while (sim_now_us() < end_us)
+    {
+        uint64_t now = sim_now_us();
+        while (next < trace_len && REPLAY_START_US + trace[next].timestamp_us <= now)
+            apply_record(&trace[next++]);
+
+        while (sched_run_once(&core0, now) || sched_run_once(&core1, now))
+            ;
+
+        // Step to the next record if it lands inside this tick
+        uint64_t step = now + REPLAY_TICK_US;
+        if (next < trace_len && REPLAY_START_US + trace[next].timestamp_us < step)
+            step = REPLAY_START_US + trace[next].timestamp_us;
+        sim_run_until(step);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Matching and summary
+//--------------------------------------------------------------------+
+typedef struct
+{
+    uint64_t *values;
+    size_t count;
+} Samples;
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void print_samples(const char *name, Samples *s)
+{
+    if (!s->count)
+    {
+        printf("\"%s\":null", name);
+        return;
+    }
+    qsort(s->values, s->count, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < s->count; i++)
+        total += s->values[i];
+    printf("\"%s\":{\"min\":%llu,\"p50\":%llu,\"p99\":%llu,\"max\":%llu,\"mean\":%.1f}", name,
+           (unsigned long long)s->values[0], (unsigned long long)s->values[s->count / 2],
+           (unsigned long long)s->values[(s->count * 99) / 100], (unsigned long long)s->values[s->count - 1],
+           (double)total / s->count);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL, *synth = NULL, *write_path = NULL;
+    uint32_t settle_us = DEFAULT_SETTLE_US;
+    bool print_events = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--synth") == 0 && i + 1 < argc)
+            synth = argv[++i];
+        else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+            gamepad_mode = strcmp(argv[++i], "gamepad") == 0;
+        else if (strcmp(argv[i], "--settle-us") == 0 && i + 1 < argc)
+            settle_us = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            rng_state = strtoul(argv[++i], NULL, 10) | 1;
+        else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc)
+            write_path = argv[++i];
+        else if (strcmp(argv[i], "--events") == 0)
+            print_events = true;
+        else
+            path = argv[i];
+    }
+
+    if (synth ? !synthesize(synth) : (!path || !load_trace(path)))
+    {
+        fprintf(stderr, "usage: phac_replay [--mode keyboard|gamepad] [--settle-us N] [--seed N]\n"
+                        "                   [--write FILE] [--events] (trace.bin | --synth bounce|spin|mash)\n");
+        return 2;
+    }
+    if (write_path && !save_trace(write_path))
+    {
+        fprintf(stderr, "phac_replay: cannot write %s\n", write_path);
+        return 2;
+    }
+
+    find_raw_transitions(settle_us);
+    replay();
+
+    // Both lists are in time order per button; walk them together
+    Samples debounce_latency = {calloc(raw_transitions.count + 1, sizeof(uint64_t)), 0};
+    Samples press_latency = {calloc(raw_transitions.count + 1, sizeof(uint64_t)), 0};
+    Samples release_latency = {calloc(raw_transitions.count + 1, sizeof(uint64_t)), 0};
+    size_t dropped = 0, spurious = 0, raw_edges = 0;
+    int64_t counts_in[2] = {0, 0}, travel_in[2] = {0, 0};
+
+    for (size_t i = 1; i < trace_len; i++)
+        raw_edges += __builtin_popcount(trace[i].buttons ^ trace[i - 1].buttons);
+    for (size_t i = 0; i < trace_len; i++)
+    {
+        counts_in[0] += trace[i].delta_x;
+        counts_in[1] += trace[i].delta_y;
+        travel_in[0] += abs(trace[i].delta_x);
+        travel_in[1] += abs(trace[i].delta_y);
+    }
+
+    for (int b = 0; b < BUTTON_COUNT; b++)
+    {
+        size_t d = 0;
+        for (size_t r = 0; r < raw_transitions.count; r++)
+        {
+            const Transition *raw = &raw_transitions.items[r];
+            if (raw->button != b)
+                continue;
+
+            // Debounced edges before this transition came from bounce or glitches
+            while (d < debounced.count && (debounced.items[d].button != b || debounced.items[d].at_us < raw->at_us))
+            {
+                if (debounced.items[d].button == b)
+                    spurious++;
+                d++;
+            }
+
+            const Transition *match = NULL;
+            if (d < debounced.count && debounced.items[d].level == raw->level)
+                match = &debounced.items[d++];
+            if (!match)
+            {
+                dropped++;
+                if (print_events)
+                    printf("{\"event\":\"dropped\",\"button\":%d,\"level\":%d,\"raw_us\":%llu}\n", b, raw->level,
+                           (unsigned long long)(raw->at_us - REPLAY_START_US));
+                continue;
+            }
+
+            debounce_latency.values[debounce_latency.count++] = match->at_us - raw->at_us;
+            Samples *latency = raw->level ? &press_latency : &release_latency;
+            if (match->report_us)
+                latency->values[latency->count++] = match->report_us - raw->at_us;
+            if (print_events)
+                printf("{\"event\":\"transition\",\"button\":%d,\"level\":%d,\"raw_us\":%llu,"
+                       "\"debounced_us\":%llu,\"report_us\":%lld}\n",
+                       b, raw->level, (unsigned long long)(raw->at_us - REPLAY_START_US),
+                       (unsigned long long)(match->at_us - raw->at_us),
+                       match->report_us ? (long long)(match->report_us - raw->at_us) : -1LL);
+        }
+        for (; d < debounced.count; d++)
+        {
+            if (debounced.items[d].button == b)
+                spurious++;
+        }
+    }
+
+    printf("{\"trace\":\"%s\",\"mode\":\"%s\",\"records\":%zu,\"duration_us\":%lu,\"raw_edges\":%zu,"
+           "\"transitions\":%zu,\"debounced\":%zu,\"dropped\":%zu,\"spurious\":%zu,",
+           synth ? synth : path, gamepad_mode ? "gamepad" : "keyboard", trace_len,
+           (unsigned long)trace[trace_len - 1].timestamp_us, raw_edges, raw_transitions.count,
+           debounced.count, dropped, spurious);
+    print_samples("debounce_latency_us", &debounce_latency);
+    printf(",");
+    print_samples("press_latency_us", &press_latency);
+    printf(",");
+    print_samples("release_latency_us", &release_latency);
+    printf(",\"reports\":{\"keyboard\":%u,\"mouse\":%u,\"gamepad\":%u},"
+           "\"encoder_counts\":[%lld,%lld],\"encoder_counts_delivered\":[%lld,%lld],"
+           "\"encoder_travel\":[%lld,%lld],\"encoder_travel_delivered\":[%lld,%lld],\"input_events_dropped\":%u}\n",
+           reports[ITF_KEYBOARD], reports[ITF_MOUSE], reports[ITF_GAMEPAD],
+           (long long)counts_in[0], (long long)counts_in[1], (long long)counts_out[0], (long long)counts_out[1],
+           (long long)travel_in[0], (long long)travel_in[1], (long long)travel_out[0], (long long)travel_out[1],
+           (unsigned)input_get_dropped());
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Converts records from the firmware event tracer (modules/trace) into
+// Chrome trace event JSON for chrome://tracing or ui.perfetto.dev.
+//
+//   phac_trace [--uart] <file> > trace.json
+//
+// Without --uart, file holds the records from raw HID 0x87 reads back to
+// back. With it, file is a UART capture: "trace <hex>" lines are decoded and
+// every other line is skipped. Each core's records arrive in time order;
+// timestamps are unwrapped per core, merged, and made relative to the first
+// record. One thread per core; spans ('b'/'e') pair by name and arg0, and an
+// end with no begin (its begin was dropped or cleared) is skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "modules/trace/trace.h"
+
+#define MAX_CORES 2
+#define MAX_OPEN 64
+
+typedef struct
+{
+    uint64_t at_us; // Unwrapped
+    size_t seq;     // File order, keeps the sort stable
+    TraceRecord record;
+} Event;
+
+typedef struct
+{
+    const char *name;
+    char phase;
+    const char *arg0;
+    const char *arg1;
+} EventInfo;
+
+static const EventInfo event_info[TRACE_EVENT_COUNT] = {
+#define TRACE_ID_INFO(id, name, phase, arg0, arg1) {name, phase, arg0, arg1},
+    TRACE_EVENTS(TRACE_ID_INFO)
+#undef TRACE_ID_INFO
+};
+
+static Event *events;
+static size_t event_count, event_capacity;
+
+typedef struct
+{
+    const char *name;
+    uint16_t arg0;
+} OpenSpan;
+
+// Open spans, by name and arg0
+static OpenSpan open_spans[MAX_OPEN];
+static size_t open_count;
+
+static void add_record(const uint8_t *bytes)
+{
+    if (event_count == event_capacity)
+    {
+        event_capacity = event_capacity ? event_capacity * 2 : 1024;
+        events = realloc(events, event_capacity * sizeof(Event));
+        if (!events)
+        {
+            fprintf(stderr, "phac_trace: out of memory\n");
+            exit(1);
+        }
+    }
+    Event *event = &events[event_count];
+    trace_decode(bytes, &event->record);
+    event->seq = event_count++;
+}
+
+static bool load_binary(FILE *f)
+{
+    uint8_t bytes[TRACE_RECORD_SIZE];
+    size_t n;
+    while ((n = fread(bytes, 1, sizeof(bytes), f)) == sizeof(bytes))
+        add_record(bytes);
+    if (n)
+        fprintf(stderr, "phac_trace: ignoring %zu trailing bytes\n", n);
+    return true;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool load_uart(FILE *f)
+{
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        const char *p = strstr(line, "trace ");
+        if (!p)
+            continue;
+        p += strlen("trace ");
+
+        uint8_t bytes[TRACE_RECORD_SIZE];
+        bool ok = true;
+        for (int i = 0; i < TRACE_RECORD_SIZE && ok; i++)
+        {
+            int hi = hex_digit(p[2 * i]), lo = hi < 0 ? -1 : hex_digit(p[2 * i + 1]);
+            ok = hi >= 0 && lo >= 0;
+            bytes[i] = (uint8_t)(hi << 4 | lo);
+        }
+        if (ok)
+            add_record(bytes);
+    }
+    return true;
+}
+
+static void unwrap(void)
+{
+    uint32_t last[MAX_CORES] = {0};
+    uint64_t epoch[MAX_CORES] = {0};
+    bool seen[MAX_CORES] = {false};
+
+    for (size_t i = 0; i < event_count; i++)
+    {
+        const TraceRecord *r = &events[i].record;
+        int core = r->core < MAX_CORES ? r->core : 0;
+        if (seen[core] && r->timestamp_us < last[core])
+            epoch[core] += 1ull << 32;
+        seen[core] = true;
+        last[core] = r->timestamp_us;
+        events[i].at_us = epoch[core] + r->timestamp_us;
+    }
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const Event *x = a, *y = b;
+    if (x->at_us != y->at_us)
+        return x->at_us < y->at_us ? -1 : 1;
+    return x->seq < y->seq ? -1 : (x->seq > y->seq ? 1 : 0);
+}
+
+// Returns false for an end whose begin never arrived
+static bool match_span(const EventInfo *info, uint16_t arg0)
+{
+    size_t i = 0;
+    while (i < open_count && !(strcmp(open_spans[i].name, info->name) == 0 && open_spans[i].arg0 == arg0))
+        i++;
+
+    if (info->phase == 'b')
+    {
+        // A begin while the span is open (its end was dropped) reuses the slot
+        if (i == open_count && open_count < MAX_OPEN)
+            open_spans[open_count++] = (OpenSpan){info->name, arg0};
+        return true;
+    }
+
+    if (i == open_count)
+        return false;
+    open_spans[i] = open_spans[--open_count];
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool uart = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--uart") == 0)
+            uart = true;
+        else
+            path = argv[i];
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: phac_trace [--uart] <file>\n");
+        return 2;
+    }
+
+    FILE *f = fopen(path, uart ? "r" : "rb");
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+    uart ? load_uart(f) : load_binary(f);
+    fclose(f);
+
+    unwrap();
+    qsort(events, event_count, sizeof(Event), compare_events);
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"PHAC\"}}");
+    for (int core = 0; core < MAX_CORES; core++)
+        printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"core %d\"}}",
+               core, core);
+
+    size_t unknown = 0, unmatched = 0;
+    uint64_t origin = event_count ? events[0].at_us : 0;
+    for (size_t i = 0; i < event_count; i++)
+    {
+        const TraceRecord *r = &events[i].record;
+        if (r->event >= TRACE_EVENT_COUNT)
+        {
+            unknown++;
+            continue;
+        }
+        const EventInfo *info = &event_info[r->event];
+        if (info->phase != 'i' && !match_span(info, r->arg0))
+        {
+            unmatched++;
+            continue;
+        }
+
+        printf(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%u",
+               info->name, info->name, info->phase, (unsigned long long)(events[i].at_us - origin), r->core);
+        if (info->phase == 'i')
+            printf(",\"s\":\"t\"");
+        else
+            printf(",\"id\":%u", r->arg0);
+
+        printf(",\"args\":{");
+        if (info->arg0)
+            printf("\"%s\":%u", info->arg0, r->arg0);
+        if (info->arg1)
+            printf("%s\"%s\":%d", info->arg0 ? "," : "", info->arg1, (int32_t)r->arg1);
+        printf("}}");
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%zu records, %zu unknown events, %zu unmatched span ends, %zu spans left open\n",
+            event_count, unknown, unmatched, open_count);
+    free(events);
+    return 0;
+}
@@ -0,0 +1,333 @@
+// Runs a scripted session against a simulated USB host that polls every HID
+// interface at bInterval, and measures how stale the delivered reports are
+// under different hid_task()/tud_task() scheduling choices.
+//
+//   phac_usb [--interval-us N] [--jitter-us N] [--seconds N] [--seed N]
+//
+// For every strategy one JSON object is printed with, for the keyboard
+// interface:
+//   age_us    host receive time minus the sample time of the newest input
+//             change the report carries
+//   queue_us  time a report sat in the endpoint before the host took it
+//   changes   debounced button state changes
+//   coalesced changes the host never saw as a report of their own
+//   lost      presses the host never saw at all (pressed and released
+//             between two reports)
+// and, for the mouse interface, how many reports the host took and how
+// many of its polls found nothing to send.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim/sim.h"
+#include "config.h"
+#include "modules/debounce/debounce.h"
+#include "modules/encoder/ec11.h"
+#include "modules/input/input.h"
+#include "modules/remap/remap.h"
+#include "modules/action/action.h"
+#include "modules/report/report_task.h"
+#include "modules/sched/sched.h"
+#include "modules/usb/usb_descriptors.h"
+
+#define TICK_US 5
+#define DEFAULT_SECONDS 5
+#define DEFAULT_JITTER_US 20
+#define MAX_CHANGES 8192
+#define MAX_SCRIPT 8192
+
+typedef struct
+{
+    const char *name;
+    uint32_t usb_period_us;
+    uint32_t hid_period_us;
+    bool send_on_complete; // Also build the next report from the completion callback
+} Strategy;
+
+// The first entry matches main.c
+static const Strategy strategies[] = {
+    {"firmware", 125, 100, false},
+    {"hid_250", 125, 250, false},
+    {"hid_1000", 125, 1000, false},
+    {"usb_1000", 1000, 100, false},
+    {"send_on_complete", 125, 1000, true},
+};
+
+typedef struct
+{
+    uint64_t at_us;
+    uint32_t state;
+} Change;
+
+typedef struct
+{
+    uint64_t at_us;
+    uint8_t pin;
+    bool pressed;
+} ScriptStep;
+
+static uint32_t interval_us = USB_POLLING_INTERVAL * 1000;
+static uint32_t jitter_us = DEFAULT_JITTER_US;
+static uint32_t seconds = DEFAULT_SECONDS;
+static uint32_t rng_state = 1;
+
+static ScriptStep script[MAX_SCRIPT];
+static size_t script_len;
+
+// Per run
+static const Strategy *strategy;
+static DebounceState debounce;
+static EC11_Encoder encoder_x, encoder_y;
+static uint64_t change_us;     // Sample time of the newest state change
+static Change changes[MAX_CHANGES];
+static size_t change_count;
+static Change delivered[MAX_CHANGES]; // Keyboard reports as the host saw them
+static size_t delivered_count;
+static Change in_flight; // Keyboard report queued in the endpoint
+static uint64_t *ages, *queues;
+static size_t age_count;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rng() % (hi - lo + 1);
+}
+
+static int compare_steps(const void *a, const void *b)
+{
+    const ScriptStep *x = a, *y = b;
+    return x->at_us < y->at_us ? -1 : (x->at_us > y->at_us ? 1 : 0);
+}
+
+// Every button taps on its own: gaps of 5-80ms, holds from 0.3ms (shorter
+// than a poll) up to 40ms
+static void build_script(void)
+{
+    uint64_t end_us = (uint64_t)seconds * 1000000;
+    for (int b = 0; b < BUTTON_COUNT; b++)
+    {
+        uint64_t t = 10000 + rng_range(0, 5000);
+        while (t < end_us && script_len + 2 <= MAX_SCRIPT)
+        {
+            uint32_t hold = rng() % 4 == 0 ? rng_range(300, 3000) : rng_range(3000, 40000);
+            script[script_len++] = (ScriptStep){t, board_button_pins[b], true};
+            script[script_len++] = (ScriptStep){t + hold, board_button_pins[b], false};
+            t += hold + rng_range(5000, 80000);
+        }
+    }
+    qsort(script, script_len, sizeof(ScriptStep), compare_steps);
+}
+
+//--------------------------------------------------------------------+
+// Pipeline hooks; the pipeline itself is modules/report/report_task
+//--------------------------------------------------------------------+
+static void on_event(const InputEvent *event, uint32_t prev_state, void *ctx)
+{
+    (void)ctx;
+    if (event->btn_state == prev_state)
+        return;
+    change_us = event->timestamp_us;
+    if (change_count < MAX_CHANGES)
+        changes[change_count++] = (Change){event->timestamp_us, event->btn_state};
+}
+
+static void hid_task(void *ctx)
+{
+    (void)ctx;
+    if (report_task_run())
+        in_flight = (Change){change_us, report_task_buttons()};
+}
+
+static void usb_task(void *ctx)
+{
+    (void)ctx;
+    sim_usb_task();
+}
+
+static void on_complete(uint8_t itf, void *ctx)
+{
+    (void)ctx;
+    if (strategy->send_on_complete && (itf == INTERFACE_KEYBOARD || itf == INTERFACE_MOUSE))
+        hid_task(NULL);
+}
+
+static void on_report(const SimHidReport *report, void *ctx)
+{
+    (void)ctx;
+    if (report->itf != INTERFACE_KEYBOARD)
+        return;
+
+    if (delivered_count < MAX_CHANGES)
+        delivered[delivered_count++] = in_flight;
+    if (in_flight.at_us && age_count < MAX_CHANGES)
+    {
+        ages[age_count] = report->timestamp_us - in_flight.at_us;
+        queues[age_count] = report->timestamp_us - report->queued_us;
+        age_count++;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Measurement
+//--------------------------------------------------------------------+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void print_stats(const char *name, uint64_t *values, size_t count)
+{
+    if (!count)
+    {
+        printf("\"%s\":null", name);
+        return;
+    }
+    qsort(values, count, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += values[i];
+    printf("\"%s\":{\"min\":%llu,\"p50\":%llu,\"p99\":%llu,\"max\":%llu,\"mean\":%.1f}", name,
+           (unsigned long long)values[0], (unsigned long long)values[count / 2],
+           (unsigned long long)values[(count * 99) / 100], (unsigned long long)values[count - 1],
+           (double)total / count);
+}
+
+// A press is seen if some delivered report carries it: a state taken after
+// the press and before the matching release, with the button down
+static size_t count_lost_presses(void)
+{
+    size_t lost = 0;
+    for (size_t i = 0; i < change_count; i++)
+    {
+        uint32_t prev = i ? changes[i - 1].state : 0;
+        uint32_t pressed = changes[i].state & ~prev;
+        for (int b = 0; b < BUTTON_COUNT; b++)
+        {
+            if (!((pressed >> b) & 1))
+                continue;
+
+            uint64_t release_us = UINT64_MAX;
+            for (size_t j = i + 1; j < change_count; j++)
+            {
+                if (!((changes[j].state >> b) & 1))
+                {
+                    release_us = changes[j].at_us;
+                    break;
+                }
+            }
+
+            bool seen = false;
+            for (size_t d = 0; d < delivered_count && !seen; d++)
+                seen = delivered[d].at_us >= changes[i].at_us && delivered[d].at_us < release_us &&
+                       ((delivered[d].state >> b) & 1);
+            if (!seen)
+                lost++;
+        }
+    }
+    return lost;
+}
+
+static void run(const Strategy *s)
+{
+    Scheduler core0, core1;
+
+    strategy = s;
+    change_us = 0;
+    change_count = delivered_count = age_count = 0;
+    in_flight = (Change){0, 0};
+
+    sim_reset();
+    sim_hid_set_hook(on_report, NULL);
+    sim_hid_set_complete_hook(on_complete, NULL);
+    for (uint8_t itf = 0; itf < ITF_NUM_TOTAL; itf++)
+        sim_usb_poll(itf, interval_us, jitter_us);
+
+    debounce_init(&debounce);
+    ec11_init(&encoder_x, ENCODER_X_PIN_A, ENCODER_X_PIN_B, report_encoder_x_callback, NULL);
+    ec11_init(&encoder_y, ENCODER_Y_PIN_A, ENCODER_Y_PIN_B, report_encoder_y_callback, NULL);
+    report_task_init(REPORT_MODE_KEYBOARD, &encoder_x, &encoder_y);
+    report_task_set_event_hook(on_event, NULL);
+    input_init(&debounce, &encoder_x, &encoder_y);
+
+    sched_init(&core1);
+    input_start();
+
+    remap_init();
+    action_init();
+
+    sched_init(&core0);
+    sched_add(&core0, "usb", usb_task, NULL, s->usb_period_us, 0);
+    sched_add(&core0, "hid", hid_task, NULL, s->hid_period_us, 1);
+
+    // Steady encoder motion on X alongside the taps
+    uint64_t end_us = (uint64_t)seconds * 1000000 + 100000;
+    uint64_t next_turn = 10000;
+    size_t next = 0;
+    while (sim_now_us() < end_us)
+    {
+        uint64_t now = sim_now_us();
+        for (; next < script_len && script[next].at_us <= now; next++)
+            sim_gpio_set(script[next].pin, !script[next].pressed);
+        if (now >= next_turn && now < end_us - 100000)
+        {
+            sim_encoder_turn(ENCODER_X_PIN_A, 1);
+            next_turn += 700;
+        }
+
+        while (sched_run_once(&core0, now) || sched_run_once(&core1, now))
+            ;
+        sim_advance_us(TICK_US);
+    }
+
+    SimUsbStats kbd = sim_usb_stats(INTERFACE_KEYBOARD);
+    SimUsbStats mouse = sim_usb_stats(INTERFACE_MOUSE);
+    size_t lost = count_lost_presses();
+
+    printf("{\"strategy\":\"%s\",\"usb_task_us\":%u,\"hid_task_us\":%u,\"send_on_complete\":%s,"
+           "\"interval_us\":%u,\"jitter_us\":%u,\"changes\":%zu,\"keyboard_reports\":%u,"
+           "\"coalesced\":%zu,\"lost\":%zu,",
+           s->name, s->usb_period_us, s->hid_period_us, s->send_on_complete ? "true" : "false",
+           interval_us, jitter_us, change_count, kbd.delivered,
+           change_count > kbd.delivered ? change_count - kbd.delivered : 0, lost);
+    print_stats("age_us", ages, age_count);
+    printf(",");
+    print_stats("queue_us", queues, age_count);
+    printf(",\"keyboard_polls\":%u,\"keyboard_naks\":%u,\"mouse_reports\":%u,\"mouse_naks\":%u}\n",
+           kbd.polls, kbd.naks, mouse.delivered, mouse.naks);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--interval-us") == 0)
+            interval_us = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--jitter-us") == 0)
+            jitter_us = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            seconds = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0)
+            rng_state = strtoul(argv[i + 1], NULL, 10) | 1;
+    }
+    if (jitter_us >= interval_us)
+    {
+        fprintf(stderr, "phac_usb: jitter must be smaller than the interval\n");
+        return 2;
+    }
+
+    ages = calloc(MAX_CHANGES, sizeof(uint64_t));
+    queues = calloc(MAX_CHANGES, sizeof(uint64_t));
+    build_script();
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+        run(&strategies[i]);
+    return 0;
+}
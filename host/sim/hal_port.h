@@ -0,0 +1,45 @@
+#ifndef HAL_PORT_H
+#define HAL_PORT_H
+
+// Host backend: simulated hardware on a virtual clock. Everything runs on
+// one thread; alarms, timers and DMA completions fire from sim_run_until()
+// (see sim.h), so locks only check that they are not taken twice.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+typedef struct hal_lock
+{
+    bool held;
+} hal_lock_t;
+
+typedef struct hal_alarm_pool
+{
+    uint max_timers;
+    uint active;
+} hal_alarm_pool_t;
+
+typedef int32_t hal_alarm_id_t;
+
+typedef struct hal_timer
+{
+    void *user_data;
+    bool (*fn)(struct hal_timer *timer);
+    int64_t period_us;
+    hal_alarm_pool_t *pool;
+} hal_timer_t;
+
+typedef struct
+{
+    uint index;
+} hal_pio_sm_t;
+
+// Checked in every build type, like hard_assert() on the target
+void hal_assert_fail(const char *expr, const char *file, int line);
+#define hal_assert(x) ((x) ? (void)0 : hal_assert_fail(#x, __FILE__, __LINE__))
+
+#define HAL_RAM_FUNC(name) name
+
+#endif
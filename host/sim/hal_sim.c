@@ -0,0 +1,873 @@
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_HID_ITFS 4
+#define SIM_LOCKS 32
+#define SIM_POOLS SIM_HARDWARE_ALARMS
+
+typedef enum
+{
+    EVENT_ALARM,
+    EVENT_TIMEOUT,
+    EVENT_TIMER,
+    EVENT_DMA,
+    EVENT_USB_POLL
+} SimEventKind;
+
+typedef struct
+{
+    bool active;
+    SimEventKind kind;
+    uint64_t at;
+    uint32_t seq; // Keeps equal deadlines in scheduling order
+    uint index;   // Alarm number, DMA channel or HID interface
+    hal_alarm_id_t id;
+    hal_timeout_fn_t timeout_fn;
+    void *ctx;
+    hal_alarm_pool_t *pool;
+    hal_timer_t *timer;
+} SimEvent;
+
+typedef enum
+{
+    SM_FREE,
+    SM_WS2812,
+    SM_WS2812_PARALLEL,
+    SM_QUADRATURE
+} SimSmKind;
+
+typedef struct
+{
+    SimSmKind kind;
+    uint pin;
+    uint pin_count;
+    uint word_us;
+    int32_t count;
+    uint32_t strip[SIM_STRIP_WORDS]; // Parallel: SIM_PARALLEL_STRIP_WORDS per pin
+    uint strip_len;
+    uint8_t planes[SIM_PLANE_BYTES]; // Parallel only
+    uint planes_len;
+    uint32_t frames;
+    uint64_t idle_at; // When the last word has been shifted out
+} SimStateMachine;
+
+typedef struct
+{
+    bool claimed;
+    bool busy;
+    uint sm;
+    uint baud; // Non-zero for a UART channel
+    hal_dma_fn_t done;
+} SimDmaChannel;
+
+// One HID IN endpoint as the host sees it
+typedef struct
+{
+    uint32_t interval_us; // 0: no poller, reports are taken at once
+    uint32_t jitter_us;
+    uint64_t nominal_us; // Poll time before jitter
+    bool loaded;         // A report waits in the endpoint buffer
+    bool completed;      // Taken by the host; completion not yet processed
+    SimHidReport pending;
+    SimUsbStats stats;
+} SimHidEndpoint;
+
+static struct
+{
+    uint64_t now;
+    uint32_t seq;
+    hal_alarm_id_t next_id;
+    SimEvent events[SIM_MAX_EVENTS];
+
+    hal_alarm_fn_t alarm_fns[SIM_HARDWARE_ALARMS];
+    uint alarms_claimed;
+    hal_alarm_pool_t pools[SIM_POOLS];
+    hal_alarm_pool_t default_pool;
+    hal_lock_t locks[SIM_LOCKS];
+    uint locks_claimed;
+
+    bool gpio[SIM_GPIO_COUNT];
+    SimStateMachine sms[SIM_PIO_SMS];
+    SimDmaChannel dma[SIM_DMA_CHANNELS];
+    uint8_t uart[SIM_UART_BYTES];
+    uint uart_len;
+
+    uint8_t flash[PICO_FLASH_SIZE_BYTES];
+    uint32_t flash_writes;
+
+    bool hid_busy[SIM_HID_ITFS];
+    SimHidEndpoint hid_ep[SIM_HID_ITFS];
+    sim_hid_fn hid_fn;
+    void *hid_ctx;
+    sim_hid_complete_fn hid_complete_fn;
+    void *hid_complete_ctx;
+    uint32_t hid_count;
+    bool usb_suspended;
+    uint32_t usb_wakeups;
+    uint32_t rng;
+} sim;
+
+//--------------------------------------------------------------------+
+// Event queue
+//--------------------------------------------------------------------+
+static SimEvent *schedule(SimEventKind kind, uint64_t at)
+{
+    for (int i = 0; i < SIM_MAX_EVENTS; i++)
+    {
+        SimEvent *event = &sim.events[i];
+        if (!event->active)
+        {
+            memset(event, 0, sizeof(*event));
+            event->active = true;
+            event->kind = kind;
+            event->at = at;
+            event->seq = sim.seq++;
+            return event;
+        }
+    }
+    hal_assert(!"sim: event queue full");
+    return NULL;
+}
+
+static SimEvent *find_alarm(uint alarm)
+{
+    for (int i = 0; i < SIM_MAX_EVENTS; i++)
+    {
+        SimEvent *event = &sim.events[i];
+        if (event->active && event->kind == EVENT_ALARM && event->index == alarm)
+            return event;
+    }
+    return NULL;
+}
+
+static SimEvent *next_due(uint64_t target_us)
+{
+    SimEvent *next = NULL;
+    for (int i = 0; i < SIM_MAX_EVENTS; i++)
+    {
+        SimEvent *event = &sim.events[i];
+        if (!event->active || event->at > target_us)
+            continue;
+        if (!next || event->at < next->at || (event->at == next->at && event->seq < next->seq))
+            next = event;
+    }
+    return next;
+}
+
+static uint32_t sim_random(void)
+{
+    // xorshift32
+    sim.rng ^= sim.rng << 13;
+    sim.rng ^= sim.rng >> 17;
+    sim.rng ^= sim.rng << 5;
+    return sim.rng;
+}
+
+// Next IN token: polls stay on their nominal grid, each moved by jitter
+static void schedule_poll(uint8_t itf)
+{
+    SimHidEndpoint *ep = &sim.hid_ep[itf];
+    ep->nominal_us += ep->interval_us;
+
+    int64_t at = (int64_t)ep->nominal_us;
+    if (ep->jitter_us)
+        at += (int64_t)(sim_random() % (2 * ep->jitter_us + 1)) - (int64_t)ep->jitter_us;
+    if (at <= (int64_t)sim.now)
+        at = (int64_t)sim.now + 1;
+    schedule(EVENT_USB_POLL, (uint64_t)at)->index = itf;
+}
+
+static void usb_poll(uint8_t itf)
+{
+    SimHidEndpoint *ep = &sim.hid_ep[itf];
+    ep->stats.polls++;
+    schedule_poll(itf);
+
+    if (!ep->loaded)
+    {
+        ep->stats.naks++;
+        return;
+    }
+
+    ep->loaded = false;
+    ep->completed = true;
+    ep->stats.delivered++;
+    ep->pending.timestamp_us = sim.now;
+    if (sim.hid_fn)
+        sim.hid_fn(&ep->pending, sim.hid_ctx);
+}
+
+static void fire(SimEvent *slot)
+{
+    SimEvent event = *slot;
+    slot->active = false;
+    if (event.at > sim.now)
+        sim.now = event.at;
+
+    switch (event.kind)
+    {
+    case EVENT_ALARM:
+        sim.alarm_fns[event.index](event.index);
+        break;
+
+    case EVENT_TIMEOUT:
+    {
+        int64_t again = event.timeout_fn(event.id, event.ctx);
+        if (again == 0)
+        {
+            event.pool->active--;
+            break;
+        }
+        SimEvent *next = schedule(EVENT_TIMEOUT, again > 0 ? event.at + again : sim.now - again);
+        next->id = event.id;
+        next->timeout_fn = event.timeout_fn;
+        next->ctx = event.ctx;
+        next->pool = event.pool;
+        break;
+    }
+
+    case EVENT_TIMER:
+    {
+        hal_timer_t *timer = event.timer;
+        if (!timer->fn(timer))
+        {
+            timer->pool->active--;
+            break;
+        }
+        uint64_t at = timer->period_us < 0 ? event.at - timer->period_us : sim.now + timer->period_us;
+        schedule(EVENT_TIMER, at)->timer = timer;
+        break;
+    }
+
+    case EVENT_DMA:
+        sim.dma[event.index].busy = false;
+        sim.dma[event.index].done(event.index);
+        break;
+
+    case EVENT_USB_POLL:
+        usb_poll(event.index);
+        break;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Simulation control
+//--------------------------------------------------------------------+
+void sim_reset(void)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.next_id = 1;
+    sim.rng = 0x2545F491;
+    sim.default_pool.max_timers = 16;
+    for (int i = 0; i < SIM_GPIO_COUNT; i++)
+        sim.gpio[i] = true;
+    memset(sim.flash, 0xFF, sizeof(sim.flash));
+}
+
+uint64_t sim_now_us(void)
+{
+    return sim.now;
+}
+
+void sim_run_until(uint64_t target_us)
+{
+    SimEvent *event;
+    while ((event = next_due(target_us)) != NULL)
+        fire(event);
+    if (target_us > sim.now)
+        sim.now = target_us;
+}
+
+void sim_advance_us(uint64_t us)
+{
+    sim_run_until(sim.now + us);
+}
+
+void sim_gpio_set(uint pin, bool level)
+{
+    hal_assert(pin < SIM_GPIO_COUNT);
+    sim.gpio[pin] = level;
+}
+
+void sim_encoder_turn(uint pin_a, int32_t counts)
+{
+    for (int i = 0; i < SIM_PIO_SMS; i++)
+    {
+        if (sim.sms[i].kind == SM_QUADRATURE && sim.sms[i].pin == pin_a)
+            sim.sms[i].count += counts;
+    }
+}
+
+static SimStateMachine *find_strip(uint pin)
+{
+    for (int i = 0; i < SIM_PIO_SMS; i++)
+    {
+        if (sim.sms[i].kind == SM_WS2812 && sim.sms[i].pin == pin)
+            return &sim.sms[i];
+        if (sim.sms[i].kind == SM_WS2812_PARALLEL && pin >= sim.sms[i].pin &&
+            pin < sim.sms[i].pin + sim.sms[i].pin_count)
+            return &sim.sms[i];
+    }
+    return NULL;
+}
+
+const uint32_t *sim_ws2812_words(uint pin, uint *count)
+{
+    SimStateMachine *sm = find_strip(pin);
+    *count = sm ? sm->strip_len : 0;
+    if (sm && sm->kind == SM_WS2812_PARALLEL)
+        return sm->strip + (pin - sm->pin) * SIM_PARALLEL_STRIP_WORDS;
+    return sm ? sm->strip : NULL;
+}
+
+const uint8_t *sim_ws2812_planes(uint pin_base, uint *count)
+{
+    SimStateMachine *sm = find_strip(pin_base);
+    bool parallel = sm && sm->kind == SM_WS2812_PARALLEL && sm->pin == pin_base;
+    *count = parallel ? sm->planes_len : 0;
+    return parallel ? sm->planes : NULL;
+}
+
+uint32_t sim_ws2812_frames(uint pin)
+{
+    SimStateMachine *sm = find_strip(pin);
+    return sm ? sm->frames : 0;
+}
+
+const uint8_t *sim_uart_bytes(uint *count)
+{
+    *count = sim.uart_len;
+    return sim.uart;
+}
+
+uint32_t sim_flash_writes(void)
+{
+    return sim.flash_writes;
+}
+
+void sim_hid_set_hook(sim_hid_fn fn, void *ctx)
+{
+    sim.hid_fn = fn;
+    sim.hid_ctx = ctx;
+}
+
+void sim_hid_set_ready(uint8_t itf, bool ready)
+{
+    hal_assert(itf < SIM_HID_ITFS);
+    sim.hid_busy[itf] = !ready;
+}
+
+uint32_t sim_hid_count(void)
+{
+    return sim.hid_count;
+}
+
+void sim_usb_suspend(bool suspended)
+{
+    sim.usb_suspended = suspended;
+}
+
+uint32_t sim_usb_wakeups(void)
+{
+    return sim.usb_wakeups;
+}
+
+void sim_hid_set_complete_hook(sim_hid_complete_fn fn, void *ctx)
+{
+    sim.hid_complete_fn = fn;
+    sim.hid_complete_ctx = ctx;
+}
+
+void sim_usb_poll(uint8_t itf, uint32_t interval_us, uint32_t jitter_us)
+{
+    hal_assert(itf < SIM_HID_ITFS && jitter_us < interval_us);
+    SimHidEndpoint *ep = &sim.hid_ep[itf];
+    hal_assert(ep->interval_us == 0);
+    ep->interval_us = interval_us;
+    ep->jitter_us = jitter_us;
+    ep->nominal_us = sim.now;
+    schedule_poll(itf);
+}
+
+void sim_usb_task(void)
+{
+    for (uint8_t itf = 0; itf < SIM_HID_ITFS; itf++)
+    {
+        SimHidEndpoint *ep = &sim.hid_ep[itf];
+        if (!ep->completed)
+            continue;
+        ep->completed = false;
+        if (sim.hid_complete_fn)
+            sim.hid_complete_fn(itf, sim.hid_complete_ctx);
+    }
+}
+
+SimUsbStats sim_usb_stats(uint8_t itf)
+{
+    hal_assert(itf < SIM_HID_ITFS);
+    return sim.hid_ep[itf].stats;
+}
+
+//--------------------------------------------------------------------+
+// HAL: assertions, time, GPIO, locks
+//--------------------------------------------------------------------+
+void hal_assert_fail(const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "%s:%d: assertion failed: %s\n", file, line, expr);
+    abort();
+}
+
+uint64_t hal_time_us_64(void)
+{
+    return sim.now;
+}
+
+uint32_t hal_time_us_32(void)
+{
+    return (uint32_t)sim.now;
+}
+
+void hal_idle_until(uint64_t target_us)
+{
+    sim_run_until(target_us);
+}
+
+void hal_fence_release(void)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void hal_fence_acquire(void)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+// The simulation runs both cores' work on one thread as core 0
+uint hal_core_num(void)
+{
+    return 0;
+}
+
+uint32_t hal_irq_save(void)
+{
+    return 0;
+}
+
+void hal_irq_restore(uint32_t save)
+{
+    (void)save;
+}
+
+void hal_gpio_init_input_pullup(uint pin)
+{
+    hal_assert(pin < SIM_GPIO_COUNT);
+    sim.gpio[pin] = true;
+}
+
+bool hal_gpio_get(uint pin)
+{
+    hal_assert(pin < SIM_GPIO_COUNT);
+    return sim.gpio[pin];
+}
+
+uint32_t hal_gpio_get_all(void)
+{
+    uint32_t levels = 0;
+    for (uint pin = 0; pin < SIM_GPIO_COUNT; pin++)
+        levels |= (uint32_t)sim.gpio[pin] << pin;
+    return levels;
+}
+
+hal_lock_t *hal_lock_claim(void)
+{
+    hal_assert(sim.locks_claimed < SIM_LOCKS);
+    return &sim.locks[sim.locks_claimed++];
+}
+
+uint32_t hal_lock_enter(hal_lock_t *lock)
+{
+    hal_lock_enter_isr(lock);
+    return 0;
+}
+
+void hal_lock_exit(hal_lock_t *lock, uint32_t save)
+{
+    (void)save;
+    hal_lock_exit_isr(lock);
+}
+
+void hal_lock_enter_isr(hal_lock_t *lock)
+{
+    // A second taker on one thread would spin forever on hardware
+    hal_assert(!lock->held);
+    lock->held = true;
+}
+
+void hal_lock_exit_isr(hal_lock_t *lock)
+{
+    lock->held = false;
+}
+
+//--------------------------------------------------------------------+
+// HAL: alarms and timers
+//--------------------------------------------------------------------+
+static uint claim_hardware_alarm(void)
+{
+    // The last alarm belongs to the default pool, as on the RP2040
+    hal_assert(sim.alarms_claimed < SIM_HARDWARE_ALARMS - 1);
+    return sim.alarms_claimed++;
+}
+
+uint hal_alarm_claim(hal_alarm_fn_t fn)
+{
+    uint alarm = claim_hardware_alarm();
+    sim.alarm_fns[alarm] = fn;
+    return alarm;
+}
+
+bool hal_alarm_set(uint alarm, uint64_t target_us)
+{
+    hal_alarm_cancel(alarm);
+    if (target_us <= sim.now)
+        return true;
+    schedule(EVENT_ALARM, target_us)->index = alarm;
+    return false;
+}
+
+void hal_alarm_cancel(uint alarm)
+{
+    SimEvent *event = find_alarm(alarm);
+    if (event)
+        event->active = false;
+}
+
+void hal_alarm_force(uint alarm)
+{
+    hal_alarm_cancel(alarm);
+    schedule(EVENT_ALARM, sim.now)->index = alarm;
+}
+
+hal_alarm_pool_t *hal_alarm_pool_create(uint max_timers)
+{
+    hal_alarm_pool_t *pool = &sim.pools[claim_hardware_alarm()];
+    pool->max_timers = max_timers;
+    pool->active = 0;
+    return pool;
+}
+
+static hal_alarm_pool_t *take_pool_slot(hal_alarm_pool_t *pool)
+{
+    if (!pool)
+        pool = &sim.default_pool;
+    if (pool->active >= pool->max_timers)
+        return NULL;
+    pool->active++;
+    return pool;
+}
+
+bool hal_timeout_add(hal_alarm_pool_t *pool, uint32_t delay_us, hal_timeout_fn_t fn, void *ctx)
+{
+    pool = take_pool_slot(pool);
+    if (!pool)
+        return false;
+
+    SimEvent *event = schedule(EVENT_TIMEOUT, sim.now + delay_us);
+    event->id = sim.next_id++;
+    event->timeout_fn = fn;
+    event->ctx = ctx;
+    event->pool = pool;
+    return true;
+}
+
+bool hal_timer_start(hal_alarm_pool_t *pool, int64_t period_us, hal_timer_fn_t fn, void *ctx, hal_timer_t *timer)
+{
+    pool = take_pool_slot(pool);
+    if (!pool)
+        return false;
+
+    timer->user_data = ctx;
+    timer->fn = fn;
+    timer->period_us = period_us;
+    timer->pool = pool;
+    schedule(EVENT_TIMER, sim.now + (period_us < 0 ? -period_us : period_us))->timer = timer;
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// HAL: PIO and DMA
+//--------------------------------------------------------------------+
+static uint claim_sm(SimSmKind kind, uint pin)
+{
+    for (uint i = 0; i < SIM_PIO_SMS; i++)
+    {
+        if (sim.sms[i].kind == SM_FREE)
+        {
+            memset(&sim.sms[i], 0, sizeof(SimStateMachine));
+            sim.sms[i].kind = kind;
+            sim.sms[i].pin = pin;
+            return i;
+        }
+    }
+    hal_assert(!"sim: out of state machines");
+    return 0;
+}
+
+bool hal_pio_ws2812_init(hal_pio_sm_t *sm, uint pin, uint freq)
+{
+    sm->index = claim_sm(SM_WS2812, pin);
+    sim.sms[sm->index].word_us = 24 * 1000000u / freq;
+    return true;
+}
+
+void hal_pio_ws2812_deinit(hal_pio_sm_t *sm)
+{
+    sim.sms[sm->index].kind = SM_FREE;
+}
+
+bool hal_pio_ws2812_parallel_init(hal_pio_sm_t *sm, uint pin_base, uint pin_count, uint freq)
+{
+    hal_assert(pin_count >= 1 && pin_count <= 8);
+    sm->index = claim_sm(SM_WS2812_PARALLEL, pin_base);
+    sim.sms[sm->index].pin_count = pin_count;
+    sim.sms[sm->index].word_us = 24 * 1000000u / freq;
+    return true;
+}
+
+void hal_pio_ws2812_parallel_deinit(hal_pio_sm_t *sm)
+{
+    sim.sms[sm->index].kind = SM_FREE;
+}
+
+void hal_pio_quadrature_init(hal_pio_sm_t *sm, uint pin_a)
+{
+    sm->index = claim_sm(SM_QUADRATURE, pin_a);
+}
+
+int32_t hal_pio_quadrature_count(hal_pio_sm_t *sm)
+{
+    return sim.sms[sm->index].count;
+}
+
+uint hal_pio_tx_level(const hal_pio_sm_t *sm)
+{
+    (void)sm;
+    // Completion is only signalled once the words have been shifted out
+    return 0;
+}
+
+static uint claim_dma(SimDmaChannel config)
+{
+    for (uint chan = 0; chan < SIM_DMA_CHANNELS; chan++)
+    {
+        if (!sim.dma[chan].claimed)
+        {
+            sim.dma[chan] = config;
+            sim.dma[chan].claimed = true;
+            return chan;
+        }
+    }
+    hal_assert(!"sim: out of DMA channels");
+    return 0;
+}
+
+uint hal_dma_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done)
+{
+    return claim_dma((SimDmaChannel){.sm = sm->index, .done = done});
+}
+
+uint hal_dma_byte_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done)
+{
+    hal_assert(sim.sms[sm->index].kind == SM_WS2812_PARALLEL);
+    return claim_dma((SimDmaChannel){.sm = sm->index, .done = done});
+}
+
+uint hal_dma_uart_claim(uint tx_pin, uint baud, hal_dma_fn_t done)
+{
+    hal_assert(tx_pin % 4 == 0 && baud);
+    return claim_dma((SimDmaChannel){.baud = baud, .done = done});
+}
+
+void hal_dma_uart_start(uint chan, const uint8_t *bytes, uint count)
+{
+    SimDmaChannel *dma = &sim.dma[chan];
+    hal_assert(dma->claimed && dma->baud && !dma->busy);
+
+    uint space = SIM_UART_BYTES - sim.uart_len;
+    memcpy(sim.uart + sim.uart_len, bytes, count < space ? count : space);
+    sim.uart_len += count < space ? count : space;
+
+    // 10 bits per byte on the wire
+    dma->busy = true;
+    schedule(EVENT_DMA, sim.now + ((uint64_t)count * 10 * 1000000 + dma->baud - 1) / dma->baud)->index = chan;
+}
+
+void hal_dma_stream_release(uint chan)
+{
+    for (int i = 0; i < SIM_MAX_EVENTS; i++)
+    {
+        if (sim.events[i].active && sim.events[i].kind == EVENT_DMA && sim.events[i].index == chan)
+            sim.events[i].active = false;
+    }
+    sim.dma[chan].claimed = false;
+}
+
+void hal_dma_stream_start(uint chan, const uint32_t *words, uint count)
+{
+    SimDmaChannel *dma = &sim.dma[chan];
+    hal_assert(dma->claimed && !dma->busy);
+    SimStateMachine *sm = &sim.sms[dma->sm];
+    hal_assert(sm->kind == SM_WS2812);
+
+    // A long enough gap since the last word latches the strip
+    if (sim.now >= sm->idle_at + SIM_WS2812_RESET_US || sm->frames == 0)
+    {
+        sm->strip_len = 0;
+        sm->frames++;
+    }
+
+    uint space = SIM_STRIP_WORDS - sm->strip_len;
+    memcpy(sm->strip + sm->strip_len, words, (count < space ? count : space) * sizeof(uint32_t));
+    sm->strip_len += count < space ? count : space;
+
+    uint64_t start = sm->idle_at > sim.now ? sm->idle_at : sim.now;
+    sm->idle_at = start + (uint64_t)count * sm->word_us;
+    dma->busy = true;
+    schedule(EVENT_DMA, sm->idle_at)->index = chan;
+}
+
+// One byte per bit time, bit n on pin + n; every 24 bytes are one pixel of
+// each strip, MSB first
+void hal_dma_byte_stream_start(uint chan, const uint8_t *bytes, uint count)
+{
+    SimDmaChannel *dma = &sim.dma[chan];
+    hal_assert(dma->claimed && !dma->busy);
+    SimStateMachine *sm = &sim.sms[dma->sm];
+    hal_assert(sm->kind == SM_WS2812_PARALLEL);
+
+    if (sim.now >= sm->idle_at + SIM_WS2812_RESET_US || sm->frames == 0)
+    {
+        sm->planes_len = 0;
+        sm->strip_len = 0;
+        sm->frames++;
+    }
+
+    uint space = SIM_PLANE_BYTES - sm->planes_len;
+    memcpy(sm->planes + sm->planes_len, bytes, count < space ? count : space);
+    sm->planes_len += count < space ? count : space;
+
+    while (sm->strip_len < SIM_PARALLEL_STRIP_WORDS && (sm->strip_len + 1) * 24 <= sm->planes_len)
+    {
+        const uint8_t *row = sm->planes + sm->strip_len * 24;
+        for (uint s = 0; s < sm->pin_count; s++)
+        {
+            uint32_t word = 0;
+            for (int bit = 0; bit < 24; bit++)
+                word |= (uint32_t)((row[bit] >> s) & 1) << (31 - bit);
+            sm->strip[s * SIM_PARALLEL_STRIP_WORDS + sm->strip_len] = word;
+        }
+        sm->strip_len++;
+    }
+
+    uint64_t start = sm->idle_at > sim.now ? sm->idle_at : sim.now;
+    sm->idle_at = start + ((uint64_t)count * sm->word_us + 23) / 24;
+    dma->busy = true;
+    schedule(EVENT_DMA, sm->idle_at)->index = chan;
+}
+
+//--------------------------------------------------------------------+
+// HAL: flash
+//--------------------------------------------------------------------+
+const void *hal_flash_read(uint32_t offset)
+{
+    hal_assert(offset < PICO_FLASH_SIZE_BYTES);
+    return sim.flash + offset;
+}
+
+void hal_flash_write_sector(uint32_t offset, const void *data, uint32_t len)
+{
+    hal_assert(offset % HAL_FLASH_SECTOR_SIZE == 0 && offset < PICO_FLASH_SIZE_BYTES);
+    hal_assert(len <= HAL_FLASH_SECTOR_SIZE);
+    memset(sim.flash + offset, 0xFF, HAL_FLASH_SECTOR_SIZE);
+    memcpy(sim.flash + offset, data, len);
+    sim.flash_writes++;
+}
+
+//--------------------------------------------------------------------+
+// HAL: stdio
+//--------------------------------------------------------------------+
+
+// Host tools print their results on stdout, so it is left alone
+void hal_stdio_redirect(hal_stdio_fn_t out)
+{
+    (void)out;
+}
+
+//--------------------------------------------------------------------+
+// HAL: USB HID
+//--------------------------------------------------------------------+
+bool hal_usb_suspended(void)
+{
+    return sim.usb_suspended;
+}
+
+// The host always allows it and resumes at once
+void hal_usb_remote_wakeup(void)
+{
+    if (!sim.usb_suspended)
+        return;
+    sim.usb_suspended = false;
+    sim.usb_wakeups++;
+}
+
+bool hal_hid_ready(uint8_t itf)
+{
+    return itf < SIM_HID_ITFS && !sim.hid_busy[itf] && !sim.hid_ep[itf].loaded && !sim.hid_ep[itf].completed;
+}
+
+bool hal_hid_report(uint8_t itf, const void *report, uint16_t len)
+{
+    if (!hal_hid_ready(itf) || len > 64)
+        return false;
+
+    SimHidReport out = {.timestamp_us = sim.now, .queued_us = sim.now, .itf = itf, .len = len};
+    memcpy(out.data, report, len);
+    sim.hid_count++;
+
+    // With a poller the report waits in the endpoint for the next IN token
+    SimHidEndpoint *ep = &sim.hid_ep[itf];
+    if (ep->interval_us)
+    {
+        ep->pending = out;
+        ep->loaded = true;
+        return true;
+    }
+
+    if (sim.hid_fn)
+        sim.hid_fn(&out, sim.hid_ctx);
+    return true;
+}
+
+bool hal_hid_keyboard_report(uint8_t itf, uint8_t modifiers, const uint8_t *keycodes)
+{
+    uint8_t report[8] = {modifiers, 0};
+    if (keycodes)
+        memcpy(&report[2], keycodes, 6);
+    return hal_hid_report(itf, report, sizeof(report));
+}
+
+bool hal_hid_mouse_report(uint8_t itf, uint8_t buttons, int8_t x, int8_t y, int8_t wheel, int8_t pan)
+{
+    uint8_t report[5] = {buttons, (uint8_t)x, (uint8_t)y, (uint8_t)wheel, (uint8_t)pan};
+    return hal_hid_report(itf, report, sizeof(report));
+}
+
+bool hal_hid_gamepad_report(uint8_t itf, int8_t x, int8_t y, int8_t z, int8_t rz, int8_t rx, int8_t ry,
+                            uint8_t hat, uint32_t buttons)
+{
+    // Same packed little-endian layout as TinyUSB's hid_gamepad_report_t
+    uint8_t report[11] = {(uint8_t)x, (uint8_t)y, (uint8_t)z, (uint8_t)rz, (uint8_t)rx, (uint8_t)ry, hat,
+                          (uint8_t)buttons, (uint8_t)(buttons >> 8), (uint8_t)(buttons >> 16), (uint8_t)(buttons >> 24)};
+    return hal_hid_report(itf, report, sizeof(report));
+}
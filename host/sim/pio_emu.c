@@ -0,0 +1,689 @@
+#include "pio_emu.h"
+#include <string.h>
+
+#define GPIO_MASK ((1u << PIO_EMU_GPIO_COUNT) - 1)
+
+enum
+{
+    OP_JMP,
+    OP_WAIT,
+    OP_IN,
+    OP_OUT,
+    OP_PUSH_PULL,
+    OP_MOV,
+    OP_IRQ,
+    OP_SET
+};
+
+static inline uint32_t mask_bits(unsigned count)
+{
+    return count >= 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+}
+
+static inline uint32_t rotate_right(uint32_t value, unsigned shift)
+{
+    shift &= 31;
+    return shift ? (value >> shift) | (value << (32 - shift)) : value;
+}
+
+static uint32_t bit_reverse(uint32_t value)
+{
+    uint32_t out = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        out = (out << 1) | (value & 1);
+        value >>= 1;
+    }
+    return out;
+}
+
+//--------------------------------------------------------------------+
+// FIFOs
+//--------------------------------------------------------------------+
+static unsigned tx_capacity(const PioEmuSm *sm)
+{
+    switch (sm->config.join)
+    {
+    case PIO_EMU_JOIN_TX:
+        return PIO_EMU_FIFO_DEPTH * 2;
+    case PIO_EMU_JOIN_RX:
+        return 0;
+    default:
+        return PIO_EMU_FIFO_DEPTH;
+    }
+}
+
+static unsigned rx_capacity(const PioEmuSm *sm)
+{
+    switch (sm->config.join)
+    {
+    case PIO_EMU_JOIN_RX:
+        return PIO_EMU_FIFO_DEPTH * 2;
+    case PIO_EMU_JOIN_TX:
+        return 0;
+    default:
+        return PIO_EMU_FIFO_DEPTH;
+    }
+}
+
+static uint32_t tx_pop(PioEmuSm *sm)
+{
+    uint32_t word = sm->tx_fifo[sm->tx_head];
+    sm->tx_head = (sm->tx_head + 1) % (PIO_EMU_FIFO_DEPTH * 2);
+    sm->tx_level--;
+    return word;
+}
+
+static bool rx_push(PioEmuSm *sm, uint32_t word)
+{
+    if (sm->rx_level >= rx_capacity(sm))
+        return false;
+    sm->rx_fifo[(sm->rx_head + sm->rx_level) % (PIO_EMU_FIFO_DEPTH * 2)] = word;
+    sm->rx_level++;
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// Pins
+//--------------------------------------------------------------------+
+static void write_pins(PioEmu *pio, unsigned base, unsigned count, uint32_t value)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint32_t bit = 1u << ((base + i) & 31);
+        pio->pin_out = (value >> i) & 1 ? pio->pin_out | bit : pio->pin_out & ~bit;
+    }
+}
+
+static void write_pindirs(PioEmu *pio, unsigned base, unsigned count, uint32_t value)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint32_t bit = 1u << ((base + i) & 31);
+        pio->pin_dirs = (value >> i) & 1 ? pio->pin_dirs | bit : pio->pin_dirs & ~bit;
+    }
+}
+
+uint32_t pio_emu_pins(const PioEmu *pio)
+{
+    return ((pio->pin_out & pio->pin_dirs) | (pio->pin_in & ~pio->pin_dirs)) & GPIO_MASK;
+}
+
+//--------------------------------------------------------------------+
+// Shift registers
+//--------------------------------------------------------------------+
+static void shift_in(PioEmuSm *sm, uint32_t data, unsigned count)
+{
+    data &= mask_bits(count);
+    if (count >= 32)
+        sm->isr = data;
+    else if (sm->config.in_shift_right)
+        sm->isr = (sm->isr >> count) | (data << (32 - count));
+    else
+        sm->isr = (sm->isr << count) | data;
+    sm->isr_count = sm->isr_count + count > 32 ? 32 : sm->isr_count + count;
+}
+
+static uint32_t shift_out(PioEmuSm *sm, unsigned count)
+{
+    uint32_t data;
+    if (count >= 32)
+    {
+        data = sm->osr;
+        sm->osr = 0;
+    }
+    else if (sm->config.out_shift_right)
+    {
+        data = sm->osr & mask_bits(count);
+        sm->osr >>= count;
+    }
+    else
+    {
+        data = sm->osr >> (32 - count);
+        sm->osr <<= count;
+    }
+    sm->osr_count = sm->osr_count + count > 32 ? 32 : sm->osr_count + count;
+    return data;
+}
+
+static bool osr_empty(const PioEmuSm *sm)
+{
+    return sm->osr_count >= sm->config.pull_threshold;
+}
+
+static bool isr_full(const PioEmuSm *sm)
+{
+    return sm->isr_count >= sm->config.push_threshold;
+}
+
+// Background refill: on RP2040 autopull tops up an empty OSR whenever the
+// TX FIFO has data, so OUT only stalls when the FIFO has run dry
+static void autopull(PioEmuSm *sm)
+{
+    if (sm->config.autopull && osr_empty(sm) && sm->tx_level)
+    {
+        sm->osr = tx_pop(sm);
+        sm->osr_count = 0;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Instruction execution
+//--------------------------------------------------------------------+
+typedef enum
+{
+    STEP_DONE,
+    STEP_JUMPED,
+    STEP_STALL
+} StepResult;
+
+static uint32_t mov_source(PioEmu *pio, PioEmuSm *sm, unsigned source)
+{
+    switch (source)
+    {
+    case 0:
+        return rotate_right(pio_emu_pins(pio), sm->config.in_base);
+    case 1:
+        return sm->x;
+    case 2:
+        return sm->y;
+    case 5:
+        return 0; // STATUS with the default "TX level < 0" selection
+    case 6:
+        return sm->isr;
+    case 7:
+        return sm->osr;
+    default:
+        return 0;
+    }
+}
+
+static StepResult execute(PioEmu *pio, PioEmuSm *sm, uint16_t instr)
+{
+    unsigned arg1 = (instr >> 5) & 7;
+    unsigned arg2 = instr & 0x1F;
+
+    switch (instr >> 13)
+    {
+    case OP_JMP:
+    {
+        bool taken;
+        switch (arg1)
+        {
+        case 0:
+            taken = true;
+            break;
+        case 1:
+            taken = sm->x == 0;
+            break;
+        case 2:
+            taken = sm->x-- != 0;
+            break;
+        case 3:
+            taken = sm->y == 0;
+            break;
+        case 4:
+            taken = sm->y-- != 0;
+            break;
+        case 5:
+            taken = sm->x != sm->y;
+            break;
+        case 6:
+            taken = (pio_emu_pins(pio) >> sm->config.jmp_pin) & 1;
+            break;
+        default:
+            taken = !osr_empty(sm);
+            break;
+        }
+        if (!taken)
+            return STEP_DONE;
+        sm->pc = arg2;
+        return STEP_JUMPED;
+    }
+
+    case OP_WAIT:
+    {
+        bool polarity = (instr >> 7) & 1;
+        bool level;
+        switch ((instr >> 5) & 3)
+        {
+        case 0:
+            level = (pio_emu_pins(pio) >> arg2) & 1;
+            break;
+        case 1:
+            level = (pio_emu_pins(pio) >> ((sm->config.in_base + arg2) & 31)) & 1;
+            break;
+        case 2:
+        {
+            unsigned index = arg2 & 0x10 ? ((arg2 & 0x0F) + (sm - pio->sm)) & 3 : arg2 & 7;
+            level = (pio->irq >> index) & 1;
+            if (level && polarity)
+                pio->irq &= ~(1u << index);
+            break;
+        }
+        default:
+            level = polarity;
+            break;
+        }
+        return level == polarity ? STEP_DONE : STEP_STALL;
+    }
+
+    case OP_IN:
+    {
+        unsigned count = arg2 ? arg2 : 32;
+        if (sm->config.autopush && isr_full(sm))
+        {
+            if (!rx_push(sm, sm->isr))
+                return STEP_STALL;
+            sm->isr = 0;
+            sm->isr_count = 0;
+        }
+        uint32_t data;
+        switch (arg1)
+        {
+        case 0:
+            data = rotate_right(pio_emu_pins(pio), sm->config.in_base);
+            break;
+        case 1:
+            data = sm->x;
+            break;
+        case 2:
+            data = sm->y;
+            break;
+        case 6:
+            data = sm->isr;
+            break;
+        case 7:
+            data = sm->osr;
+            break;
+        default:
+            data = 0;
+            break;
+        }
+        shift_in(sm, data, count);
+        if (sm->config.autopush && isr_full(sm) && rx_push(sm, sm->isr))
+        {
+            sm->isr = 0;
+            sm->isr_count = 0;
+        }
+        return STEP_DONE;
+    }
+
+    case OP_OUT:
+    {
+        unsigned count = arg2 ? arg2 : 32;
+        if (sm->config.autopull && osr_empty(sm))
+        {
+            autopull(sm);
+            if (osr_empty(sm))
+                return STEP_STALL;
+        }
+        uint32_t data = shift_out(sm, count);
+        StepResult result = STEP_DONE;
+        switch (arg1)
+        {
+        case 0:
+            write_pins(pio, sm->config.out_base, sm->config.out_count, data);
+            break;
+        case 1:
+            sm->x = data;
+            break;
+        case 2:
+            sm->y = data;
+            break;
+        case 4:
+            write_pindirs(pio, sm->config.out_base, sm->config.out_count, data);
+            break;
+        case 5:
+            sm->pc = data & 0x1F;
+            result = STEP_JUMPED;
+            break;
+        case 6:
+            sm->isr = data;
+            sm->isr_count = count;
+            break;
+        case 7:
+            sm->exec_pending = true;
+            sm->exec_instr = (uint16_t)data;
+            break;
+        default:
+            break;
+        }
+        autopull(sm);
+        return result;
+    }
+
+    case OP_PUSH_PULL:
+    {
+        bool if_flag = (instr >> 6) & 1;
+        bool block = (instr >> 5) & 1;
+        if (instr & 0x80)
+        {
+            if (if_flag && !osr_empty(sm))
+                return STEP_DONE;
+            if (sm->tx_level)
+                sm->osr = tx_pop(sm);
+            else if (block)
+                return STEP_STALL;
+            else
+                sm->osr = sm->x;
+            sm->osr_count = 0;
+        }
+        else
+        {
+            if (if_flag && !isr_full(sm))
+                return STEP_DONE;
+            if (!rx_push(sm, sm->isr))
+            {
+                if (block)
+                    return STEP_STALL;
+                sm->rx_dropped++;
+            }
+            sm->isr = 0;
+            sm->isr_count = 0;
+        }
+        return STEP_DONE;
+    }
+
+    case OP_MOV:
+    {
+        uint32_t data = mov_source(pio, sm, instr & 7);
+        switch ((instr >> 3) & 3)
+        {
+        case 1:
+            data = ~data;
+            break;
+        case 2:
+            data = bit_reverse(data);
+            break;
+        default:
+            break;
+        }
+        switch (arg1)
+        {
+        case 0:
+            write_pins(pio, sm->config.out_base, sm->config.out_count, data);
+            break;
+        case 1:
+            sm->x = data;
+            break;
+        case 2:
+            sm->y = data;
+            break;
+        case 4:
+            sm->exec_pending = true;
+            sm->exec_instr = (uint16_t)data;
+            break;
+        case 5:
+            sm->pc = data & 0x1F;
+            return STEP_JUMPED;
+        case 6:
+            sm->isr = data;
+            sm->isr_count = 0;
+            break;
+        case 7:
+            sm->osr = data;
+            sm->osr_count = 0;
+            break;
+        default:
+            break;
+        }
+        return STEP_DONE;
+    }
+
+    case OP_IRQ:
+    {
+        bool clear = (instr >> 6) & 1;
+        bool wait = (instr >> 5) & 1;
+        unsigned index = arg2 & 0x10 ? ((arg2 & 0x0F) + (sm - pio->sm)) & 3 : arg2 & 7;
+        if (clear)
+        {
+            pio->irq &= ~(1u << index);
+            return STEP_DONE;
+        }
+        if (!sm->stalled)
+            pio->irq |= 1u << index;
+        return wait && ((pio->irq >> index) & 1) ? STEP_STALL : STEP_DONE;
+    }
+
+    default: // OP_SET
+        switch (arg1)
+        {
+        case 0:
+            write_pins(pio, sm->config.set_base, sm->config.set_count, arg2);
+            break;
+        case 1:
+            sm->x = arg2;
+            break;
+        case 2:
+            sm->y = arg2;
+            break;
+        case 4:
+            write_pindirs(pio, sm->config.set_base, sm->config.set_count, arg2);
+            break;
+        default:
+            break;
+        }
+        return STEP_DONE;
+    }
+}
+
+// Side-set takes effect as the instruction issues, including on every cycle
+// it spends stalled
+static unsigned apply_sideset(PioEmu *pio, PioEmuSm *sm, uint16_t instr)
+{
+    const PioEmuConfig *c = &sm->config;
+    unsigned field = (instr >> 8) & 0x1F;
+    unsigned delay_bits = 5 - c->sideset_count;
+    unsigned delay = field & mask_bits(delay_bits);
+
+    if (c->sideset_count)
+    {
+        unsigned value = field >> delay_bits;
+        unsigned count = c->sideset_count;
+        bool enabled = true;
+        if (c->sideset_opt)
+        {
+            count--;
+            enabled = (value >> count) & 1;
+            value &= mask_bits(count);
+        }
+        if (enabled && c->sideset_pindirs)
+            write_pindirs(pio, c->sideset_base, count, value);
+        else if (enabled)
+            write_pins(pio, c->sideset_base, count, value);
+    }
+    return delay;
+}
+
+// One state machine clock
+static void sm_clock(PioEmu *pio, PioEmuSm *sm)
+{
+    sm->ticks++;
+    if (sm->delay)
+    {
+        sm->delay--;
+        return;
+    }
+
+    bool executed = sm->exec_pending;
+    uint16_t instr = executed ? sm->exec_instr : pio->mem[sm->pc];
+    unsigned delay = apply_sideset(pio, sm, instr);
+
+    sm->exec_pending = false;
+    StepResult result = execute(pio, sm, instr);
+    if (result == STEP_STALL)
+    {
+        // Retried next clock; an EXEC'd instruction stays pending
+        sm->exec_pending = executed;
+        if (executed)
+            sm->exec_instr = instr;
+        sm->stalled = true;
+        sm->stall_ticks++;
+        return;
+    }
+    sm->stalled = false;
+
+    // Delay on an OUT/MOV EXEC is ignored; the executee's own delay counts
+    if (!sm->exec_pending)
+        sm->delay = delay;
+    if (result == STEP_DONE && !executed)
+        sm->pc = sm->pc == sm->config.wrap ? sm->config.wrap_target : (sm->pc + 1) & 0x1F;
+}
+
+//--------------------------------------------------------------------+
+// Public API
+//--------------------------------------------------------------------+
+void pio_emu_init(PioEmu *pio)
+{
+    memset(pio, 0, sizeof(*pio));
+}
+
+void pio_emu_load(PioEmu *pio, const uint16_t *instructions, unsigned length, unsigned offset)
+{
+    for (unsigned i = 0; i < length; i++)
+    {
+        uint16_t instr = instructions[i];
+        if ((instr >> 13) == OP_JMP)
+            instr = (instr & ~0x1F) | ((instr + offset) & 0x1F);
+        pio->mem[(offset + i) & 0x1F] = instr;
+    }
+}
+
+PioEmuConfig pio_emu_default_config(void)
+{
+    PioEmuConfig config = {0};
+    config.wrap_target = 0;
+    config.wrap = PIO_EMU_MEM_WORDS - 1;
+    config.in_shift_right = true;
+    config.out_shift_right = true;
+    config.push_threshold = 32;
+    config.pull_threshold = 32;
+    config.clkdiv_int = 1;
+    return config;
+}
+
+bool pio_emu_set_clkdiv(PioEmuConfig *config, float div)
+{
+    if (!(div >= 1.0f && div <= 65536.0f))
+        return false;
+    if (div >= 65536.0f)
+    {
+        config->clkdiv_int = 0;
+        config->clkdiv_frac = 0;
+        return true;
+    }
+    config->clkdiv_int = (uint16_t)div;
+    config->clkdiv_frac = (uint8_t)((div - (float)config->clkdiv_int) * 256.0f);
+    return true;
+}
+
+double pio_emu_clkdiv(const PioEmuConfig *config)
+{
+    return (config->clkdiv_int ? config->clkdiv_int : 65536) + config->clkdiv_frac / 256.0;
+}
+
+void pio_emu_sm_start(PioEmu *pio, unsigned index, unsigned initial_pc, const PioEmuConfig *config)
+{
+    PioEmuSm *sm = &pio->sm[index];
+    memset(sm, 0, sizeof(*sm));
+    sm->config = *config;
+    sm->pc = initial_pc & 0x1F;
+    sm->osr_count = 32; // OSR starts empty
+    sm->next_tick = pio->cycle;
+    sm->enabled = true;
+}
+
+void pio_emu_sm_stop(PioEmu *pio, unsigned index)
+{
+    pio->sm[index].enabled = false;
+}
+
+void pio_emu_set_pindirs(PioEmu *pio, unsigned base, unsigned count, bool out)
+{
+    write_pindirs(pio, base, count, out ? 0xFFFFFFFFu : 0);
+}
+
+void pio_emu_set_input(PioEmu *pio, unsigned pin, bool level)
+{
+    uint32_t bit = 1u << (pin & 31);
+    pio->pin_in = level ? pio->pin_in | bit : pio->pin_in & ~bit;
+}
+
+void pio_emu_set_trace(PioEmu *pio, pio_emu_trace_fn fn, void *ctx)
+{
+    pio->trace_fn = fn;
+    pio->trace_ctx = ctx;
+}
+
+bool pio_emu_tx_put(PioEmu *pio, unsigned index, uint32_t word)
+{
+    PioEmuSm *sm = &pio->sm[index];
+    if (sm->tx_level >= tx_capacity(sm))
+        return false;
+    sm->tx_fifo[(sm->tx_head + sm->tx_level) % (PIO_EMU_FIFO_DEPTH * 2)] = word;
+    sm->tx_level++;
+    return true;
+}
+
+bool pio_emu_rx_get(PioEmu *pio, unsigned index, uint32_t *word)
+{
+    PioEmuSm *sm = &pio->sm[index];
+    if (!sm->rx_level)
+        return false;
+    *word = sm->rx_fifo[sm->rx_head];
+    sm->rx_head = (sm->rx_head + 1) % (PIO_EMU_FIFO_DEPTH * 2);
+    sm->rx_level--;
+    return true;
+}
+
+unsigned pio_emu_tx_level(const PioEmu *pio, unsigned index)
+{
+    return pio->sm[index].tx_level;
+}
+
+unsigned pio_emu_rx_level(const PioEmu *pio, unsigned index)
+{
+    return pio->sm[index].rx_level;
+}
+
+void pio_emu_run_until(PioEmu *pio, uint64_t cycle)
+{
+    for (;;)
+    {
+        // Jump straight to the next divided clock of any state machine
+        uint64_t next = UINT64_MAX;
+        for (int i = 0; i < PIO_EMU_SMS; i++)
+        {
+            if (pio->sm[i].enabled && pio->sm[i].next_tick < next)
+                next = pio->sm[i].next_tick;
+        }
+        if (next > cycle)
+            break;
+        pio->cycle = next;
+
+        uint32_t before = pio_emu_pins(pio) & pio->pin_dirs;
+        for (int i = 0; i < PIO_EMU_SMS; i++)
+        {
+            PioEmuSm *sm = &pio->sm[i];
+            if (!sm->enabled || sm->next_tick != next)
+                continue;
+            sm_clock(pio, sm);
+
+            uint32_t period = (sm->config.clkdiv_int ? sm->config.clkdiv_int : 65536u) * 256u + sm->config.clkdiv_frac;
+            uint32_t phase = sm->div_acc + period;
+            sm->next_tick += phase >> 8;
+            sm->div_acc = phase & 0xFF;
+        }
+
+        uint32_t after = pio_emu_pins(pio) & pio->pin_dirs;
+        if (after != before && pio->trace_fn)
+            pio->trace_fn(pio->cycle, after, pio->trace_ctx);
+    }
+    pio->cycle = cycle;
+}
+
+void pio_emu_run(PioEmu *pio, uint64_t cycles)
+{
+    pio_emu_run_until(pio, pio->cycle + cycles);
+}
@@ -0,0 +1,146 @@
+#ifndef PIO_EMU_H
+#define PIO_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cycle-level emulator of one RP2040 PIO block (PIO version 0): 32 words of
+// instruction memory, four state machines with FIFOs, shift counters,
+// side-set, delays and fractional clock dividers, and 30 GPIOs. Programs
+// are loaded straight from the pioasm output in generated/*.pio.h.
+//
+// Time is counted in system clock cycles. Each state machine executes one
+// instruction (or one delay cycle, or one stalled cycle) whenever its clock
+// divider fires, exactly as on the chip; pin changes are reported through
+// a trace hook with the system cycle they happened on.
+
+#define PIO_EMU_SMS 4
+#define PIO_EMU_MEM_WORDS 32
+#define PIO_EMU_FIFO_DEPTH 4
+#define PIO_EMU_GPIO_COUNT 30
+
+typedef enum
+{
+    PIO_EMU_JOIN_NONE,
+    PIO_EMU_JOIN_TX, // 8-deep TX FIFO, no RX FIFO
+    PIO_EMU_JOIN_RX  // 8-deep RX FIFO, no TX FIFO
+} PioEmuJoin;
+
+// Mirrors the fields set through the SDK's sm_config_set_*() calls
+typedef struct
+{
+    uint8_t wrap_target;
+    uint8_t wrap;
+
+    uint8_t sideset_count; // Including the enable bit when sideset_opt
+    bool sideset_opt;
+    bool sideset_pindirs;
+    uint8_t sideset_base;
+
+    uint8_t in_base;
+    uint8_t out_base;
+    uint8_t out_count;
+    uint8_t set_base;
+    uint8_t set_count;
+    uint8_t jmp_pin;
+
+    bool in_shift_right;
+    bool autopush;
+    uint8_t push_threshold; // 1..32
+    bool out_shift_right;
+    bool autopull;
+    uint8_t pull_threshold; // 1..32
+
+    PioEmuJoin join;
+
+    // Clock divider in 16.8 fixed point, as in SMx_CLKDIV. 0 means 65536.
+    uint16_t clkdiv_int;
+    uint8_t clkdiv_frac;
+} PioEmuConfig;
+
+typedef struct
+{
+    bool enabled;
+    PioEmuConfig config;
+
+    uint8_t pc;
+    uint32_t x, y;
+    uint32_t isr, osr;
+    uint8_t isr_count; // Bits shifted into the ISR
+    uint8_t osr_count; // Bits shifted out of the OSR
+
+    uint32_t tx_fifo[PIO_EMU_FIFO_DEPTH * 2];
+    uint8_t tx_head, tx_level;
+    uint32_t rx_fifo[PIO_EMU_FIFO_DEPTH * 2];
+    uint8_t rx_head, rx_level;
+
+    uint16_t delay;   // Delay cycles left after the current instruction
+    bool stalled;     // Current instruction is waiting
+    bool exec_pending;
+    uint16_t exec_instr;
+
+    uint32_t div_acc;    // Clock divider phase, in 1/256 system cycles
+    uint64_t next_tick;  // System cycle of the next state machine clock
+    uint64_t ticks;      // State machine clocks so far
+    uint64_t stall_ticks;
+    uint32_t rx_dropped; // Non-blocking pushes lost to a full RX FIFO
+} PioEmuSm;
+
+typedef void (*pio_emu_trace_fn)(uint64_t cycle, uint32_t pins, void *ctx);
+
+typedef struct
+{
+    uint16_t mem[PIO_EMU_MEM_WORDS];
+    PioEmuSm sm[PIO_EMU_SMS];
+    uint8_t irq;
+
+    uint32_t pin_in;   // Levels driven from outside
+    uint32_t pin_out;  // Levels driven by the state machines
+    uint32_t pin_dirs; // 1 = output from PIO
+
+    uint64_t cycle;
+
+    pio_emu_trace_fn trace_fn;
+    void *trace_ctx;
+} PioEmu;
+
+void pio_emu_init(PioEmu *pio);
+
+// Copies a pioasm program into instruction memory at offset, relocating
+// JMP targets the way pio_add_program() does
+void pio_emu_load(PioEmu *pio, const uint16_t *instructions, unsigned length, unsigned offset);
+
+// Defaults of pio_get_default_sm_config(): wrap over all memory, shifts
+// right with thresholds of 32, clock divider 1
+PioEmuConfig pio_emu_default_config(void);
+
+// Splits a float divider the same way sm_config_set_clkdiv() does.
+// Returns false if it is outside the 1..65536 range the hardware accepts.
+bool pio_emu_set_clkdiv(PioEmuConfig *config, float div);
+double pio_emu_clkdiv(const PioEmuConfig *config);
+
+// Equivalent of pio_sm_init() followed by pio_sm_set_enabled()
+void pio_emu_sm_start(PioEmu *pio, unsigned sm, unsigned initial_pc, const PioEmuConfig *config);
+void pio_emu_sm_stop(PioEmu *pio, unsigned sm);
+
+void pio_emu_set_pindirs(PioEmu *pio, unsigned base, unsigned count, bool out);
+void pio_emu_set_input(PioEmu *pio, unsigned pin, bool level);
+
+// Pin levels as the state machines see them
+uint32_t pio_emu_pins(const PioEmu *pio);
+
+// Called whenever a PIO-driven output pin changes level
+void pio_emu_set_trace(PioEmu *pio, pio_emu_trace_fn fn, void *ctx);
+
+// FIFO access from the system side; return false when full or empty
+bool pio_emu_tx_put(PioEmu *pio, unsigned sm, uint32_t word);
+bool pio_emu_rx_get(PioEmu *pio, unsigned sm, uint32_t *word);
+unsigned pio_emu_tx_level(const PioEmu *pio, unsigned sm);
+unsigned pio_emu_rx_level(const PioEmu *pio, unsigned sm);
+
+// Advances the system clock by cycles; every enabled state machine runs
+// at its own divided rate
+void pio_emu_run(PioEmu *pio, uint64_t cycles);
+void pio_emu_run_until(PioEmu *pio, uint64_t cycle);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/hal/hal.h"
+
+// Control side of the simulated hardware behind the host HAL backend.
+// Time only moves in sim_run_until()/sim_advance_us(), which fire every
+// alarm, timer, DMA completion and USB poll that falls due, in deadline
+// order, with the clock set to each one's deadline.
+
+#define SIM_HARDWARE_ALARMS 4 // The default pool takes the last one
+#define SIM_MAX_EVENTS 32
+#define SIM_GPIO_COUNT 30
+#define SIM_PIO_SMS 8
+#define SIM_DMA_CHANNELS 12
+#define SIM_STRIP_WORDS 1024
+#define SIM_PARALLEL_STRIP_WORDS (SIM_STRIP_WORDS / 8) // Per strip of a parallel state machine
+#define SIM_PLANE_BYTES 4096
+#define SIM_WS2812_RESET_US 50 // Idle gap after which the strip latches
+#define SIM_UART_BYTES 65536
+
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+
+// Back to power-on: clock at 0, pins pulled up, flash erased, nothing
+// claimed. Modules must be initialised again afterwards.
+void sim_reset(void);
+
+uint64_t sim_now_us(void);
+void sim_run_until(uint64_t target_us);
+void sim_advance_us(uint64_t us);
+
+// Inputs
+void sim_gpio_set(uint pin, bool level);
+// Add counts to the quadrature state machine on pin_a
+void sim_encoder_turn(uint pin_a, int32_t counts);
+
+// WS2812 output as seen on the wire: the words of the current frame and the
+// number of frames started so far. A strip driven by a ws2812_parallel state
+// machine reads back the same way, by its own pin.
+const uint32_t *sim_ws2812_words(uint pin, uint *count);
+uint32_t sim_ws2812_frames(uint pin);
+// Bytes of the current frame of the ws2812_parallel state machine starting
+// at pin_base, one per bit time, as the DMA wrote them
+const uint8_t *sim_ws2812_planes(uint pin_base, uint *count);
+
+// Bytes sent by DMA to the UART since reset (the first SIM_UART_BYTES)
+const uint8_t *sim_uart_bytes(uint *count);
+
+uint32_t sim_flash_writes(void);
+
+// USB HID. Without a poller, reports are delivered to the hook as they are
+// queued.
+typedef struct
+{
+    uint64_t timestamp_us; // When the host received it
+    uint64_t queued_us;    // When the firmware handed it over
+    uint8_t itf;
+    uint16_t len;
+    uint8_t data[64];
+} SimHidReport;
+
+typedef void (*sim_hid_fn)(const SimHidReport *report, void *ctx);
+void sim_hid_set_hook(sim_hid_fn fn, void *ctx);
+void sim_hid_set_ready(uint8_t itf, bool ready);
+uint32_t sim_hid_count(void);
+
+// Bus suspend; hal_usb_remote_wakeup() resumes it and counts a wakeup
+void sim_usb_suspend(bool suspended);
+uint32_t sim_usb_wakeups(void);
+
+// Stand-in for tud_hid_report_complete_cb(), called after the host has
+// taken a report
+typedef void (*sim_hid_complete_fn)(uint8_t itf, void *ctx);
+void sim_hid_set_complete_hook(sim_hid_complete_fn fn, void *ctx);
+
+// USB host poller, following TinyUSB's contract: once a report is queued
+// the interface is not ready until the host's next IN token on it has taken
+// the report (delivering it to the hook) and sim_usb_task(), standing in for
+// tud_task(), has processed the completion and called the completion hook.
+// Polls come every interval_us (bInterval) from now on, each moved by a
+// uniform random jitter of up to +-jitter_us. Polls with nothing queued are
+// NAKed.
+typedef struct
+{
+    uint32_t polls;
+    uint32_t delivered;
+    uint32_t naks;
+} SimUsbStats;
+
+void sim_usb_poll(uint8_t itf, uint32_t interval_us, uint32_t jitter_us);
+void sim_usb_task(void);
+SimUsbStats sim_usb_stats(uint8_t itf);
+
+#endif
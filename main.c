@@ -5,13 +5,26 @@
 #include "tusb.h"
 #include "modules/usb/usb_descriptors.h"
 #include "hardware/gpio.h"
+#include "pico/stdlib.h"
 #include "pico/bootrom.h"
 #include "hardware/flash.h"
 #include "modules/encoder/ec11.h"
 #include "modules/debounce/debounce.h"
 #include "modules/rgb/ws2812.h"
+#include "modules/rgb/led_render.h"
+#include "modules/rgb/led_stream.h"
 #include "modules/remap/remap.h"
-#include "math.h"
+#include "modules/action/action.h"
+#include "modules/sched/sched.h"
+#include "modules/input/input.h"
+#include "modules/input/input_trace.h"
+#include "modules/profile/profile.h"
+#include "modules/trace/trace.h"
+#include "modules/log/log.h"
+#include "modules/memstat/memstat.h"
+#include "modules/report/report_task.h"
+#include "modules/hal/hal.h"
+#include "pico/multicore.h"
 #include "ws2812.pio.h"
 #include "config.h"
 
@@ -22,27 +35,7 @@
 // Debounce default 5ms
 #define DEBOUNCE_TIME_US 5000
 
-// Button configurations
-#define BUTTON_COUNT 7
-#define BTN_BTA 6
-#define BTN_BTB 5
-#define BTN_BTC 4
-#define BTN_BTD 3
-#define BTN_FXL 2
-#define BTN_START 1
-#define BTN_FXR 0
-
-// Encoder configurations
-#define ENCODER_X_PIN_A 9
-#define ENCODER_X_PIN_B 10
-#define ENCODER_Y_PIN_A 7
-#define ENCODER_Y_PIN_B 8
-
-// WS2812 LED configurations
-#define DEFAULT_BRIGHTNESS 0.1 // 10% brightness
-#define RGB_COUNT 7
-#define IS_RGBW false
-
+// Pins and LED layout come from the board description (config.h)
 
 #define CLAMP(x, min, max) ((x) < (min) ? (min) : ((x) > (max) ? (max) : (x)))
 
@@ -66,19 +59,9 @@ typedef struct
 	DebounceState debounce;
 	EC11_Encoder encoder_x;
 	EC11_Encoder encoder_y;
-	uint8_t button_pins[BUTTON_COUNT];
 	SystemMode current_mode;
 } AppState;
 
-typedef struct
-{
-	uint t;
-	int dir;
-	uint pattern_index;
-	uint32_t last_update;
-	bool pattern_changed;
-} AnimationState;
-
 // USB interface IDs
 enum
 {
@@ -103,14 +86,7 @@ static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 static bool led_state = false;
 static char response_buf[64];
 
-void led_blinking_task(void);
-
-// Mouse parameters
-#define ENCODER_BASE_SENSITIVITY 5	   // Base encoder sensitivity
-#define MOUSE_SENSITIVITY_MULTIPLIER 2 // Mouse movement multiplier
-#define GAMEPAD_SENSITIVITY 10		   // Gamepad axis sensitivity
-#define SMOOTHING_FACTOR 6.0f		   // Smoothing factor for mouse movement
-#define MAIN_LOOP_INTERVAL_MS 0.1	   // HID report interval
+void led_blinking_task(void *ctx);
 
 // HID Report Echo variables
 static uint8_t received_data[64];
@@ -126,106 +102,48 @@ EC11_Encoder encoder_x, encoder_y;
 
 // Application state and keymap
 static AppState app = {
-	.button_pins = {
-		BTN_BTA,
-		BTN_BTB,
-		BTN_BTC,
-		BTN_BTD,
-		BTN_FXL,
-		BTN_START,
-		BTN_FXR},
-
 	// give default mode as keyboard
 	.current_mode = MODE_KEYBOARD};
 
-static int8_t mouse_x = 0;
-static int8_t mouse_y = 0;
-
-static uint16_t gamepad_x = 0;
-static uint16_t gamepad_y = 0;
-
 static uint32_t prev_btn_state = 0;
 
-static float remaining_delta_x = 0.0f;
-static float remaining_delta_y = 0.0f;
-
 static SystemMode current_mode = MODE_KEYBOARD;
 
-static AnimationState anim_state = {
-	.t = 0,
-	.dir = 1,
-	.pattern_index = 0,
-	.last_update = 0,
-	.pattern_changed = true};
-
-typedef void (*pattern_func)(uint t);
-
-static const int button_led_map[BUTTON_COUNT] = {
-	1, // A -> LED1
-	2, // B -> LED2
-	3, // C -> LED3
-	4, // D -> LED4
-	6, // fxL -> LED6
-	0, // START -> LED0
-	5  // fxR -> LED5
-};
-
-const struct
-{
-	pattern_func pat;
-	const char *name;
-} pattern_table[] = {
-	//{pattern_rainbow, "Rainbow"},
-	{pattern_black, "Black"},
-};
-const uint pattern_count = sizeof(pattern_table) / sizeof(pattern_table[0]);
+// Task periods; lower priority numbers run first when several are due.
+// Buttons and encoders are sampled on core 1 (modules/input).
+#define USB_TASK_PERIOD_US 125	   // Priority 0
+#define HID_TASK_PERIOD_US 100	   // Priority 1, HID report interval
+#define LED_POST_PERIOD_US 1000	   // Priority 2
 
-//--------------------------------------------------------------------+
-// Encoder callbacks
-//---------------------------------------------------------------------
-void encoder_x_callback(EC11_Direction dir, void *user_data)
-{
-	if (current_mode == MODE_GAMEPAD)
-	{
-		gamepad_x = (gamepad_x + dir * GAMEPAD_SENSITIVITY) % 512; // 512 cycle period (2 full rotations)
-	}
-	else
-	{
-		remaining_delta_x += dir * ENCODER_BASE_SENSITIVITY;
-	}
-}
+#define CORE1_READY 0x43315244 // "C1RD"
 
-void encoder_y_callback(EC11_Direction dir, void *user_data)
-{
-	dir = (EC11_Direction)(-dir); //Sry for the shit code, becuz i'm too lazy
-	if (current_mode == MODE_GAMEPAD)
-	{
-		gamepad_y = (gamepad_y + dir * GAMEPAD_SENSITIVITY) % 512;
-	}
-	else
-	{
-		remaining_delta_y += dir * ENCODER_BASE_SENSITIVITY;
-	}
-}
+static Scheduler scheduler;
+static int blink_task;
 
-void hid_task(void);
-static void send_keyboard_report(uint32_t btn);
+static void core1_main(void);
+static void usb_task(void *ctx);
+void hid_task(void *ctx);
+#if PROFILE_ENABLE
+static void profile_report_task(void *ctx);
+#endif
+#if TRACE_ENABLE && TRACE_UART
+static void trace_uart_task(void *ctx);
+#endif
+static void led_post_task(void *ctx);
 
 SystemMode load_system_mode(void);
 void save_system_mode(SystemMode mode);
 
 static void handle_rawhid_response(void);
-static uint32_t read_buttons(void);
-void init_animation(void);
-void update_animation(void);
-void ws2812_update_state(void);
-void update_button_leds(uint32_t btn_state);
 
 //--------------------------------------------------------------------+
 // Main application
 //---------------------------------------------------------------------
 int main(void)
 {
+	// Paint the stacks before anything deep runs
+	memstat_init();
+
 	// Hardware initialization
 	board_init();
 	tusb_rhport_init_t dev_init = {
@@ -236,29 +154,31 @@ int main(void)
 	{
 		board_init_after_tusb();
 	}
+	log_init();
 	current_mode = load_system_mode();
+	LOG(BOOT, current_mode, 0);
 
 	// Initialize buttons with debouncing
-	debounce_init(&app.debounce, app.button_pins);
+	debounce_init(&app.debounce);
 	debounce_set_mode(&app.debounce, ASYM_EAGER_DEFER_PK);
 
 	sleep_ms(10); // Initial debounce delay
 	bool mode_changed = false;
 	SystemMode new_mode = current_mode;
 
-	if (!gpio_get(BTN_START))
+	if (!gpio_get(BOARD_BOOTLOADER_PIN))
 	{
 		reset_usb_boot(0, 0); // Enter bootloader without saving
 	}
 	else
 	{
 		// Check mode selection buttons
-		if (!gpio_get(BTN_BTA))
+		if (!gpio_get(BOARD_MODE_KEYBOARD_PIN))
 		{
 			new_mode = MODE_KEYBOARD;
 			mode_changed = true;
 		}
-		else if (!gpio_get(BTN_BTB))
+		else if (!gpio_get(BOARD_MODE_GAMEPAD_PIN))
 		{
 			new_mode = MODE_GAMEPAD;
 			mode_changed = true;
@@ -272,156 +192,102 @@ int main(void)
 	}
 
 	// Initialize encoders
-	ec11_init(&encoder_x, ENCODER_X_PIN_A, ENCODER_X_PIN_B, encoder_x_callback, NULL);
-	ec11_init(&encoder_y, ENCODER_Y_PIN_A, ENCODER_Y_PIN_B, encoder_y_callback, NULL);
-
-	// Initialize ws2812
-	ws2812_init();
-	remap_init();
-	ws2812_set_brightness(DEFAULT_BRIGHTNESS);
-	init_animation();
-
-	while (1)
+	ec11_init(&encoder_x, ENCODER_X_PIN_A, ENCODER_X_PIN_B, report_encoder_x_callback, NULL);
+	ec11_init(&encoder_y, ENCODER_Y_PIN_A, ENCODER_Y_PIN_B, report_encoder_y_callback, NULL);
+	report_task_init(current_mode == MODE_GAMEPAD ? REPORT_MODE_GAMEPAD : REPORT_MODE_KEYBOARD,
+					 &encoder_x, &encoder_y);
+
+	profile_init();
+
+	// Core 1 samples input and renders LEDs; wait until the strip is set up
+	led_render_init(board_button_led_map, STATUS_PIXEL);
+	input_init(&app.debounce, &encoder_x, &encoder_y);
+	multicore_launch_core1(core1_main);
+	while (multicore_fifo_pop_blocking() != CORE1_READY)
 	{
-		tud_task();
-		handle_rawhid_response();
-		led_blinking_task();
-		ec11_update(&encoder_x);
-		ec11_update(&encoder_y);
-		debounce_update(&app.debounce);
-		hid_task();
-
-		// Update animation (only modify the pixel buffer)
-		update_animation();
-
-		// Added: Read button states and update LEDs
-		uint32_t btn_state = read_buttons();
-		update_button_leds(btn_state);
-
-		// Unified update of the DMA buffer
-		ws2812_update_buffer();
-
-		// Start transfer (if DMA is idle)
-		if (!ws2812_is_busy())
-		{
-			ws2812_start_transfer();
-		}
-
-		// Update DMA state
-		ws2812_update_state();
+		tight_loop_contents();
 	}
-}
 
-//--------------------------------------------------------------------+
-// HID implementation
-//---------------------------------------------------------------------
-static uint32_t read_buttons(void)
-{
-	return debounce_get_states(&app.debounce);
+	// Applies the stored brightness and pre-encodes the button colors with it
+	remap_init();
+	action_init();
+
+	sched_init(&scheduler);
+	sched_add(&scheduler, "usb", usb_task, NULL, USB_TASK_PERIOD_US, 0);
+	sched_add(&scheduler, "hid", hid_task, NULL, HID_TASK_PERIOD_US, 1);
+	sched_add(&scheduler, "led", led_post_task, NULL, LED_POST_PERIOD_US, 2);
+	blink_task = sched_add(&scheduler, "blink", led_blinking_task, NULL, blink_interval_ms * 1000, 3);
+#if PROFILE_ENABLE
+	sched_add(&scheduler, "profile", profile_report_task, NULL, PROFILE_REPORT_MS * 1000, 4);
+#endif
+#if TRACE_ENABLE && TRACE_UART
+	sched_add(&scheduler, "trace", trace_uart_task, NULL, TRACE_UART_MS * 1000, 5);
+#endif
+
+	// Sleeps in WFE whenever nothing is due
+	sched_run(&scheduler);
 }
 
-static void send_keyboard_report(uint32_t btn)
+static void core1_main(void)
 {
-	if (!tud_hid_n_ready(ITF_KEYBOARD))
-		return;
-
-	static uint32_t prev_btn_state = 0;
-	if (btn == prev_btn_state)
-		return;
-	prev_btn_state = btn;
+	static Scheduler core1_scheduler;
 
-	uint8_t keycode[6] = {0};
-	uint8_t key_cnt = 0;
-	// fix for under c99,do not use static const
+	// Let core 0 park this core while it erases or programs flash
+	multicore_lockout_victim_init();
+	profile_init();
 
-	const RemapConfig *config = remap_get_config();
+	// Timers, IRQ handlers and alarm pools attach to this core
+	input_start();
+	sched_init(&core1_scheduler);
+	led_render_start(&core1_scheduler);
 
-	for (int i = 0; i < BUTTON_COUNT && key_cnt < 6; i++)
-	{
-		if (btn & (1 << i))
-		{
-			keycode[key_cnt++] = config->keymap_keyboard[i];
-		}
-	}
-	tud_hid_n_keyboard_report(ITF_KEYBOARD, 0, 0, key_cnt ? keycode : NULL);
+	multicore_fifo_push_blocking(CORE1_READY);
+	sched_run(&core1_scheduler);
 }
 
-static void handle_keyboard_mouse_mode(uint32_t btn_state)
+static void usb_task(void *ctx)
 {
-	send_keyboard_report(btn_state);
-
-	int8_t step_x = 0;
-	int8_t step_y = 0;
-
-	// X-axis processing
-	if (fabsf(remaining_delta_x) >= 1.0f)
-	{
-		const float ideal_step = remaining_delta_x / SMOOTHING_FACTOR;
-		int8_t quantized_step = (int8_t)roundf(ideal_step);
-
-		if (fabsf(quantized_step) > fabsf(remaining_delta_x))
-		{
-			quantized_step = (remaining_delta_x > 0) ? 1 : -1;
-		}
-
-		remaining_delta_x -= quantized_step;
-		step_x = quantized_step * MOUSE_SENSITIVITY_MULTIPLIER;
-	}
-
-	// Y-axis processing
-	if (fabsf(remaining_delta_y) >= 1.0f)
-	{
-		const float ideal_step = remaining_delta_y / SMOOTHING_FACTOR;
-		int8_t quantized_step = (int8_t)roundf(ideal_step);
-
-		if (fabsf(quantized_step) > fabsf(remaining_delta_y))
-		{
-			quantized_step = (remaining_delta_y > 0) ? 1 : -1;
-		}
-
-		remaining_delta_y -= quantized_step;
-		step_y = quantized_step * MOUSE_SENSITIVITY_MULTIPLIER;
-	}
-
-	if ((step_x != 0 || step_y != 0) && tud_hid_n_ready(ITF_MOUSE))
-	{
-		tud_hid_n_mouse_report(ITF_MOUSE, 0, 0x00, step_x, step_y, 0, 0);
-	}
+	(void)ctx;
+	PROFILE_BEGIN(USB);
+	tud_task();
+	PROFILE_END(USB);
+	handle_rawhid_response();
 }
 
-static void handle_gamepad_mode(uint32_t btn_state)
+#if PROFILE_ENABLE
+static void profile_report_task(void *ctx)
 {
-	uint32_t gamepad_buttons = 0;
-	// fix for under c99,do not use static const
-
-	const RemapConfig *config = remap_get_config();
-	for (int i = 0; i < BUTTON_COUNT; i++)
-	{
-		if (btn_state & (1 << i))
-		{
-			gamepad_buttons |= (1 << config->keymap_gamepad[i]);
-		}
-	}
+	(void)ctx;
+	profile_print_summary();
+}
+#endif
 
-	// Map encoder positions to gamepad axes  
-	int16_t mapped_x = (int16_t)gamepad_x * 255 / 256 - 255;
-	int16_t mapped_y = (int16_t)gamepad_y * 255 / 256 - 255;
+#if TRACE_ENABLE && TRACE_UART
+static void trace_uart_task(void *ctx)
+{
+	(void)ctx;
+	trace_print(TRACE_UART_BATCH);
+}
+#endif
 
-	int8_t axis_x = (int8_t)(mapped_x);
-	int8_t axis_y = (int8_t)(mapped_y);
+// Hand the input state to the core 1 renderer
+static void led_post_task(void *ctx)
+{
+	(void)ctx;
+	uint8_t layer = (current_mode == MODE_KEYBOARD) ? action_get_layer() : 0;
+	led_render_post(report_task_buttons(), layer);
+}
 
-	if (tud_hid_n_ready(ITF_GAMEPAD))
-	{
-		tud_hid_n_gamepad_report(ITF_GAMEPAD, 0,
-								 axis_x, // X
-								 axis_y, // Y
-								 0,		 // Z
-								 0,		 // Rz
-								 0,		 // Rx
-								 0,		 // Ry
-								 0,		 // Hat
-								 gamepad_buttons);
-	}
+//--------------------------------------------------------------------+
+// HID implementation
+//---------------------------------------------------------------------
+// Queues the first size bytes of received_data as the raw HID reply
+static void queue_rawhid_reply(uint8_t itf, uint8_t report_id, uint16_t size)
+{
+	received_size = size;
+	received_report_id = report_id;
+	received_itf = itf;
+	send_response = true;
 }
 
 static void handle_rawhid_response(void)
@@ -437,35 +303,12 @@ static void handle_rawhid_response(void)
 	}
 }
 
-void hid_task(void)
+void hid_task(void *ctx)
 {
-	static uint32_t start_ms = 0;
-	const uint32_t current_time = board_millis();
-
-	if (current_time - start_ms < MAIN_LOOP_INTERVAL_MS)
-		return;
-	start_ms = current_time;
-
-	const uint32_t btn_state = read_buttons();
-
-	if (tud_suspended())
-	{
-		if (btn_state)
-			tud_remote_wakeup();
-		return;
-	}
-
-	switch (current_mode)
-	{
-	case MODE_KEYBOARD:
-		handle_keyboard_mouse_mode(btn_state);
-		break;
-	case MODE_GAMEPAD:
-		handle_gamepad_mode(btn_state);
-		break;
-	default:
-		break;
-	}
+	(void)ctx;
+	PROFILE_BEGIN(HID);
+	report_task_run();
+	PROFILE_END(HID);
 }
 
 //--------------------------------------------------------------------+
@@ -473,7 +316,7 @@ void hid_task(void)
 //---------------------------------------------------------------------
 SystemMode load_system_mode(void)
 {
-	const SystemConfig *config = (const SystemConfig *)(XIP_BASE + SYSTEM_CONFIG_OFFSET);
+	const SystemConfig *config = hal_flash_read(SYSTEM_CONFIG_OFFSET);
 	if (config->magic == FLASH_CONFIG_MAGIC)
 	{
 		return config->mode;
@@ -488,14 +331,8 @@ void save_system_mode(SystemMode mode)
 		.mode = mode,
 	};
 
-	uint8_t sector[FLASH_SECTOR_SIZE] = {0};
-	memcpy(sector, &config, sizeof(config));
-
-	// Safe flash operations
-	uint32_t ints = save_and_disable_interrupts();
-	flash_range_erase(SYSTEM_CONFIG_OFFSET, FLASH_SECTOR_SIZE);
-	flash_range_program(SYSTEM_CONFIG_OFFSET, sector, FLASH_SECTOR_SIZE);
-	restore_interrupts(ints);
+	hal_flash_write_sector(SYSTEM_CONFIG_OFFSET, &config, sizeof(config));
+	LOG(MODE_SAVED, mode, 0);
 }
 
 
@@ -506,13 +343,21 @@ void save_system_mode(SystemMode mode)
 void tud_mount_cb(void)
 {
 	blink_interval_ms = BLINK_MOUNTED;
+	LOG(USB_MOUNTED, 0, 0);
+}
+void tud_umount_cb(void)
+{
+	LOG(USB_UNMOUNTED, 0, 0);
 }
-void tud_umount_cb(void) {}
 void tud_suspend_cb(bool remote_wakeup_en)
 {
 	(void)remote_wakeup_en;
+	LOG(USB_SUSPENDED, remote_wakeup_en, 0);
+}
+void tud_resume_cb(void)
+{
+	LOG(USB_RESUMED, 0, 0);
 }
-void tud_resume_cb(void) {}
 
 uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id,
 							   hid_report_type_t report_type, uint8_t *buffer,
@@ -537,11 +382,17 @@ void tud_hid_set_report_cb(
 
 	if (itf == ITF_GENERIC)
 	{
+		// Lighting stream: forwarded to the renderer, no reply and no flash write
+		if (bufsize >= 1 && led_stream_is_command(buffer[0]))
+		{
+			led_render_post_stream(buffer, bufsize);
+			return;
+		}
+
 		//get version
 		if (bufsize >= 1 && buffer[0] == 0x81)
 		{
-			received_size = sizeof(received_data);
-			remap_ret_firmware_version(received_data, received_size);
+			remap_ret_firmware_version(received_data, sizeof(received_data));
 
 			memmove(received_data + 1, received_data, strlen((char*)received_data));
 			received_data[0] = buffer[0]; // Add 0x81 header
@@ -553,30 +404,103 @@ void tud_hid_set_report_cb(
 				memset(received_data + new_size, 0, sizeof(received_data) - new_size);
 			}
 
-			received_report_id = report_id;
-			received_itf = itf;
-			send_response = true;
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
 			return;
 		}
 		
 		// Check if it is a request configuration command (0x82)
 		if (bufsize >= 1 && buffer[0] == 0x82)
 		{
-			received_size = sizeof(received_data);
-			remap_get_raw_config(received_data, received_size);
+			remap_get_raw_config(received_data, sizeof(received_data));
 
-			memmove(received_data + 1, received_data, sizeof(RemapConfig));
+			memmove(received_data + 1, received_data, REMAP_RAW_CONFIG_SIZE);
 			received_data[0] = buffer[0]; // Add 0x82 header
 
-			size_t new_size = sizeof(RemapConfig) + 1;
+			size_t new_size = REMAP_RAW_CONFIG_SIZE + 1;
 			if (new_size < sizeof(received_data))
 			{
 				memset(received_data + new_size, 0, sizeof(received_data) - new_size);
 			}
 
-			received_report_id = report_id;
-			received_itf = itf;
-			send_response = true;
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+#if PROFILE_ENABLE
+		// Read one profiler probe (0x84, probe); probe 0xFF resets all probes
+		if (bufsize >= 2 && buffer[0] == 0x84)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			received_data[0] = buffer[0];
+			if (buffer[1] == 0xFF)
+				profile_reset();
+			else
+				profile_write_report(buffer[1], received_data + 1, sizeof(received_data) - 1);
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+		// XIP cache counters (0x85); 0x85 0xFF clears them
+		if (bufsize >= 1 && buffer[0] == 0x85)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			received_data[0] = buffer[0];
+			if (bufsize >= 2 && buffer[1] == 0xFF)
+				profile_reset_xip();
+			else
+				profile_write_xip_report(received_data + 1, sizeof(received_data) - 1);
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+#endif
+		// Stack high-water marks and RAM headroom (0x88)
+		if (bufsize >= 1 && buffer[0] == MEMSTAT_COMMAND)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			memstat_write_report(received_data, sizeof(received_data));
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+		// Effect selection and render stats (0x89)
+		if (bufsize >= 1 && buffer[0] == LED_STATUS_COMMAND)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			led_render_write_report(received_data, sizeof(received_data));
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+#if INPUT_TRACE_ENABLE
+		// Raw input recorder (0x86, sub-command, ...)
+		if (bufsize >= 2 && buffer[0] == INPUT_TRACE_COMMAND)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			input_trace_write_report(buffer, bufsize, received_data, sizeof(received_data));
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+#endif
+#if TRACE_ENABLE
+		// Event tracer (0x87, sub-command)
+		if (bufsize >= 2 && buffer[0] == TRACE_COMMAND)
+		{
+			memset(received_data, 0, sizeof(received_data));
+			trace_write_report(buffer, bufsize, received_data, sizeof(received_data));
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
+			return;
+		}
+#endif
+		// Read a chunk of the action engine config (0x83, offset high, offset low)
+		if (bufsize >= 3 && buffer[0] == 0x83)
+		{
+			uint16_t offset = (buffer[1] << 8) | buffer[2];
+			remap_get_raw_action_config(offset, received_data + 1, sizeof(received_data) - 1);
+			received_data[0] = buffer[0]; // Add 0x83 header
+
+			queue_rawhid_reply(itf, report_id, sizeof(received_data));
 			return;
 		}
 		if(bufsize >= 2)
@@ -587,20 +511,16 @@ void tud_hid_set_report_cb(
 			// Save the configuration to flash (only if the command was processed successfully)
 			if (processed) {
 				remap_save_config();
+				LOG(CONFIG_SAVED, 0, 0);
+			} else {
+				LOG(CONFIG_REJECTED, buffer[0], 0);
 			}
 
 			// Construct response: The first byte is the processing status (0=success, 1=failure)
 			received_data[0] = processed ? 0x00 : 0x01;
-			received_size = 1;
-			
-			// Fill the remaining bytes with 0
-			if (received_size < sizeof(received_data)) {
-				memset(received_data + received_size, 0, sizeof(received_data) - received_size);
-			}
+			memset(received_data + 1, 0, sizeof(received_data) - 1);
 
-			received_report_id = report_id;
-			received_itf = itf;
-			send_response = true;
+			queue_rawhid_reply(itf, report_id, 1);
 			return;
 		}
 		else
@@ -615,16 +535,12 @@ void tud_hid_set_report_cb(
 
 			received_data[0] = 0x00;
 
-			received_size = copy_size + 1;
-
-			if (received_size < sizeof(received_data))
+			if (copy_size + 1 < sizeof(received_data))
 			{
-				memset(received_data + received_size, 0, sizeof(received_data) - received_size);
+				memset(received_data + copy_size + 1, 0, sizeof(received_data) - copy_size - 1);
 			}
 
-			received_report_id = report_id;
-			received_itf = itf;
-			send_response = true;
+			queue_rawhid_reply(itf, report_id, copy_size + 1);
 		}
 	}
 }
@@ -634,67 +550,16 @@ void tud_hid_report_complete_cb(uint8_t itf, uint8_t const *report, uint16_t len
 	(void)itf;
 	(void)report;
 	(void)len;
+	TRACE_EVENT(REPORT_DONE, itf, len);
 }
 
-void led_blinking_task(void)
+void led_blinking_task(void *ctx)
 {
-	static uint32_t start_ms = 0;
-
-	if (board_millis() - start_ms < blink_interval_ms)
-		return;
-	start_ms = board_millis();
+	(void)ctx;
 
 	board_led_write(led_state);
 	led_state = !led_state;
-}
 
-void init_animation(void)
-{
-	anim_state.t = 0;
-	anim_state.dir = (rand() >> 30) & 1 ? 1 : -1;
-	anim_state.pattern_index = rand() % pattern_count;
-	anim_state.last_update = time_us_32();
-	anim_state.pattern_changed = true;
+	// The interval changes with the USB state
+	sched_set_period(&scheduler, blink_task, blink_interval_ms * 1000);
 }
-
-// Update animation (non-blocking)
-void update_animation(void)
-{
-	uint32_t now = time_us_32();
-
-	if ((now - anim_state.last_update) < (UPDATE_INTERVAL_MS * 1000))
-	{
-		return;
-	}
-
-	anim_state.last_update = now;
-
-	if (anim_state.t % 1000 == 0)
-	{
-		anim_state.pattern_index = (anim_state.pattern_index + 1) % pattern_count;
-		anim_state.dir = (rand() >> 30) & 1 ? 1 : -1;
-		anim_state.pattern_changed = true;
-	}
-
-	// Update the pixel buffer for all LEDs
-	pattern_table[anim_state.pattern_index].pat(anim_state.t);
-	anim_state.t += anim_state.dir;
-
-}
-
-void update_button_leds(uint32_t btn_state)
-{
-	for (int BUTTON_INDEX = 0; BUTTON_INDEX < BUTTON_COUNT; BUTTON_INDEX++)
-	
-	{
-		const int LED_INDEX = button_led_map[BUTTON_INDEX];
-		// fix for under c99,do not use static const
-
-		const RemapConfig *config = remap_get_config();
-		if (btn_state & (1 << BUTTON_INDEX))
-		{
-			RGBColor color = config->button_colors[BUTTON_INDEX];
-			set_button_color(LED_INDEX, color.r, color.g, color.b);
-		}
-	}
-}
\ No newline at end of file
@@ -0,0 +1,657 @@
+#include "action.h"
+#include "modules/hal/hal.h"
+#include <string.h>
+
+#define ACTION_EVENT_QUEUE_SIZE 16 // Pending deadlines (timeouts, tap releases, macro steps)
+#define ACTION_KEYSET_SIZE 8       // Keys held by the engine outside the per-layer LUTs
+#define ACTION_NO_BUTTON 0xFF
+
+typedef enum
+{
+    EVENT_TAPHOLD_TIMEOUT,
+    EVENT_TAP_RELEASE,
+    EVENT_COMBO_TIMEOUT,
+    EVENT_MACRO_STEP
+} ActionEventType;
+
+typedef struct
+{
+    uint64_t deadline;
+    uint8_t type;
+    uint8_t arg;
+} ActionEvent;
+
+typedef struct
+{
+    uint8_t keycode;
+    uint8_t refs;
+} HeldKey;
+
+typedef struct
+{
+    uint32_t physical;
+    // Buttons resolved to plain keys, bucketed by the layer active at press
+    uint32_t layer_masks[ACTION_LAYER_COUNT];
+    uint8_t press_layer[BUTTON_COUNT];
+    uint16_t press_action[BUTTON_COUNT];
+    uint8_t layer_refs[ACTION_LAYER_COUNT];
+    uint8_t toggled_layers;
+
+    // Tap-hold: at most one undecided key, settled by timeout or another press
+    uint8_t pending_button;
+    uint32_t hold_resolved;
+
+    // Combos: presses buffered until they complete a combo or the term expires
+    uint32_t combo_buffer;
+    uint8_t combo_order[BUTTON_COUNT];
+    uint64_t combo_times[BUTTON_COUNT];
+    uint8_t combo_order_count;
+    uint32_t combo_consumed;
+    uint8_t combo_active;
+
+    // Macro runner
+    int8_t macro;
+    uint8_t macro_step;
+    bool macro_tap_release;
+    uint32_t macro_keys[8]; // Bitmap of keycodes pressed by the running macro
+
+    HeldKey keys[ACTION_KEYSET_SIZE];
+
+    ActionEvent events[ACTION_EVENT_QUEUE_SIZE];
+    uint8_t event_count;
+} ActionState;
+
+static ActionState state;
+static hal_lock_t *action_lock;
+static uint action_alarm;
+
+//--------------------------------------------------------------------+
+// Deadline queue, kept sorted so the alarm always targets events[0]
+//--------------------------------------------------------------------+
+static bool schedule(uint8_t type, uint8_t arg, uint64_t deadline)
+{
+    if (state.event_count >= ACTION_EVENT_QUEUE_SIZE)
+        return false;
+
+    int i = state.event_count++;
+    while (i > 0 && state.events[i - 1].deadline > deadline)
+    {
+        state.events[i] = state.events[i - 1];
+        i--;
+    }
+    state.events[i] = (ActionEvent){.deadline = deadline, .type = type, .arg = arg};
+    return true;
+}
+
+static void cancel(uint8_t type, uint8_t arg)
+{
+    for (int i = 0; i < state.event_count; i++)
+    {
+        if (state.events[i].type == type && state.events[i].arg == arg)
+        {
+            memmove(&state.events[i], &state.events[i + 1],
+                    (state.event_count - i - 1) * sizeof(ActionEvent));
+            state.event_count--;
+            return;
+        }
+    }
+}
+
+static void arm_alarm(void)
+{
+    if (state.event_count == 0)
+    {
+        hal_alarm_cancel(action_alarm);
+        return;
+    }
+
+    // A deadline already in the past is handled straight away in the IRQ
+    if (hal_alarm_set(action_alarm, state.events[0].deadline))
+    {
+        hal_alarm_force(action_alarm);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Output state
+//--------------------------------------------------------------------+
+static void key_press(uint8_t keycode)
+{
+    HeldKey *free_slot = NULL;
+
+    if (keycode == 0)
+        return;
+
+    for (int i = 0; i < ACTION_KEYSET_SIZE; i++)
+    {
+        if (state.keys[i].keycode == keycode)
+        {
+            state.keys[i].refs++;
+            return;
+        }
+        if (!free_slot && state.keys[i].keycode == 0)
+        {
+            free_slot = &state.keys[i];
+        }
+    }
+
+    if (free_slot)
+    {
+        *free_slot = (HeldKey){.keycode = keycode, .refs = 1};
+    }
+}
+
+static void key_release(uint8_t keycode)
+{
+    for (int i = 0; i < ACTION_KEYSET_SIZE; i++)
+    {
+        if (state.keys[i].keycode == keycode && keycode != 0)
+        {
+            if (--state.keys[i].refs == 0)
+            {
+                state.keys[i].keycode = 0;
+            }
+            return;
+        }
+    }
+}
+
+// Press now and release after the tap release time so the host sees it
+static void key_tap(uint8_t keycode, uint64_t t)
+{
+    const ActionConfig *config = &remap_acquire()->action;
+
+    key_press(keycode);
+    if (!schedule(EVENT_TAP_RELEASE, keycode, t + config->tap_release_ms * 1000ull))
+    {
+        key_release(keycode);
+    }
+}
+
+static uint8_t current_layer(void)
+{
+    for (int layer = ACTION_LAYER_COUNT - 1; layer > 0; layer--)
+    {
+        if (state.layer_refs[layer] || (state.toggled_layers & (1u << layer)))
+            return layer;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------+
+// Macros
+//--------------------------------------------------------------------+
+static void macro_end(void)
+{
+    for (int kc = 0; kc < 256; kc++)
+    {
+        if (state.macro_keys[kc >> 5] & (1u << (kc & 31)))
+        {
+            key_release(kc);
+        }
+    }
+    memset(state.macro_keys, 0, sizeof(state.macro_keys));
+    state.macro = -1;
+    state.macro_tap_release = false;
+}
+
+// Run steps until one asks to wait; t is the exact time the step is due
+static void macro_advance(uint64_t t)
+{
+    const ActionConfig *config = &remap_acquire()->action;
+
+    while (state.macro >= 0)
+    {
+        if (state.macro_step >= ACTION_MACRO_STEPS)
+        {
+            macro_end();
+            return;
+        }
+
+        const MacroStep *step = &config->macros[state.macro][state.macro_step];
+
+        if (state.macro_tap_release)
+        {
+            key_release(step->keycode);
+            state.macro_keys[step->keycode >> 5] &= ~(1u << (step->keycode & 31));
+            state.macro_tap_release = false;
+            state.macro_step++;
+            continue;
+        }
+
+        switch (step->op)
+        {
+        case MACRO_OP_PRESS:
+            key_press(step->keycode);
+            state.macro_keys[step->keycode >> 5] |= 1u << (step->keycode & 31);
+            break;
+
+        case MACRO_OP_RELEASE:
+            key_release(step->keycode);
+            state.macro_keys[step->keycode >> 5] &= ~(1u << (step->keycode & 31));
+            break;
+
+        case MACRO_OP_TAP:
+        {
+            uint64_t hold_us = step->delay_us ? step->delay_us : config->tap_release_ms * 1000ull;
+            key_press(step->keycode);
+            state.macro_keys[step->keycode >> 5] |= 1u << (step->keycode & 31);
+            state.macro_tap_release = true;
+            if (!schedule(EVENT_MACRO_STEP, 0, t + hold_us))
+                macro_end();
+            return;
+        }
+
+        case MACRO_OP_WAIT:
+            break;
+
+        default:
+            macro_end();
+            return;
+        }
+
+        state.macro_step++;
+        if (step->delay_us)
+        {
+            if (!schedule(EVENT_MACRO_STEP, 0, t + step->delay_us))
+                macro_end();
+            return;
+        }
+    }
+}
+
+static void macro_start(uint8_t index, uint64_t t)
+{
+    // One macro runs at a time; presses while it runs are ignored
+    if (state.macro >= 0 || index >= ACTION_MACRO_COUNT)
+        return;
+
+    state.macro = index;
+    state.macro_step = 0;
+    state.macro_tap_release = false;
+    macro_advance(t);
+}
+
+//--------------------------------------------------------------------+
+// Actions
+//--------------------------------------------------------------------+
+
+// Press for actions not tied to a button (combos)
+static void action_press(uint16_t action, uint64_t t)
+{
+    switch (ACTION_TYPE(action))
+    {
+    case ACTION_TYPE_KEY:
+        key_press(ACTION_KEYCODE(action));
+        break;
+    case ACTION_TYPE_MO:
+        if (ACTION_INDEX(action) < ACTION_LAYER_COUNT)
+            state.layer_refs[ACTION_INDEX(action)]++;
+        break;
+    case ACTION_TYPE_TG:
+        state.toggled_layers ^= 1u << (ACTION_INDEX(action) % ACTION_LAYER_COUNT);
+        break;
+    case ACTION_TYPE_LT:
+    case ACTION_TYPE_MT:
+        // No tap-hold decision for combos: treat as a tap
+        key_tap(ACTION_KEYCODE(action), t);
+        break;
+    case ACTION_TYPE_MACRO:
+        macro_start(ACTION_INDEX(action), t);
+        break;
+    }
+}
+
+static void action_release(uint16_t action)
+{
+    switch (ACTION_TYPE(action))
+    {
+    case ACTION_TYPE_KEY:
+        key_release(ACTION_KEYCODE(action));
+        break;
+    case ACTION_TYPE_MO:
+        if (ACTION_INDEX(action) < ACTION_LAYER_COUNT && state.layer_refs[ACTION_INDEX(action)])
+            state.layer_refs[ACTION_INDEX(action)]--;
+        break;
+    }
+}
+
+static void taphold_resolve_hold(void)
+{
+    uint8_t button = state.pending_button;
+    uint16_t action = state.press_action[button];
+
+    // Only a hold that took effect is undone on release
+    if (ACTION_TYPE(action) == ACTION_TYPE_LT && ACTION_PARAM(action) < ACTION_LAYER_COUNT)
+    {
+        state.layer_refs[ACTION_PARAM(action)]++;
+        state.hold_resolved |= 1u << button;
+    }
+    else if (ACTION_TYPE(action) == ACTION_TYPE_MT)
+    {
+        key_press(0xE0 + (ACTION_PARAM(action) & 7));
+        state.hold_resolved |= 1u << button;
+    }
+
+    state.pending_button = ACTION_NO_BUTTON;
+    cancel(EVENT_TAPHOLD_TIMEOUT, button);
+}
+
+static void button_dispatch_press(uint8_t button, uint64_t t)
+{
+    const RemapSnapshot *snapshot = remap_acquire();
+    uint8_t layer = current_layer();
+    uint16_t action = snapshot->tables.layer_actions[layer][button];
+
+    state.press_layer[button] = layer;
+    state.press_action[button] = action;
+
+    switch (ACTION_TYPE(action))
+    {
+    case ACTION_TYPE_KEY:
+        state.layer_masks[layer] |= 1u << button;
+        break;
+    case ACTION_TYPE_LT:
+    case ACTION_TYPE_MT:
+        state.pending_button = button;
+        schedule(EVENT_TAPHOLD_TIMEOUT, button, t + snapshot->action.tapping_term_ms * 1000ull);
+        break;
+    default:
+        action_press(action, t);
+        break;
+    }
+}
+
+static void button_dispatch_release(uint8_t button, uint64_t t)
+{
+    uint32_t bit = 1u << button;
+    uint16_t action = state.press_action[button];
+
+    if (state.pending_button == button)
+    {
+        // Released inside the tapping term: it was a tap
+        state.pending_button = ACTION_NO_BUTTON;
+        cancel(EVENT_TAPHOLD_TIMEOUT, button);
+        key_tap(ACTION_KEYCODE(action), t);
+        return;
+    }
+
+    switch (ACTION_TYPE(action))
+    {
+    case ACTION_TYPE_KEY:
+        state.layer_masks[state.press_layer[button]] &= ~bit;
+        break;
+    case ACTION_TYPE_LT:
+        if ((state.hold_resolved & bit) && ACTION_PARAM(action) < ACTION_LAYER_COUNT &&
+            state.layer_refs[ACTION_PARAM(action)])
+            state.layer_refs[ACTION_PARAM(action)]--;
+        break;
+    case ACTION_TYPE_MT:
+        if (state.hold_resolved & bit)
+            key_release(0xE0 + (ACTION_PARAM(action) & 7));
+        break;
+    default:
+        action_release(action);
+        break;
+    }
+    state.hold_resolved &= ~bit;
+}
+
+// Replay buffered combo presses as ordinary presses, in the order they
+// happened. A button released while buffered becomes a tap.
+static void combo_flush(uint8_t released_button, uint64_t t)
+{
+    uint8_t count = state.combo_order_count;
+
+    cancel(EVENT_COMBO_TIMEOUT, 0);
+    state.combo_buffer = 0;
+    state.combo_order_count = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t button = state.combo_order[i];
+        if (state.pending_button != ACTION_NO_BUTTON)
+        {
+            taphold_resolve_hold();
+        }
+        button_dispatch_press(button, state.combo_times[button]);
+        if (button == released_button)
+        {
+            if (state.pending_button == button || ACTION_TYPE(state.press_action[button]) != ACTION_TYPE_KEY)
+            {
+                button_dispatch_release(button, t);
+            }
+            else
+            {
+                state.layer_masks[state.press_layer[button]] &= ~(1u << button);
+                key_tap(ACTION_KEYCODE(state.press_action[button]), t);
+            }
+        }
+    }
+}
+
+// Returns true when the press was absorbed by the combo buffer
+static bool combo_buffer_press(uint8_t button, uint64_t t)
+{
+    const ActionConfig *config = &remap_acquire()->action;
+    uint32_t buffer = state.combo_buffer | (1u << button);
+    bool partial = false;
+
+    for (int i = 0; i < ACTION_COMBO_COUNT; i++)
+    {
+        const ComboDef *combo = &config->combos[i];
+        if (combo->action == ACTION_NONE || __builtin_popcount(combo->buttons) < 2)
+            continue;
+
+        if (combo->buttons == buffer)
+        {
+            cancel(EVENT_COMBO_TIMEOUT, 0);
+            state.combo_buffer = 0;
+            state.combo_order_count = 0;
+            state.combo_consumed |= buffer;
+            state.combo_active |= 1u << i;
+            action_press(combo->action, t);
+            return true;
+        }
+        if ((combo->buttons & buffer) == buffer)
+        {
+            partial = true;
+        }
+    }
+
+    if (!partial)
+    {
+        if (state.combo_buffer)
+            combo_flush(ACTION_NO_BUTTON, t);
+        return false;
+    }
+
+    if (state.combo_buffer == 0)
+    {
+        schedule(EVENT_COMBO_TIMEOUT, 0, t + config->combo_term_ms * 1000ull);
+    }
+    state.combo_buffer = buffer;
+    state.combo_times[button] = t;
+    state.combo_order[state.combo_order_count++] = button;
+    return true;
+}
+
+static void combo_release(uint8_t button)
+{
+    const ActionConfig *config = &remap_acquire()->action;
+
+    // The first button released ends the combo; the rest are swallowed
+    for (int i = 0; i < ACTION_COMBO_COUNT; i++)
+    {
+        if ((state.combo_active & (1u << i)) && (config->combos[i].buttons & (1u << button)))
+        {
+            state.combo_active &= ~(1u << i);
+            action_release(config->combos[i].action);
+        }
+    }
+    state.combo_consumed &= ~(1u << button);
+}
+
+static void button_press(uint8_t button, uint64_t t)
+{
+    uint32_t bit = 1u << button;
+
+    // Any other press settles an undecided tap-hold key as hold
+    if (state.pending_button != ACTION_NO_BUTTON)
+    {
+        taphold_resolve_hold();
+    }
+
+    if (remap_acquire()->tables.combo_buttons & bit)
+    {
+        if (combo_buffer_press(button, t))
+            return;
+    }
+    else if (state.combo_buffer)
+    {
+        combo_flush(ACTION_NO_BUTTON, t);
+    }
+
+    button_dispatch_press(button, t);
+}
+
+static void button_release(uint8_t button, uint64_t t)
+{
+    uint32_t bit = 1u << button;
+
+    if (state.combo_buffer & bit)
+    {
+        combo_flush(button, t);
+        return;
+    }
+    if (state.combo_consumed & bit)
+    {
+        combo_release(button);
+        return;
+    }
+    button_dispatch_release(button, t);
+}
+
+//--------------------------------------------------------------------+
+// Alarm IRQ
+//--------------------------------------------------------------------+
+static void run_event(const ActionEvent *event)
+{
+    switch (event->type)
+    {
+    case EVENT_TAPHOLD_TIMEOUT:
+        if (state.pending_button == event->arg)
+            taphold_resolve_hold();
+        break;
+    case EVENT_TAP_RELEASE:
+        key_release(event->arg);
+        break;
+    case EVENT_COMBO_TIMEOUT:
+        combo_flush(ACTION_NO_BUTTON, event->deadline);
+        break;
+    case EVENT_MACRO_STEP:
+        macro_advance(event->deadline);
+        break;
+    }
+}
+
+static void action_alarm_callback(uint alarm_num)
+{
+    (void)alarm_num;
+    uint32_t save = hal_lock_enter(action_lock);
+
+    while (state.event_count && state.events[0].deadline <= hal_time_us_64())
+    {
+        ActionEvent event = state.events[0];
+        memmove(&state.events[0], &state.events[1], (state.event_count - 1) * sizeof(ActionEvent));
+        state.event_count--;
+        run_event(&event);
+    }
+    arm_alarm();
+
+    hal_lock_exit(action_lock, save);
+}
+
+//--------------------------------------------------------------------+
+// Public API
+//--------------------------------------------------------------------+
+void action_init(void)
+{
+    action_lock = hal_lock_claim();
+    action_alarm = hal_alarm_claim(action_alarm_callback);
+    action_reset();
+}
+
+void action_reset(void)
+{
+    uint32_t save = hal_lock_enter(action_lock);
+
+    memset(&state, 0, sizeof(state));
+    state.pending_button = ACTION_NO_BUTTON;
+    state.macro = -1;
+    hal_alarm_cancel(action_alarm);
+
+    hal_lock_exit(action_lock, save);
+}
+
+void action_process(uint32_t btn_state, uint64_t now_us)
+{
+    uint32_t save = hal_lock_enter(action_lock);
+    uint32_t changed = btn_state ^ state.physical;
+
+    if (changed)
+    {
+        while (changed)
+        {
+            uint8_t button = __builtin_ctz(changed);
+            changed &= changed - 1;
+
+            if (button >= BUTTON_COUNT)
+                continue;
+            if (btn_state & (1u << button))
+                button_press(button, now_us);
+            else
+                button_release(button, now_us);
+        }
+        state.physical = btn_state;
+        arm_alarm();
+    }
+
+    hal_lock_exit(action_lock, save);
+}
+
+void action_build_keyboard(RemapKeyList *keys)
+{
+    const RemapTables *tables = remap_get_tables();
+    uint32_t save = hal_lock_enter(action_lock);
+
+    *keys = (RemapKeyList){0};
+    for (int layer = 0; layer < ACTION_LAYER_COUNT; layer++)
+    {
+        if (state.layer_masks[layer])
+            remap_lookup_keyboard(tables, layer, state.layer_masks[layer], keys);
+    }
+
+    for (int i = 0; i < ACTION_KEYSET_SIZE; i++)
+    {
+        uint8_t keycode = state.keys[i].keycode;
+        if (keycode == 0)
+            continue;
+
+        if (remap_keycode_is_modifier(keycode))
+        {
+            keys->modifiers |= 1u << (keycode - 0xE0);
+        }
+        else if (keys->count < REMAP_MAX_KEYS && !memchr(keys->keycodes, keycode, keys->count))
+        {
+            keys->keycodes[keys->count++] = keycode;
+        }
+    }
+
+    hal_lock_exit(action_lock, save);
+}
+
+uint8_t action_get_layer(void)
+{
+    return current_layer();
+}
@@ -0,0 +1,26 @@
+#ifndef ACTION_H
+#define ACTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/remap/remap.h"
+
+// Resolves physical button changes into keyboard output using the layer,
+// tap-hold, combo and macro definitions of the active ActionConfig.
+// Timeouts and macro steps run from a dedicated hardware alarm, so their
+// output changes land on exact microsecond deadlines.
+
+void action_init(void);
+void action_reset(void);
+
+// Feed the current debounced button state; changed bits become press/release
+// events stamped with now_us.
+void action_process(uint32_t btn_state, uint64_t now_us);
+
+// Current keyboard output: plain keys looked up per press layer plus keys
+// held by taps, mod-taps, combos and macros.
+void action_build_keyboard(RemapKeyList *keys);
+
+uint8_t action_get_layer(void);
+
+#endif
@@ -1,26 +1,45 @@
 #include "debounce.h"
+#include "modules/trace/trace.h"
 
 #ifndef DEBOUNCE_TIME_US
 #define DEBOUNCE_TIME_US 7000
 #endif
 
-static void debounce_none(DebounceState *state)
+// A constant table, so the scan's shifts fold into immediates
+static const uint8_t button_pins[BUTTON_COUNT] = BOARD_BUTTON_PINS;
+
+// One read of every button GPIO, pressed (low) = 1 at the pin's bit
+static inline uint32_t read_pressed_pins(void)
+{
+    return ~hal_gpio_get_all() & BUTTON_PIN_MASK;
+}
+
+static void HAL_RAM_FUNC(debounce_none)(DebounceState *state)
 {
+    uint32_t pressed_pins = read_pressed_pins();
+    uint32_t raw = 0;
     for (int i = 0; i < BUTTON_COUNT; i++)
     {
-        bool gpio_state = !gpio_get(state->pins[i]);
+        bool gpio_state = (pressed_pins >> button_pins[i]) & 1;
+        if (gpio_state != state->states[i].pressed)
+            TRACE_EVENT(DEBOUNCE, i, gpio_state);
         state->states[i].pressed = gpio_state;
+        raw |= (uint32_t)gpio_state << i;
     }
+    state->raw = raw;
 }
 
-static void asym_eager_defer_pk(DebounceState *state)
+static void HAL_RAM_FUNC(asym_eager_defer_pk)(DebounceState *state)
 {
+    uint32_t pressed_pins = read_pressed_pins();
+    uint32_t raw = 0;
     for (int i = 0; i < BUTTON_COUNT; i++)
     {
-        bool gpio_state = !gpio_get(state->pins[i]);
+        bool gpio_state = (pressed_pins >> button_pins[i]) & 1;
+        raw |= (uint32_t)gpio_state << i;
 
         KeyState *key = &state->states[i];
-        uint64_t now = time_us_64();
+        uint64_t now = hal_time_us_64();
 
         if (gpio_state != key->pressed)
         {
@@ -32,6 +51,7 @@ static void asym_eager_defer_pk(DebounceState *state)
                 if (gpio_state)
                 {
                     key->pressed = true;
+                    TRACE_EVENT(DEBOUNCE, i, true);
                 }
             }
             else if ((now - key->timestamp) >= DEBOUNCE_TIME_US)
@@ -41,6 +61,7 @@ static void asym_eager_defer_pk(DebounceState *state)
                 if (!gpio_state)
                 {
                     key->pressed = false;
+                    TRACE_EVENT(DEBOUNCE, i, false);
                 }
             }
         }
@@ -49,12 +70,13 @@ static void asym_eager_defer_pk(DebounceState *state)
             key->active = false;
         }
     }
+    state->raw = raw;
 }
 
-void debounce_init(DebounceState *state, const uint8_t *pins)
+void debounce_init(DebounceState *state)
 {
-    state->pins = pins;
     state->mode = ASYM_EAGER_DEFER_PK;
+    state->raw = 0;
 
     for (int i = 0; i < BUTTON_COUNT; i++)
     {
@@ -63,13 +85,11 @@ void debounce_init(DebounceState *state, const uint8_t *pins)
             .active = false,
             .timestamp = 0};
 
-        gpio_init(pins[i]);
-        gpio_set_dir(pins[i], GPIO_IN);
-        gpio_pull_up(pins[i]);
+        hal_gpio_init_input_pullup(button_pins[i]);
     }
 }
 
-void debounce_update(DebounceState *state)
+void HAL_RAM_FUNC(debounce_update)(DebounceState *state)
 {
     switch (state->mode)
     {
@@ -83,7 +103,7 @@ void debounce_update(DebounceState *state)
     }
 }
 
-uint32_t debounce_get_states(DebounceState *state)
+uint32_t HAL_RAM_FUNC(debounce_get_states)(DebounceState *state)
 {
     uint32_t states = 0;
     for (int i = 0; i < BUTTON_COUNT; i++)
@@ -96,6 +116,11 @@ uint32_t debounce_get_states(DebounceState *state)
     return states;
 }
 
+uint32_t HAL_RAM_FUNC(debounce_get_raw)(const DebounceState *state)
+{
+    return state->raw;
+}
+
 void debounce_set_mode(DebounceState *state, DebounceMode mode)
 {
     state->mode = mode;
@@ -3,10 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "pico/time.h"
-#include "hardware/gpio.h"
-
-#define BUTTON_COUNT 7
+#include "modules/hal/hal.h"
+#include "phac_board.h"
 
 typedef enum
 {
@@ -23,14 +21,16 @@ typedef struct
 
 typedef struct
 {
-    const uint8_t *pins;
     KeyState states[BUTTON_COUNT];
     DebounceMode mode;
+    uint32_t raw; // Undebounced pin states of the last scan, pressed = 1
 } DebounceState;
 
-void debounce_init(DebounceState *state, const uint8_t *pins);
+// Button i is the GPIO at BOARD_BUTTON_PINS[i] (phac_board.h)
+void debounce_init(DebounceState *state);
 void debounce_update(DebounceState *state);
 uint32_t debounce_get_states(DebounceState *state);
+uint32_t debounce_get_raw(const DebounceState *state);
 void debounce_set_mode(DebounceState *state, DebounceMode mode);
 
 #endif
\ No newline at end of file
@@ -1,8 +1,5 @@
 #include "ec11.h"
-#include "hardware/pio.h"
-#include "hardware/clocks.h"
-#include "ec11.pio.h"
-#include "pico/time.h"
+#include "modules/trace/trace.h"
 #include <stdlib.h>
 #include <math.h>
 
@@ -21,7 +18,7 @@ typedef struct
 typedef struct
 {
     EC11_Encoder *encoder;
-    struct repeating_timer timer;
+    hal_timer_t timer;
 } EncoderTimerData;
 
 // 为每个编码器维护独立的状态
@@ -45,7 +42,7 @@ static bool queue_push(EncoderState *state, EC11_Direction dir)
 
     state->event_queue[state->queue_tail].dir = dir;
     state->event_queue[state->queue_tail].scheduled_time =
-        time_us_32() + (EVENT_INTERVAL_MS * 1000);
+        hal_time_us_32() + (EVENT_INTERVAL_MS * 1000);
     state->queue_tail = (state->queue_tail + 1) % QUEUE_SIZE;
     state->queue_count++;
     return true;
@@ -63,12 +60,12 @@ static bool queue_pop(EncoderState *state, EncoderEvent *event)
 }
 
 // 定时器回调函数 (接收EncoderState指针)
-static bool encoder_timer_callback(struct repeating_timer *t)
+static bool encoder_timer_callback(hal_timer_t *t)
 {
     EncoderTimerData *timer_data = (EncoderTimerData *)t->user_data;
     EncoderState *state = (EncoderState *)timer_data->encoder->state_ptr;
     EncoderEvent event;
-    uint32_t current_time = time_us_32();
+    uint32_t current_time = hal_time_us_32();
 
     if (state->queue_count > 0 &&
         state->event_queue[state->queue_head].scheduled_time <= current_time)
@@ -89,12 +86,14 @@ static bool encoder_timer_callback(struct repeating_timer *t)
 void ec11_init(EC11_Encoder *encoder, uint pin_a, uint pin_b,
                EC11_Callback callback, void *user_data)
 {
-    if (encoder_count >= MAX_ENCODERS)
-        return;
-
-    // 关联编码器与状态
-    encoder->state_ptr = &encoder_states[encoder_count];
-    encoder_count++;
+    // 关联编码器与状态; 重新初始化时沿用原来的状态槽
+    if (!encoder->state_ptr)
+    {
+        if (encoder_count >= MAX_ENCODERS)
+            return;
+        encoder->state_ptr = &encoder_states[encoder_count];
+        encoder_count++;
+    }
 
     EncoderState *state = (EncoderState *)encoder->state_ptr;
 
@@ -112,24 +111,33 @@ void ec11_init(EC11_Encoder *encoder, uint pin_a, uint pin_b,
     encoder->last_count = 0;
     encoder->last_direction = EC11_DIR_NONE;
 
-    encoder->pio = pio0;
-    encoder->sm = pio_claim_unused_sm(encoder->pio, true);
-    uint offset = pio_add_program(encoder->pio, &quadrature_encoder_program);
-    quadrature_encoder_program_init(encoder->pio, encoder->sm, pin_a, 3, true, 3);
+    hal_pio_quadrature_init(&encoder->pio_sm, pin_a);
 
     // 设置定时器
     state->timer_data.encoder = encoder;
-    add_repeating_timer_ms(-EVENT_INTERVAL_MS, encoder_timer_callback,
-                           &state->timer_data, &state->timer_data.timer);
+    hal_timer_start(NULL, -EVENT_INTERVAL_MS * 1000, encoder_timer_callback,
+                    &state->timer_data, &state->timer_data.timer);
 }
 
 // 更新EC11编码器状态
 void ec11_update(EC11_Encoder *encoder)
 {
-    EncoderState *state = (EncoderState *)encoder->state_ptr;
+    ec11_push_delta(encoder, ec11_read_delta(encoder));
+}
 
-    encoder->count = quadrature_encoder_get_count(encoder->pio, encoder->sm);
+int32_t HAL_RAM_FUNC(ec11_read_delta)(EC11_Encoder *encoder)
+{
+    encoder->count = hal_pio_quadrature_count(&encoder->pio_sm);
     int32_t delta = encoder->count - encoder->last_count;
+    encoder->last_count = encoder->count;
+    if (delta != 0)
+        TRACE_EVENT(ENCODER, encoder->pin_a, delta);
+    return delta;
+}
+
+void ec11_push_delta(EC11_Encoder *encoder, int32_t delta)
+{
+    EncoderState *state = (EncoderState *)encoder->state_ptr;
 
     if (delta != 0)
     {
@@ -150,8 +158,6 @@ void ec11_update(EC11_Encoder *encoder)
         {
             queue_push(state, current_dir);
         }
-
-        encoder->last_count = encoder->count;
     }
 }
 
@@ -2,8 +2,7 @@
 #ifndef EC11_H
 #define EC11_H
 
-#include "pico/stdlib.h"
-#include "hardware/pio.h"
+#include "modules/hal/hal.h"
 
 // 编码器旋转方向枚举
 typedef enum {
@@ -20,8 +19,7 @@ typedef struct EC11_Encoder
     // 原有字段
     uint pin_a;
     uint pin_b;
-    PIO pio;
-    uint sm;
+    hal_pio_sm_t pio_sm;
     EC11_Callback callback;
     void *user_data;
     int32_t count;
@@ -35,9 +33,17 @@ typedef struct EC11_Encoder
 // 初始化EC11编码器
 void ec11_init(EC11_Encoder *encoder, uint pin_a, uint pin_b, EC11_Callback callback, void *user_data);
 
-// 更新EC11编码器状态
+// 更新EC11编码器状态 (read + push on the same core)
 void ec11_update(EC11_Encoder *encoder);
 
+// Read the hardware count and return the change since the last read.
+// Used by the sampling core.
+int32_t ec11_read_delta(EC11_Encoder *encoder);
+
+// Turn a count change into smoothed callback events; used by the core that
+// owns the callbacks
+void ec11_push_delta(EC11_Encoder *encoder, int32_t delta);
+
 // 获取EC11编码器当前计数
 int32_t ec11_get_count(EC11_Encoder *encoder);
 
@@ -0,0 +1,189 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Thin hardware abstraction layer. Modules call these instead of the Pico SDK
+// so their logic also builds on a host against simulated backends (host/).
+//
+// Each backend provides hal_port.h, found on the include path, with the
+// platform types:
+//   uint              unsigned int
+//   hal_lock_t        spin lock
+//   hal_alarm_pool_t  per-core timer context
+//   hal_alarm_id_t    one-shot timer id
+//   hal_timer_t       repeating timer; callbacks read timer->user_data
+//   hal_pio_sm_t      PIO state machine handle
+//   hal_assert(x)     fatal assertion
+//   HAL_RAM_FUNC(f)   wraps a function name in its definition to run it from
+//                     SRAM instead of flash, so it takes no XIP cache misses;
+//                     a no-op where that means nothing. Only worth it when
+//                     everything it calls is inline or HAL_RAM_FUNC too.
+//                     Nothing runs during a flash write either way: core 1
+//                     is parked and core 0 has interrupts off.
+// HAL_INLINE marks calls a backend may define static inline in hal_inline.h
+// (set HAL_PORT_INLINE); the Pico backend does, so hot paths pay nothing for
+// the indirection.
+#include "hal_port.h"
+
+#ifndef HAL_INLINE
+#define HAL_INLINE
+#endif
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+HAL_INLINE uint64_t hal_time_us_64(void);
+HAL_INLINE uint32_t hal_time_us_32(void);
+
+// Sleep until target_us; any interrupt may end the wait early
+HAL_INLINE void hal_idle_until(uint64_t target_us);
+
+// Ordering for data handed between cores
+HAL_INLINE void hal_fence_release(void);
+HAL_INLINE void hal_fence_acquire(void);
+
+//--------------------------------------------------------------------+
+// Cores and interrupts
+//--------------------------------------------------------------------+
+HAL_INLINE uint hal_core_num(void);
+
+// Masks interrupts on this core only; returns the state to restore
+HAL_INLINE uint32_t hal_irq_save(void);
+HAL_INLINE void hal_irq_restore(uint32_t save);
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+void hal_gpio_init_input_pullup(uint pin);
+HAL_INLINE bool hal_gpio_get(uint pin);
+// Every GPIO level in one read, bit n for GPIO n
+HAL_INLINE uint32_t hal_gpio_get_all(void);
+
+//--------------------------------------------------------------------+
+// Spin locks
+//--------------------------------------------------------------------+
+hal_lock_t *hal_lock_claim(void);
+
+// Masks interrupts on this core; returns the state to restore
+HAL_INLINE uint32_t hal_lock_enter(hal_lock_t *lock);
+HAL_INLINE void hal_lock_exit(hal_lock_t *lock, uint32_t save);
+
+// For IRQ handlers and callbacks that already run with interrupts masked
+HAL_INLINE void hal_lock_enter_isr(hal_lock_t *lock);
+HAL_INLINE void hal_lock_exit_isr(hal_lock_t *lock);
+
+//--------------------------------------------------------------------+
+// Hardware alarms and timers
+//--------------------------------------------------------------------+
+
+// Dedicated one-shot alarm; fn runs in IRQ context
+typedef void (*hal_alarm_fn_t)(uint alarm);
+uint hal_alarm_claim(hal_alarm_fn_t fn);
+
+// Returns true if target_us has already passed, in which case nothing is armed
+HAL_INLINE bool hal_alarm_set(uint alarm, uint64_t target_us);
+HAL_INLINE void hal_alarm_cancel(uint alarm);
+// Fire the callback now (or as soon as interrupts are unmasked)
+HAL_INLINE void hal_alarm_force(uint alarm);
+
+// A pool takes one hardware alarm and runs its callbacks on the core that
+// created it. A NULL pool is the default pool on core 0.
+hal_alarm_pool_t *hal_alarm_pool_create(uint max_timers);
+
+// One-shot callback. Returning 0 ends it; >0 reschedules that many us after
+// the previous target, <0 that many us from now.
+typedef int64_t (*hal_timeout_fn_t)(hal_alarm_id_t id, void *ctx);
+// False if the pool has no free slot
+bool hal_timeout_add(hal_alarm_pool_t *pool, uint32_t delay_us, hal_timeout_fn_t fn, void *ctx);
+
+// Repeating callback; return false to stop. A negative period is a fixed
+// rate measured start to start, a positive one the gap after each callback.
+typedef bool (*hal_timer_fn_t)(hal_timer_t *timer);
+bool hal_timer_start(hal_alarm_pool_t *pool, int64_t period_us, hal_timer_fn_t fn, void *ctx, hal_timer_t *timer);
+
+//--------------------------------------------------------------------+
+// PIO
+//--------------------------------------------------------------------+
+
+// PIO programs are loaded by the backend
+bool hal_pio_ws2812_init(hal_pio_sm_t *sm, uint pin, uint freq);
+void hal_pio_ws2812_deinit(hal_pio_sm_t *sm);
+// ws2812_parallel program on pin_count consecutive pins from pin_base
+bool hal_pio_ws2812_parallel_init(hal_pio_sm_t *sm, uint pin_base, uint pin_count, uint freq);
+void hal_pio_ws2812_parallel_deinit(hal_pio_sm_t *sm);
+void hal_pio_quadrature_init(hal_pio_sm_t *sm, uint pin_a);
+
+// Latest quadrature count, drained from the RX FIFO
+int32_t hal_pio_quadrature_count(hal_pio_sm_t *sm);
+
+// Words waiting in the TX FIFO
+HAL_INLINE uint hal_pio_tx_level(const hal_pio_sm_t *sm);
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+
+// Channel that paces 32-bit words into a state machine's TX FIFO. done runs
+// in IRQ context after each transfer, on the core that claimed the channel.
+typedef void (*hal_dma_fn_t)(uint chan);
+uint hal_dma_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done);
+void hal_dma_stream_release(uint chan);
+HAL_INLINE void hal_dma_stream_start(uint chan, const uint32_t *words, uint count);
+
+// Same, 8 bits per transfer; the byte lands replicated across the FIFO word.
+// Release with hal_dma_stream_release().
+uint hal_dma_byte_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done);
+HAL_INLINE void hal_dma_byte_stream_start(uint chan, const uint8_t *bytes, uint count);
+
+// Channel that paces bytes into the TX FIFO of the UART on tx_pin, set up
+// for baud, 8N1. done runs in IRQ context after each transfer, on the
+// claiming core.
+uint hal_dma_uart_claim(uint tx_pin, uint baud, hal_dma_fn_t done);
+HAL_INLINE void hal_dma_uart_start(uint chan, const uint8_t *bytes, uint count);
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+#define HAL_FLASH_SECTOR_SIZE 4096u
+
+// Memory-mapped view of flash at offset
+HAL_INLINE const void *hal_flash_read(uint32_t offset);
+
+// Erase one sector and program len bytes (at most a sector) at its start;
+// the rest reads back erased (0xFF). The other core is parked and interrupts
+// are masked while flash is unavailable for execution.
+void hal_flash_write_sector(uint32_t offset, const void *data, uint32_t len);
+
+//--------------------------------------------------------------------+
+// stdio
+//--------------------------------------------------------------------+
+
+// Hand printf() output to out instead of the default (blocking) drivers
+typedef void (*hal_stdio_fn_t)(const char *buf, int len);
+void hal_stdio_redirect(hal_stdio_fn_t out);
+
+//--------------------------------------------------------------------+
+// USB HID
+//--------------------------------------------------------------------+
+
+// All reports use report ID 0; each returns false if it was not queued
+bool hal_hid_ready(uint8_t itf);
+bool hal_hid_report(uint8_t itf, const void *report, uint16_t len);
+// keycodes is NULL or 6 entries
+bool hal_hid_keyboard_report(uint8_t itf, uint8_t modifiers, const uint8_t *keycodes);
+bool hal_hid_mouse_report(uint8_t itf, uint8_t buttons, int8_t x, int8_t y, int8_t wheel, int8_t pan);
+bool hal_hid_gamepad_report(uint8_t itf, int8_t x, int8_t y, int8_t z, int8_t rz, int8_t rx, int8_t ry,
+                            uint8_t hat, uint32_t buttons);
+
+// Bus suspended by the host; the wakeup request is dropped unless the host
+// enabled remote wakeup
+bool hal_usb_suspended(void);
+void hal_usb_remote_wakeup(void);
+
+#ifdef HAL_PORT_INLINE
+#include "hal_inline.h"
+#endif
+
+#endif
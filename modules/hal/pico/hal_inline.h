@@ -0,0 +1,136 @@
+#ifndef HAL_INLINE_H
+#define HAL_INLINE_H
+
+// Included at the end of hal.h; see hal.h for the contract
+
+#include "hardware/timer.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/regs/addressmap.h"
+
+// time_us_64() is an out-of-line SDK call that runs from flash. This is the
+// same read of the raw registers, inline so SRAM code stays off XIP.
+static inline uint64_t hal_time_us_64(void)
+{
+    uint32_t hi = timer_hw->timerawh;
+    uint32_t lo;
+    for (;;)
+    {
+        lo = timer_hw->timerawl;
+        uint32_t next_hi = timer_hw->timerawh;
+        if (hi == next_hi)
+            break;
+        hi = next_hi;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint32_t hal_time_us_32(void)
+{
+    return time_us_32();
+}
+
+static inline void hal_idle_until(uint64_t target_us)
+{
+    best_effort_wfe_or_timeout(from_us_since_boot(target_us));
+}
+
+static inline void hal_fence_release(void)
+{
+    __mem_fence_release();
+}
+
+static inline void hal_fence_acquire(void)
+{
+    __mem_fence_acquire();
+}
+
+static inline uint hal_core_num(void)
+{
+    return get_core_num();
+}
+
+static inline uint32_t hal_irq_save(void)
+{
+    return save_and_disable_interrupts();
+}
+
+static inline void hal_irq_restore(uint32_t save)
+{
+    restore_interrupts(save);
+}
+
+static inline bool hal_gpio_get(uint pin)
+{
+    return gpio_get(pin);
+}
+
+static inline uint32_t hal_gpio_get_all(void)
+{
+    return gpio_get_all();
+}
+
+static inline uint32_t hal_lock_enter(hal_lock_t *lock)
+{
+    return spin_lock_blocking(lock);
+}
+
+static inline void hal_lock_exit(hal_lock_t *lock, uint32_t save)
+{
+    spin_unlock(lock, save);
+}
+
+static inline void hal_lock_enter_isr(hal_lock_t *lock)
+{
+    spin_lock_unsafe_blocking(lock);
+}
+
+static inline void hal_lock_exit_isr(hal_lock_t *lock)
+{
+    spin_unlock_unsafe(lock);
+}
+
+static inline bool hal_alarm_set(uint alarm, uint64_t target_us)
+{
+    return hardware_alarm_set_target(alarm, from_us_since_boot(target_us));
+}
+
+static inline void hal_alarm_cancel(uint alarm)
+{
+    hardware_alarm_cancel(alarm);
+}
+
+static inline void hal_alarm_force(uint alarm)
+{
+    hardware_alarm_force_irq(alarm);
+}
+
+static inline uint hal_pio_tx_level(const hal_pio_sm_t *sm)
+{
+    return pio_sm_get_tx_fifo_level(sm->pio, sm->sm);
+}
+
+static inline void hal_dma_stream_start(uint chan, const uint32_t *words, uint count)
+{
+    dma_channel_set_trans_count(chan, count, false);
+    dma_channel_set_read_addr(chan, words, true);
+}
+
+static inline void hal_dma_byte_stream_start(uint chan, const uint8_t *bytes, uint count)
+{
+    dma_channel_set_trans_count(chan, count, false);
+    dma_channel_set_read_addr(chan, bytes, true);
+}
+
+static inline void hal_dma_uart_start(uint chan, const uint8_t *bytes, uint count)
+{
+    dma_channel_set_trans_count(chan, count, false);
+    dma_channel_set_read_addr(chan, bytes, true);
+}
+
+static inline const void *hal_flash_read(uint32_t offset)
+{
+    return (const void *)(uintptr_t)(XIP_BASE + offset);
+}
+
+#endif
@@ -0,0 +1,327 @@
+#include "modules/hal/hal.h"
+#include <string.h>
+#include "modules/trace/trace.h"
+#include "hardware/flash.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+#include "pico/multicore.h"
+#include "pico/stdio.h"
+#include "pico/stdio/driver.h"
+#if LIB_PICO_STDIO_UART
+#include "pico/stdio_uart.h"
+#endif
+#include "tusb.h"
+#include "ws2812.pio.h"
+#include "ec11.pio.h"
+
+#define HAL_DMA_STREAMS 4
+
+typedef struct
+{
+    uint chan;
+    uint irq_index; // DMA_IRQ_0 or DMA_IRQ_1, by claiming core
+    hal_dma_fn_t done;
+} DmaStream;
+
+static DmaStream dma_streams[HAL_DMA_STREAMS];
+static uint dma_stream_count;
+static uint dma_irq_lines; // Bit n: handler installed on DMA_IRQ_n
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+void hal_gpio_init_input_pullup(uint pin)
+{
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_pull_up(pin);
+}
+
+//--------------------------------------------------------------------+
+// Spin locks, alarms and timers
+//--------------------------------------------------------------------+
+hal_lock_t *hal_lock_claim(void)
+{
+    return spin_lock_instance(spin_lock_claim_unused(true));
+}
+
+uint hal_alarm_claim(hal_alarm_fn_t fn)
+{
+    uint alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, fn);
+    return alarm;
+}
+
+hal_alarm_pool_t *hal_alarm_pool_create(uint max_timers)
+{
+    return alarm_pool_create_with_unused_hardware_alarm(max_timers);
+}
+
+bool hal_timeout_add(hal_alarm_pool_t *pool, uint32_t delay_us, hal_timeout_fn_t fn, void *ctx)
+{
+    if (!pool)
+        pool = alarm_pool_get_default();
+    return alarm_pool_add_alarm_in_us(pool, delay_us, fn, ctx, true) >= 0;
+}
+
+bool hal_timer_start(hal_alarm_pool_t *pool, int64_t period_us, hal_timer_fn_t fn, void *ctx, hal_timer_t *timer)
+{
+    if (!pool)
+        pool = alarm_pool_get_default();
+    return alarm_pool_add_repeating_timer_us(pool, period_us, fn, ctx, timer);
+}
+
+//--------------------------------------------------------------------+
+// PIO
+//--------------------------------------------------------------------+
+bool hal_pio_ws2812_init(hal_pio_sm_t *sm, uint pin, uint freq)
+{
+    if (!pio_claim_free_sm_and_add_program_for_gpio_range(&ws2812_program, &sm->pio, &sm->sm, &sm->offset, pin, 1, true))
+        return false;
+
+    ws2812_program_init(sm->pio, sm->sm, sm->offset, pin, freq, false);
+    return true;
+}
+
+void hal_pio_ws2812_deinit(hal_pio_sm_t *sm)
+{
+    pio_remove_program_and_unclaim_sm(&ws2812_program, sm->pio, sm->sm, sm->offset);
+}
+
+bool hal_pio_ws2812_parallel_init(hal_pio_sm_t *sm, uint pin_base, uint pin_count, uint freq)
+{
+    if (!pio_claim_free_sm_and_add_program_for_gpio_range(&ws2812_parallel_program, &sm->pio, &sm->sm, &sm->offset,
+                                                          pin_base, pin_count, true))
+        return false;
+
+    ws2812_parallel_program_init(sm->pio, sm->sm, sm->offset, pin_base, pin_count, freq);
+    return true;
+}
+
+void hal_pio_ws2812_parallel_deinit(hal_pio_sm_t *sm)
+{
+    pio_remove_program_and_unclaim_sm(&ws2812_parallel_program, sm->pio, sm->sm, sm->offset);
+}
+
+void hal_pio_quadrature_init(hal_pio_sm_t *sm, uint pin_a)
+{
+    sm->pio = pio0;
+    sm->sm = pio_claim_unused_sm(sm->pio, true);
+    sm->offset = pio_add_program(sm->pio, &quadrature_encoder_program);
+    quadrature_encoder_mechanical_init(sm->pio, sm->sm, pin_a);
+}
+
+int32_t HAL_RAM_FUNC(hal_pio_quadrature_count)(hal_pio_sm_t *sm)
+{
+    return quadrature_encoder_get_count(sm->pio, sm->sm);
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+
+// Each core takes its own DMA line, so a stream's completion runs on the
+// core that claimed it: core 0 on DMA_IRQ_0, core 1 on DMA_IRQ_1. Both
+// are shared handlers, so SDK code can still hook the same lines.
+static void HAL_RAM_FUNC(dma_irq_dispatch)(uint irq_index)
+{
+    for (uint i = 0; i < dma_stream_count; i++)
+    {
+        uint chan = dma_streams[i].chan;
+        if (dma_streams[i].irq_index == irq_index && dma_irqn_get_channel_status(irq_index, chan))
+        {
+            dma_irqn_acknowledge_channel(irq_index, chan);
+            dma_streams[i].done(chan);
+        }
+    }
+}
+
+static void __isr HAL_RAM_FUNC(hal_dma_irq0_handler)(void)
+{
+    dma_irq_dispatch(0);
+}
+
+static void __isr HAL_RAM_FUNC(hal_dma_irq1_handler)(void)
+{
+    dma_irq_dispatch(1);
+}
+
+// Routes the channel's completion IRQ to done, on the calling core
+static void dma_stream_add(uint chan, hal_dma_fn_t done)
+{
+    uint irq_index = get_core_num();
+
+    uint32_t save = save_and_disable_interrupts();
+    dma_streams[dma_stream_count].chan = chan;
+    dma_streams[dma_stream_count].irq_index = irq_index;
+    dma_streams[dma_stream_count].done = done;
+    dma_stream_count++;
+    restore_interrupts(save);
+
+    dma_irqn_set_channel_enabled(irq_index, chan, true);
+    if (!(dma_irq_lines & (1u << irq_index)))
+    {
+        dma_irq_lines |= 1u << irq_index;
+        irq_add_shared_handler(DMA_IRQ_NUM(irq_index), irq_index ? hal_dma_irq1_handler : hal_dma_irq0_handler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_NUM(irq_index), true);
+    }
+}
+
+static uint dma_pio_claim(const hal_pio_sm_t *sm, enum dma_channel_transfer_size size, hal_dma_fn_t done)
+{
+    hard_assert(dma_stream_count < HAL_DMA_STREAMS);
+
+    uint chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_dreq(&c, pio_get_dreq(sm->pio, sm->sm, true));
+    dma_channel_configure(chan, &c, &sm->pio->txf[sm->sm], NULL, 0, false);
+
+    dma_stream_add(chan, done);
+    return chan;
+}
+
+uint hal_dma_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done)
+{
+    return dma_pio_claim(sm, DMA_SIZE_32, done);
+}
+
+uint hal_dma_byte_stream_claim(const hal_pio_sm_t *sm, hal_dma_fn_t done)
+{
+    return dma_pio_claim(sm, DMA_SIZE_8, done);
+}
+
+uint hal_dma_uart_claim(uint tx_pin, uint baud, hal_dma_fn_t done)
+{
+    hard_assert(dma_stream_count < HAL_DMA_STREAMS);
+
+    // UART TX sits on every fourth pin, alternating uart0, uart1, uart1, uart0
+    hard_assert(tx_pin % 4 == 0);
+    uart_inst_t *uart = uart_get_instance(((tx_pin + 4) & 8) >> 3);
+    uart_init(uart, baud);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+
+    uint chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+    dma_channel_configure(chan, &c, &uart_get_hw(uart)->dr, NULL, 0, false);
+
+    dma_stream_add(chan, done);
+    return chan;
+}
+
+void hal_dma_stream_release(uint chan)
+{
+    uint32_t save = save_and_disable_interrupts();
+    for (uint i = 0; i < dma_stream_count; i++)
+    {
+        if (dma_streams[i].chan == chan)
+        {
+            dma_irqn_set_channel_enabled(dma_streams[i].irq_index, chan, false);
+            dma_streams[i] = dma_streams[--dma_stream_count];
+            break;
+        }
+    }
+    restore_interrupts(save);
+    dma_channel_abort(chan);
+
+    dma_channel_unclaim(chan);
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+void hal_flash_write_sector(uint32_t offset, const void *data, uint32_t len)
+{
+    // Whole pages go straight from data; the last partial page is padded
+    // here, so callers need no sector-sized buffer
+    static uint8_t tail[FLASH_PAGE_SIZE];
+    hard_assert(len <= HAL_FLASH_SECTOR_SIZE);
+    uint32_t whole = len & ~(FLASH_PAGE_SIZE - 1);
+    uint32_t rest = len - whole;
+    memset(tail, 0xFF, sizeof(tail));
+    memcpy(tail, (const uint8_t *)data + whole, rest);
+
+    // Core 1 runs from flash; park it while XIP is unavailable
+    bool lockout = multicore_lockout_victim_is_initialized(1);
+    if (lockout)
+        multicore_lockout_start_blocking();
+
+    // Traced around both steps: nothing may touch flash in between
+    TRACE_EVENT(FLASH_WRITE_BEGIN, 0, offset);
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(offset, HAL_FLASH_SECTOR_SIZE);
+    if (whole)
+        flash_range_program(offset, data, whole);
+    if (rest)
+        flash_range_program(offset + whole, tail, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+    TRACE_EVENT(FLASH_WRITE_END, 0, 0);
+
+    if (lockout)
+        multicore_lockout_end_blocking();
+}
+
+//--------------------------------------------------------------------+
+// stdio
+//--------------------------------------------------------------------+
+static hal_stdio_fn_t stdio_out;
+
+static void stdio_out_chars(const char *buf, int len)
+{
+    stdio_out(buf, len);
+}
+
+static stdio_driver_t stdio_redirect = {
+    .out_chars = stdio_out_chars,
+};
+
+void hal_stdio_redirect(hal_stdio_fn_t out)
+{
+    stdio_out = out;
+    stdio_set_driver_enabled(&stdio_redirect, true);
+#if LIB_PICO_STDIO_UART
+    stdio_set_driver_enabled(&stdio_uart, false);
+#endif
+}
+
+//--------------------------------------------------------------------+
+// USB HID
+//--------------------------------------------------------------------+
+bool hal_hid_ready(uint8_t itf)
+{
+    return tud_hid_n_ready(itf);
+}
+
+bool hal_hid_report(uint8_t itf, const void *report, uint16_t len)
+{
+    return tud_hid_n_report(itf, 0, report, len);
+}
+
+bool hal_hid_keyboard_report(uint8_t itf, uint8_t modifiers, const uint8_t *keycodes)
+{
+    return tud_hid_n_keyboard_report(itf, 0, modifiers, keycodes);
+}
+
+bool hal_hid_mouse_report(uint8_t itf, uint8_t buttons, int8_t x, int8_t y, int8_t wheel, int8_t pan)
+{
+    return tud_hid_n_mouse_report(itf, 0, buttons, x, y, wheel, pan);
+}
+
+bool hal_hid_gamepad_report(uint8_t itf, int8_t x, int8_t y, int8_t z, int8_t rz, int8_t rx, int8_t ry,
+                            uint8_t hat, uint32_t buttons)
+{
+    return tud_hid_n_gamepad_report(itf, 0, x, y, z, rz, rx, ry, hat, buttons);
+}
+
+bool hal_usb_suspended(void)
+{
+    return tud_suspended();
+}
+
+void hal_usb_remote_wakeup(void)
+{
+    tud_remote_wakeup();
+}
@@ -0,0 +1,33 @@
+#ifndef HAL_PORT_H
+#define HAL_PORT_H
+
+// RP2040 backend: platform types are the SDK's own, and the hot calls are
+// inline wrappers in hal_inline.h
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "hardware/pio.h"
+
+typedef spin_lock_t hal_lock_t;
+typedef alarm_pool_t hal_alarm_pool_t;
+typedef alarm_id_t hal_alarm_id_t;
+typedef struct repeating_timer hal_timer_t;
+
+typedef struct
+{
+    PIO pio;
+    uint sm;
+    uint offset;
+} hal_pio_sm_t;
+
+#define hal_assert(x) hard_assert(x)
+
+// The SDK linker scripts copy .time_critical.* into SRAM at boot; the phac
+// prefix lets the placement report (tools/map_report.py) list ours
+#define HAL_RAM_FUNC(name) __attribute__((section(".time_critical.phac." #name))) name
+
+#define HAL_INLINE static inline
+#define HAL_PORT_INLINE 1
+
+#endif
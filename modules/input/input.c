@@ -0,0 +1,87 @@
+#include "input.h"
+#include "input_trace.h"
+#include "modules/spsc/spsc.h"
+#include "modules/profile/profile.h"
+
+static SpscRing event_ring;
+static InputEvent event_storage[INPUT_QUEUE_SIZE];
+
+static DebounceState *debounce;
+static EC11_Encoder *encoders[2];
+
+static hal_alarm_pool_t *sample_pool;
+static hal_timer_t sample_timer;
+
+// Sampler state, core 1 only. Encoder counts accumulate until an event
+// carrying them has been queued.
+static uint32_t published_btn_state;
+static int32_t pending_x;
+static int32_t pending_y;
+
+static inline int16_t clamp16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+static bool HAL_RAM_FUNC(sample_callback)(hal_timer_t *t)
+{
+    (void)t;
+
+    PROFILE_BEGIN(DEBOUNCE);
+    debounce_update(debounce);
+    PROFILE_END(DEBOUNCE);
+
+    PROFILE_BEGIN(ENCODER);
+    int32_t delta_x = ec11_read_delta(encoders[0]);
+    int32_t delta_y = ec11_read_delta(encoders[1]);
+    PROFILE_END(ENCODER);
+    pending_x += delta_x;
+    pending_y += delta_y;
+
+    input_trace_sample(debounce_get_raw(debounce), delta_x, delta_y);
+
+    uint32_t btn_state = debounce_get_states(debounce);
+    if (btn_state == published_btn_state && pending_x == 0 && pending_y == 0)
+        return true;
+
+    InputEvent event = {
+        .timestamp_us = hal_time_us_64(),
+        .btn_state = btn_state,
+        .delta_x = clamp16(pending_x),
+        .delta_y = clamp16(pending_y)};
+
+    // On a full ring everything is retried with the next sample
+    if (spsc_push(&event_ring, &event))
+    {
+        published_btn_state = btn_state;
+        pending_x -= event.delta_x;
+        pending_y -= event.delta_y;
+    }
+    return true;
+}
+
+void input_init(DebounceState *state, EC11_Encoder *encoder_x, EC11_Encoder *encoder_y)
+{
+    debounce = state;
+    encoders[0] = encoder_x;
+    encoders[1] = encoder_y;
+    spsc_init(&event_ring, event_storage, sizeof(InputEvent), INPUT_QUEUE_SIZE);
+}
+
+void input_start(void)
+{
+    sample_pool = hal_alarm_pool_create(2);
+
+    // Negative period: fixed rate, measured start to start
+    hal_timer_start(sample_pool, -INPUT_SAMPLE_PERIOD_US, sample_callback, NULL, &sample_timer);
+}
+
+bool input_poll(InputEvent *event)
+{
+    return spsc_pop(&event_ring, event);
+}
+
+uint32_t input_get_dropped(void)
+{
+    return event_ring.dropped;
+}
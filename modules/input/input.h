@@ -0,0 +1,42 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/debounce/debounce.h"
+#include "modules/encoder/ec11.h"
+
+// Input sampling on core 1. A repeating timer on a core 1 alarm pool
+// debounces the buttons and reads both encoders every INPUT_SAMPLE_PERIOD_US.
+// It runs in IRQ context, so neither LED rendering nor USB work can delay a
+// sample. Each change is published as a timestamped event through a
+// lock-free SPSC ring, which core 0 drains in hid_task().
+
+#ifndef INPUT_SAMPLE_PERIOD_US
+#define INPUT_SAMPLE_PERIOD_US 100 // 10kHz
+#endif
+
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE 64 // Power of two
+#endif
+
+typedef struct
+{
+    uint64_t timestamp_us;
+    uint32_t btn_state; // Debounced state after this sample
+    int16_t delta_x;    // Encoder counts since the previous event
+    int16_t delta_y;
+} InputEvent;
+
+// Core 0, before core 1 starts
+void input_init(DebounceState *debounce, EC11_Encoder *encoder_x, EC11_Encoder *encoder_y);
+
+// Core 1: starts the sampling timer on this core
+void input_start(void);
+
+// Core 0: next event, false when the ring is empty
+bool input_poll(InputEvent *event);
+
+uint32_t input_get_dropped(void);
+
+#endif
@@ -0,0 +1,134 @@
+#include "input_trace.h"
+
+#if INPUT_TRACE_ENABLE
+
+#include <string.h>
+#include "modules/hal/hal.h"
+#include "modules/be/be.h"
+
+static InputTraceRecord records[INPUT_TRACE_RECORDS];
+
+// Written by core 1 only; core 0 asks for changes through the flags
+static volatile uint32_t record_count;
+static volatile uint32_t truncated;
+static volatile uint8_t state = INPUT_TRACE_IDLE;
+static volatile bool start_request;
+static volatile bool stop_request;
+
+// Recorder state, core 1 only. Encoder counts that do not fit in a record
+// carry over into the next one.
+static uint32_t start_us;
+static uint32_t last_buttons;
+static int32_t pending_x;
+static int32_t pending_y;
+
+static inline int8_t clamp8(int32_t v)
+{
+    return v > INT8_MAX ? INT8_MAX : (v < INT8_MIN ? INT8_MIN : (int8_t)v);
+}
+
+static void append(uint32_t now, uint32_t buttons)
+{
+    if (record_count >= INPUT_TRACE_RECORDS)
+    {
+        state = INPUT_TRACE_FULL;
+        truncated++;
+        return;
+    }
+
+    InputTraceRecord *record = &records[record_count];
+    record->timestamp_us = now - start_us;
+    record->buttons = (uint16_t)buttons;
+    record->delta_x = clamp8(pending_x);
+    record->delta_y = clamp8(pending_y);
+    pending_x -= record->delta_x;
+    pending_y -= record->delta_y;
+    last_buttons = buttons;
+
+    // The record must be visible before core 0 can see it counted
+    hal_fence_release();
+    record_count++;
+}
+
+void input_trace_sample(uint32_t buttons, int32_t delta_x, int32_t delta_y)
+{
+    if (stop_request)
+    {
+        stop_request = false;
+        if (state == INPUT_TRACE_RECORDING)
+            state = INPUT_TRACE_IDLE;
+    }
+
+    uint32_t now = hal_time_us_32();
+    if (start_request)
+    {
+        start_request = false;
+        record_count = 0;
+        truncated = 0;
+        start_us = now;
+        pending_x = 0;
+        pending_y = 0;
+        state = INPUT_TRACE_RECORDING;
+        append(now, buttons);
+        return;
+    }
+
+    if (state == INPUT_TRACE_IDLE)
+        return;
+
+    pending_x += delta_x;
+    pending_y += delta_y;
+    if (buttons != last_buttons || pending_x || pending_y)
+        append(now, buttons);
+}
+
+size_t input_trace_write_report(const uint8_t *request, size_t len, uint8_t *buffer, size_t max_len)
+{
+    const size_t status_len = 2 + 1 + 2 + 2 + 4;
+    if (len < 2 || max_len < status_len)
+        return 0;
+
+    uint8_t *p = buffer;
+    *p++ = INPUT_TRACE_COMMAND;
+    *p++ = request[1];
+
+    switch (request[1])
+    {
+    case 0x01:
+        start_request = true;
+        break;
+    case 0x02:
+        stop_request = true;
+        break;
+    case 0x03:
+    {
+        if (len < 4)
+            return 0;
+        uint32_t count = record_count;
+        hal_fence_acquire();
+
+        uint16_t index = (uint16_t)((request[2] << 8) | request[3]);
+        size_t room = (max_len - 5) / INPUT_TRACE_RECORD_SIZE;
+        size_t n = index < count ? count - index : 0;
+        if (n > room)
+            n = room;
+
+        p = put_be16(p, index);
+        *p++ = (uint8_t)n;
+        for (size_t i = 0; i < n; i++, p += INPUT_TRACE_RECORD_SIZE)
+            input_trace_encode(&records[index + i], p);
+        return (size_t)(p - buffer);
+    }
+    default:
+        break;
+    }
+
+    // Start and stop take effect on the next sample; report the request
+    *p++ = start_request ? INPUT_TRACE_RECORDING : (stop_request ? INPUT_TRACE_IDLE : state);
+    p = put_be16(p, start_request ? 0 : (uint16_t)record_count);
+    p = put_be16(p, INPUT_TRACE_RECORDS);
+    p = put_be32(p, start_request ? 0 : truncated);
+    return (size_t)(p - buffer);
+}
+
+#endif
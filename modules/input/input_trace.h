@@ -0,0 +1,84 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Raw input recorder. While armed, the core 1 sampler appends a record to a
+// RAM ring whenever the undebounced button pins or the encoder counts
+// change, so real bounce and spin patterns can be read out over raw HID
+// (0x86) and replayed on the host (host/phac_replay.c). Recording stops
+// when the buffer is full. With INPUT_TRACE_ENABLE 0 the sampler hook
+// compiles to nothing.
+//
+// Raw HID 0x86, sub-command:
+//   0x00 status   -> [0x86, 0x00, state, count (BE16), capacity (BE16), truncated (BE32)]
+//   0x01 start    -> status; clears the buffer and records the current state first
+//   0x02 stop     -> status
+//   0x03 read i   -> [0x86, 0x03, i (BE16), n, n records]; i is BE16 in the request
+
+#ifndef INPUT_TRACE_ENABLE
+#define INPUT_TRACE_ENABLE 0
+#endif
+
+#ifndef INPUT_TRACE_RECORDS
+#define INPUT_TRACE_RECORDS 2048 // 16KB
+#endif
+
+#define INPUT_TRACE_COMMAND 0x86
+#define INPUT_TRACE_RECORD_SIZE 8
+
+typedef enum
+{
+    INPUT_TRACE_IDLE,
+    INPUT_TRACE_RECORDING,
+    INPUT_TRACE_FULL
+} InputTraceState;
+
+typedef struct
+{
+    uint32_t timestamp_us; // Since recording started
+    uint16_t buttons;      // Raw pin levels, pressed = 1, in debounce order
+    int8_t delta_x;        // Encoder counts since the previous record
+    int8_t delta_y;
+} InputTraceRecord;
+
+// Wire format of one record: timestamp (BE32), buttons (BE16), dx, dy.
+// Shared with the host tools.
+static inline void input_trace_encode(const InputTraceRecord *record, uint8_t *p)
+{
+    p[0] = record->timestamp_us >> 24;
+    p[1] = record->timestamp_us >> 16;
+    p[2] = record->timestamp_us >> 8;
+    p[3] = record->timestamp_us;
+    p[4] = record->buttons >> 8;
+    p[5] = record->buttons;
+    p[6] = (uint8_t)record->delta_x;
+    p[7] = (uint8_t)record->delta_y;
+}
+
+static inline void input_trace_decode(const uint8_t *p, InputTraceRecord *record)
+{
+    record->timestamp_us = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    record->buttons = (uint16_t)((p[4] << 8) | p[5]);
+    record->delta_x = (int8_t)p[6];
+    record->delta_y = (int8_t)p[7];
+}
+
+#if INPUT_TRACE_ENABLE
+
+// Core 1 sampler, once per sample, with the raw button bits and the encoder
+// counts read by this sample
+void input_trace_sample(uint32_t buttons, int32_t delta_x, int32_t delta_y);
+
+// Core 0: handles a 0x86 raw HID request; returns reply bytes written
+size_t input_trace_write_report(const uint8_t *request, size_t len, uint8_t *buffer, size_t max_len);
+
+#else
+
+#define input_trace_sample(buttons, delta_x, delta_y) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include "log.h"
+
+#if LOG_ENABLE
+
+#include <string.h>
+#include "modules/hal/hal.h"
+#include "modules/be/be.h"
+
+static uint8_t buffer[LOG_BUFFER_SIZE];
+
+// Under lock. Byte indices run freely; records never straddle the end of
+// the buffer because its size is a multiple of the record size.
+static uint32_t head;
+static uint32_t tail;
+static uint32_t in_flight; // Bytes the running DMA transfer covers
+static uint16_t seq;
+static uint32_t dropped;
+
+static hal_lock_t *lock;
+static uint dma_chan;
+static volatile bool ready;
+
+_Static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0 && LOG_BUFFER_SIZE % LOG_RECORD_SIZE == 0,
+               "LOG_BUFFER_SIZE must be a power of two");
+
+// Caller holds lock. Sends the longest contiguous run of pending bytes.
+static void HAL_RAM_FUNC(kick)(void)
+{
+    uint32_t pending = head - tail;
+    if (in_flight || !pending)
+        return;
+
+    uint32_t offset = tail & (LOG_BUFFER_SIZE - 1);
+    uint32_t run = LOG_BUFFER_SIZE - offset;
+    in_flight = pending < run ? pending : run;
+    hal_dma_uart_start(dma_chan, buffer + offset, in_flight);
+}
+
+static void HAL_RAM_FUNC(dma_complete_handler)(uint chan)
+{
+    (void)chan;
+
+    hal_lock_enter_isr(lock);
+    tail += in_flight;
+    in_flight = 0;
+    kick();
+    hal_lock_exit_isr(lock);
+}
+
+// payload is the 8 bytes after the header
+static void HAL_RAM_FUNC(push)(LogMessage id, const uint8_t *payload)
+{
+    if (!ready)
+        return;
+
+    uint32_t save = hal_lock_enter(lock);
+    uint16_t n = seq++;
+    if (head - tail > LOG_BUFFER_SIZE - LOG_RECORD_SIZE)
+    {
+        dropped++;
+    }
+    else
+    {
+        uint8_t *p = buffer + (head & (LOG_BUFFER_SIZE - 1));
+        *p++ = LOG_SYNC;
+        *p++ = id;
+        *p++ = n >> 8;
+        *p++ = n;
+        p = put_be32(p, hal_time_us_32());
+        memcpy(p, payload, 8);
+        head += LOG_RECORD_SIZE;
+        kick();
+    }
+    hal_lock_exit(lock, save);
+}
+
+void log_write(LogMessage id, uint32_t arg0, uint32_t arg1)
+{
+    uint8_t payload[8];
+    put_be32(put_be32(payload, arg0), arg1);
+    push(id, payload);
+}
+
+void log_text(const char *text, int len)
+{
+    for (int i = 0; i < len; i += 8)
+    {
+        uint8_t payload[8] = {0};
+        memcpy(payload, text + i, len - i < 8 ? len - i : 8);
+        push(LOG_TEXT, payload);
+    }
+}
+
+uint32_t log_get_dropped(void)
+{
+    return dropped;
+}
+
+void log_init(void)
+{
+    lock = hal_lock_claim();
+    dma_chan = hal_dma_uart_claim(LOG_UART_TX_PIN, LOG_UART_BAUD, dma_complete_handler);
+    hal_stdio_redirect(log_text);
+    ready = true;
+}
+
+#endif
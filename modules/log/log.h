@@ -0,0 +1,65 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "log_ids.h"
+
+// Deferred UART log. LOG() writes a 16-byte binary record (message id and
+// two arguments, no formatting) into a RAM ring, and a DMA channel feeds the
+// ring to the UART in the background, so call sites never wait on the wire.
+// Works from any core and from IRQ context; a full ring drops the record,
+// which shows up as a gap in the sequence numbers. printf() output is
+// redirected into the same stream as TEXT records. host/phac_log.c expands a
+// capture back into text.
+//
+// Record: 0xA5, id, sequence (BE16), timestamp us (BE32), arg0 (BE32),
+// arg1 (BE32). A TEXT record carries up to 8 characters in place of the
+// arguments, NUL padded.
+//
+// The stdio UART pins (GP0/GP1) are the FX-R and Start buttons, so the log
+// has its own TX pin.
+
+#ifndef LOG_ENABLE
+#define LOG_ENABLE 0
+#endif
+
+// Any UART TX pin (a multiple of 4)
+#ifndef LOG_UART_TX_PIN
+#define LOG_UART_TX_PIN 12
+#endif
+
+#ifndef LOG_UART_BAUD
+#define LOG_UART_BAUD 115200
+#endif
+
+// Power of two
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 2048 // 128 records
+#endif
+
+#define LOG_SYNC 0xA5
+#define LOG_RECORD_SIZE 16
+
+#if LOG_ENABLE
+
+// Claims the UART and a DMA channel and takes over stdio; records logged
+// before this are dropped
+void log_init(void);
+
+// Any core, thread or IRQ context
+void log_write(LogMessage id, uint32_t arg0, uint32_t arg1);
+void log_text(const char *text, int len);
+
+uint32_t log_get_dropped(void);
+
+#define LOG(id, arg0, arg1) log_write(LOG_##id, (uint32_t)(arg0), (uint32_t)(arg1))
+
+#else
+
+#define log_init() ((void)0)
+#define LOG(id, arg0, arg1) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef LOG_IDS_H
+#define LOG_IDS_H
+
+// Log messages: X(id, format). A format takes up to two 32-bit arguments
+// (%u, %d, %x) and is only expanded on the host (host/phac_log.c), so the
+// firmware never formats text. TEXT carries printf() output instead.
+// Shared with the host tools, so new messages go at the end to keep the
+// numbering stable.
+#define LOG_MESSAGES(X)                                              \
+    X(TEXT, NULL)                                                    \
+    X(BOOT, "boot: mode %u")                                         \
+    X(MODE_SAVED, "mode %u saved to flash")                          \
+    X(USB_MOUNTED, "usb mounted")                                    \
+    X(USB_UNMOUNTED, "usb unmounted")                                \
+    X(USB_SUSPENDED, "usb suspended, remote wakeup %u")              \
+    X(USB_RESUMED, "usb resumed")                                    \
+    X(CONFIG_SAVED, "remap config saved")                            \
+    X(CONFIG_REJECTED, "remap command 0x%02x rejected")              \
+    X(INPUT_DROPPED, "input queue full, %u events dropped so far")
+
+typedef enum
+{
+#define LOG_ID_ENUM(id, format) LOG_##id,
+    LOG_MESSAGES(LOG_ID_ENUM)
+#undef LOG_ID_ENUM
+    LOG_MESSAGE_COUNT
+} LogMessage;
+
+#endif
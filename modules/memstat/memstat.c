@@ -0,0 +1,78 @@
+#include "memstat.h"
+#include <malloc.h>
+#include "hardware/regs/addressmap.h"
+#include "modules/be/be.h"
+
+#define MEMSTAT_PAINT 0xC5C5C5C5u
+
+// Keep clear of the frame that is painting
+#define MEMSTAT_PAINT_MARGIN 64
+
+// Linker script symbols (memmap_default.ld)
+extern uint32_t __scratch_x_end__, __scratch_y_end__;
+extern uint32_t __StackOneTop, __StackTop, __StackLimit;
+extern uint32_t __bss_end__, __end__;
+
+typedef struct
+{
+    uint32_t *bottom;
+    uint32_t *top;
+} StackRegion;
+
+static StackRegion regions[2];
+
+static void paint(uint32_t *from, uint32_t *to)
+{
+    for (volatile uint32_t *p = from; p < to; p++)
+        *p = MEMSTAT_PAINT;
+}
+
+void memstat_init(void)
+{
+    regions[0] = (StackRegion){&__scratch_y_end__, &__StackTop};
+    regions[1] = (StackRegion){&__scratch_x_end__, &__StackOneTop};
+
+    uintptr_t sp;
+    __asm volatile("mov %0, sp" : "=r"(sp));
+    paint(regions[0].bottom, (uint32_t *)(sp - MEMSTAT_PAINT_MARGIN));
+    paint(regions[1].bottom, regions[1].top);
+}
+
+uint32_t memstat_stack_used(unsigned core)
+{
+    const StackRegion *region = &regions[core & 1];
+    const uint32_t *p = region->bottom;
+    while (p < region->top && *p == MEMSTAT_PAINT)
+        p++;
+    return (uint32_t)((uintptr_t)region->top - (uintptr_t)p);
+}
+
+uint32_t memstat_stack_size(unsigned core)
+{
+    const StackRegion *region = &regions[core & 1];
+    return (uint32_t)((uintptr_t)region->top - (uintptr_t)region->bottom);
+}
+
+size_t memstat_write_report(uint8_t *buffer, size_t max_len)
+{
+    const size_t len = 1 + 2 * 4 + 3 * 4;
+    if (max_len < len)
+        return 0;
+
+    // The heap grows from __end__ up to the main RAM stack limit
+    uint32_t heap = (uint32_t)mallinfo().arena;
+    uint32_t heap_end = (uint32_t)(uintptr_t)&__end__ + heap;
+    uint32_t limit = (uint32_t)(uintptr_t)&__StackLimit;
+
+    uint8_t *p = buffer;
+    *p++ = MEMSTAT_COMMAND;
+    for (unsigned core = 0; core < 2; core++)
+    {
+        p = put_be16(p, (uint16_t)memstat_stack_used(core));
+        p = put_be16(p, (uint16_t)memstat_stack_size(core));
+    }
+    p = put_be32(p, (uint32_t)((uintptr_t)&__bss_end__ - SRAM_BASE));
+    p = put_be32(p, heap);
+    p = put_be32(p, limit > heap_end ? limit - heap_end : 0);
+    return len;
+}
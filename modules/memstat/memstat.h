@@ -0,0 +1,29 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Stack high-water marks and RAM headroom. At boot the free part of each
+// core's stack region is painted with a pattern, and the deepest
+// overwritten word gives the most stack ever used. Each core's stack is
+// the whole scratch bank it starts in (core 0: SCRATCH_Y, core 1:
+// SCRATCH_X, 4KB each, minus any __scratch_x/__scratch_y code). The
+// RP2040 runs interrupts on the stack of the core they fire on, so IRQ
+// usage is included in the core's mark; there is no separate IRQ stack.
+//
+// Raw HID 0x88 -> [0x88, per core: used, size (BE16); static RAM, heap,
+//                  free RAM between heap and stack (BE32)]
+
+#define MEMSTAT_COMMAND 0x88
+
+// Core 0, first thing in main() and before core 1 is launched
+void memstat_init(void);
+
+// Bytes of the core's stack region ever written, and the region size
+uint32_t memstat_stack_used(unsigned core);
+uint32_t memstat_stack_size(unsigned core);
+
+size_t memstat_write_report(uint8_t *buffer, size_t max_len);
+
+#endif
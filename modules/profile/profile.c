@@ -0,0 +1,131 @@
+#include "profile.h"
+
+#if PROFILE_ENABLE
+
+#include <stdio.h>
+#include <string.h>
+#include "hardware/clocks.h"
+#include "modules/hal/hal.h"
+#include "modules/be/be.h"
+
+static ProfileStats stats[PROFILE_PROBE_COUNT];
+static uint32_t xip_cleared_us;
+
+static const char *const probe_names[PROFILE_PROBE_COUNT] = {
+#define PROFILE_ID_NAME(id, name) name,
+    PROFILE_PROBES(PROFILE_ID_NAME)
+#undef PROFILE_ID_NAME
+};
+
+void profile_init(void)
+{
+    // Free-running 24-bit down counter on the processor clock
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // ENABLE | CLKSOURCE
+}
+
+void profile_reset_xip(void)
+{
+    // Any write clears a counter
+    xip_ctrl_hw->ctr_hit = 0;
+    xip_ctrl_hw->ctr_acc = 0;
+    xip_cleared_us = hal_time_us_32();
+}
+
+void profile_reset(void)
+{
+    memset(stats, 0, sizeof(stats));
+}
+
+void profile_record(ProfileProbe probe, uint32_t cycles)
+{
+    ProfileStats *s = &stats[probe];
+
+    if (s->count == 0 || cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->count++;
+    s->total += cycles;
+
+    uint bin = cycles ? 31 - __builtin_clz(cycles) : 0;
+    if (bin >= PROFILE_HIST_BINS)
+        bin = PROFILE_HIST_BINS - 1;
+    s->hist[bin]++;
+}
+
+void profile_record_us(ProfileProbe probe, uint32_t us)
+{
+    uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    uint64_t cycles = (uint64_t)us * cycles_per_us;
+    profile_record(probe, cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles);
+}
+
+const ProfileStats *profile_get(ProfileProbe probe)
+{
+    return &stats[probe];
+}
+
+const char *profile_name(ProfileProbe probe)
+{
+    return probe_names[probe];
+}
+
+// [probe, probe count, count, min, avg, max (BE32), hist (BE16, saturated)]
+size_t profile_write_report(uint8_t probe, uint8_t *buffer, size_t max_len)
+{
+    const size_t len = 2 + 4 * 4 + PROFILE_HIST_BINS * 2;
+    if (probe >= PROFILE_PROBE_COUNT || max_len < len)
+        return 0;
+
+    // Snapshot first; the other core may be updating the probe
+    ProfileStats s = stats[probe];
+
+    uint8_t *p = buffer;
+    *p++ = probe;
+    *p++ = PROFILE_PROBE_COUNT;
+    p = put_be32(p, s.count);
+    p = put_be32(p, s.min);
+    p = put_be32(p, s.count ? (uint32_t)(s.total / s.count) : 0);
+    p = put_be32(p, s.max);
+    for (int i = 0; i < PROFILE_HIST_BINS; i++)
+    {
+        p = put_be16(p, s.hist[i] > 0xFFFF ? 0xFFFF : s.hist[i]);
+    }
+    return len;
+}
+
+size_t profile_write_xip_report(uint8_t *buffer, size_t max_len)
+{
+    if (max_len < 12)
+        return 0;
+
+    uint8_t *p = buffer;
+    p = put_be32(p, xip_ctrl_hw->ctr_hit);
+    p = put_be32(p, xip_ctrl_hw->ctr_acc);
+    p = put_be32(p, hal_time_us_32() - xip_cleared_us);
+    return (size_t)(p - buffer);
+}
+
+void profile_print_summary(void)
+{
+    printf("profile (cycles)      count        min        avg        max\n");
+    for (int i = 0; i < PROFILE_PROBE_COUNT; i++)
+    {
+        ProfileStats s = stats[i];
+        if (s.count == 0)
+            continue;
+        printf("%-16s %10lu %10lu %10lu %10lu\n", probe_names[i],
+               (unsigned long)s.count, (unsigned long)s.min,
+               (unsigned long)(s.total / s.count), (unsigned long)s.max);
+    }
+
+    uint32_t hit = xip_ctrl_hw->ctr_hit;
+    uint32_t acc = xip_ctrl_hw->ctr_acc;
+    printf("xip cache        %10lu hits / %lu accesses (%lu.%lu%%)\n", (unsigned long)hit, (unsigned long)acc,
+           acc ? (unsigned long)((uint64_t)hit * 100 / acc) : 0,
+           acc ? (unsigned long)((uint64_t)hit * 1000 / acc % 10) : 0);
+}
+
+#endif
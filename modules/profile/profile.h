@@ -0,0 +1,89 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "profile_ids.h"
+
+// Cycle profiler for hot paths. Sections are timed with the per-core SysTick
+// counter (clk_sys cycles, 24-bit, so sections must stay under ~130ms);
+// longer ones use the _LONG macros, timed in us and recorded as cycles. Each
+// probe keeps count/min/avg/max and a log2 histogram: bin n counts
+// durations in [2^n, 2^(n+1)) cycles. The XIP cache hit and access
+// counters are read alongside, to check what still runs from flash. With
+// PROFILE_ENABLE 0, every macro and the module itself compile to nothing.
+
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE 0
+#endif
+
+#define PROFILE_HIST_BINS 16
+
+// Periodic UART summary
+#ifndef PROFILE_REPORT_MS
+#define PROFILE_REPORT_MS 5000
+#endif
+
+#if PROFILE_ENABLE
+
+#include "hardware/structs/systick.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/timer.h"
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PROFILE_HIST_BINS];
+} ProfileStats;
+
+// Call once on each core that records probes
+void profile_init(void);
+void profile_reset(void);
+void profile_record(ProfileProbe probe, uint32_t cycles);
+// Converts to clk_sys cycles, saturating, so every probe reports one unit
+void profile_record_us(ProfileProbe probe, uint32_t us);
+const ProfileStats *profile_get(ProfileProbe probe);
+const char *profile_name(ProfileProbe probe);
+
+// Raw HID 0x84 reply for one probe; returns bytes written
+size_t profile_write_report(uint8_t probe, uint8_t *buffer, size_t max_len);
+
+// XIP cache counters: every cached flash access from either core or DMA.
+// They saturate at 2^32 - 1 (about 30s at full rate), so clear them before
+// a measurement.
+void profile_reset_xip(void);
+// Raw HID 0x85 reply: [hits, accesses, us since the last clear (BE32)]
+size_t profile_write_xip_report(uint8_t *buffer, size_t max_len);
+
+// Print a summary of every probe to stdio (UART)
+void profile_print_summary(void);
+
+static inline uint32_t profile_now(void)
+{
+    return systick_hw->cvr;
+}
+
+#define PROFILE_BEGIN(id) const uint32_t profile_start_##id = profile_now()
+// SysTick counts down
+#define PROFILE_END(id) \
+    profile_record(PROFILE_##id, (profile_start_##id - profile_now()) & 0xFFFFFF)
+
+// Sections that can outlast a SysTick wrap, such as a sector erase (up to
+// ~400ms), on the 1MHz timer
+#define PROFILE_BEGIN_LONG(id) const uint32_t profile_start_##id = time_us_32()
+#define PROFILE_END_LONG(id) profile_record_us(PROFILE_##id, time_us_32() - profile_start_##id)
+
+#else
+
+#define profile_init() ((void)0)
+#define PROFILE_BEGIN(id) ((void)0)
+#define PROFILE_END(id) ((void)0)
+#define PROFILE_BEGIN_LONG(id) ((void)0)
+#define PROFILE_END_LONG(id) ((void)0)
+
+#endif
+
+#endif
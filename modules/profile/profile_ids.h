@@ -0,0 +1,23 @@
+#ifndef PROFILE_IDS_H
+#define PROFILE_IDS_H
+
+// Profiled sections: X(id, name). Shared with the host tools, so new
+// probes go at the end to keep the numbering stable.
+#define PROFILE_PROBES(X)                   \
+    X(USB, "tud_task")                      \
+    X(HID, "hid_task")                      \
+    X(DEBOUNCE, "debounce_update")          \
+    X(ENCODER, "ec11_read_delta")           \
+    X(EFFECTS, "effects_render")            \
+    X(DITHER, "ws2812_dither")              \
+    X(FLASH_SAVE, "flash_save")
+
+typedef enum
+{
+#define PROFILE_ID_ENUM(id, name) PROFILE_##id,
+    PROFILE_PROBES(PROFILE_ID_ENUM)
+#undef PROFILE_ID_ENUM
+    PROFILE_PROBE_COUNT
+} ProfileProbe;
+
+#endif
@@ -1,49 +1,315 @@
 // remap.c
 #include "remap.h"
 #include "ws2812.h"
+#include "modules/rgb/effects.h"
+#include "modules/profile/profile.h"
 #include <string.h>
 
-static RemapConfig current_config;
+// The active config is published by flipping a pointer between two snapshots.
+// Writers only ever edit the inactive one, so readers never see a half
+// applied update and never need to lock or copy.
+//
+// The inactive slot is the one readers may still hold from before the last
+// flip, so it is only reused once they are done with it. Writes happen on
+// core 0, whose own readers (the main loop, the action alarm IRQ) cannot
+// overlap a write: they run to completion on the same core. Core 1 holds a
+// snapshot for a whole LED frame, so it reports remap_quiescent() between
+// frames and the writer waits until it has done so since the last publish.
+static RemapSnapshot snapshots[2];
+static RemapSnapshot *volatile active_snapshot = &snapshots[0];
+static volatile uint32_t config_sequence = 0;
+static volatile uint32_t reader_sequence = 0; // Last sequence core 1 acknowledged
+static volatile bool reader_running = false;
+
+// Resolve layer transparency once so the engine looks up a single entry
+static void remap_compile_layers(RemapSnapshot *snapshot)
+{
+    const ActionConfig *action = &snapshot->action;
+    RemapTables *tables = &snapshot->tables;
+
+    for (int layer = 0; layer < ACTION_LAYER_COUNT; layer++)
+    {
+        for (int i = 0; i < BUTTON_COUNT; i++)
+        {
+            uint16_t resolved = ACTION_NONE;
+            for (int l = layer; l >= 0 && resolved == ACTION_NONE; l--)
+            {
+                resolved = action->layers[l][i];
+            }
+            if (resolved == ACTION_NONE)
+            {
+                resolved = ACTION_KEY(snapshot->config.keymap_keyboard[i]);
+            }
+            tables->layer_actions[layer][i] = resolved;
+        }
+    }
+
+    tables->combo_buttons = 0;
+    for (int i = 0; i < ACTION_COMBO_COUNT; i++)
+    {
+        const ComboDef *combo = &action->combos[i];
+        if (combo->action != ACTION_NONE && __builtin_popcount(combo->buttons) >= 2)
+        {
+            tables->combo_buttons |= combo->buttons;
+        }
+    }
+}
+
+// Rebuild the derived tables from the snapshot's config. Each LUT entry extends
+// the entry with its highest set bit cleared, so a full rebuild is O(LUT size).
+static void remap_compile_tables(RemapSnapshot *snapshot)
+{
+    const RemapConfig *config = &snapshot->config;
+    RemapTables *tables = &snapshot->tables;
+
+    remap_compile_layers(snapshot);
+
+    for (int byte = 0; byte < REMAP_MASK_BYTES; byte++)
+    {
+        tables->gamepad_buttons[byte][0] = 0;
+        for (int layer = 0; layer < ACTION_LAYER_COUNT; layer++)
+        {
+            tables->keyboard_keys[layer][byte][0] = (RemapKeyList){0};
+        }
+
+        for (uint32_t value = 1; value < REMAP_LUT_SIZE; value++)
+        {
+            int bit = 31 - __builtin_clz(value);
+            int button = byte * 8 + bit;
+            uint32_t prev = value & ~(1u << bit);
+
+            uint32_t gamepad = tables->gamepad_buttons[byte][prev];
+            if (button < BUTTON_COUNT && config->keymap_gamepad[button] < 32)
+            {
+                gamepad |= 1u << config->keymap_gamepad[button];
+            }
+            tables->gamepad_buttons[byte][value] = gamepad;
+
+            for (int layer = 0; layer < ACTION_LAYER_COUNT; layer++)
+            {
+                RemapKeyList keys = tables->keyboard_keys[layer][byte][prev];
+
+                uint16_t action = (button < BUTTON_COUNT) ? tables->layer_actions[layer][button] : ACTION_NONE;
+                uint8_t keycode = ACTION_KEYCODE(action);
+                if (ACTION_TYPE(action) == ACTION_TYPE_KEY && keycode != 0)
+                {
+                    if (remap_keycode_is_modifier(keycode))
+                    {
+                        keys.modifiers |= 1u << (keycode - 0xE0);
+                    }
+                    else if (keys.count < REMAP_MAX_KEYS)
+                    {
+                        keys.keycodes[keys.count++] = keycode;
+                    }
+                }
+                tables->keyboard_keys[layer][byte][value] = keys;
+            }
+        }
+    }
+
+    ws2812_build_luts(&tables->luts, config->brightness,
+                      snapshot->calibration.r, snapshot->calibration.g, snapshot->calibration.b);
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        RGBColor color = config->button_colors[i];
+        tables->led_words[i] = ws2812_encode_color_with(&tables->luts, color.r, color.g, color.b);
+    }
+}
+
+// Return the inactive snapshot, seeded with a copy of the active config
+static RemapSnapshot *remap_stage(void)
+{
+    // At most one LED frame; before core 1 runs there is nobody to wait for
+    while (reader_running && reader_sequence != config_sequence)
+    {
+    }
+
+    const RemapSnapshot *active = active_snapshot;
+    RemapSnapshot *staging = (active == &snapshots[0]) ? &snapshots[1] : &snapshots[0];
+
+    staging->config = active->config;
+    staging->action = active->action;
+    staging->calibration = active->calibration;
+    staging->effects = active->effects;
+    return staging;
+}
+
+// Apply side effects, compile the staged snapshot and make it active
+static void remap_publish(RemapSnapshot *staging)
+{
+    remap_compile_tables(staging);
+    staging->sequence = config_sequence + 1;
+
+    // Everything above must be visible before the pointer flip
+    hal_fence_release();
+    active_snapshot = staging;
+    config_sequence = staging->sequence;
+}
+
+static void remap_load_defaults(RemapConfig *config)
+{
+    memcpy(config->keymap_keyboard, default_keymap_keyboard_mode,
+           sizeof(default_keymap_keyboard_mode));
+    memcpy(config->keymap_gamepad, default_keymap_gamepad_mode,
+           sizeof(default_keymap_gamepad_mode));
+    memcpy(config->button_colors, default_button_colors,
+           sizeof(default_button_colors));
+    config->brightness = DEFAULT_BRIGHTNESS;
+    config->anim_speed = DEFAULT_ANIM_SPEED;
+}
+
+static void remap_load_calibration_defaults(RGBColor *calibration)
+{
+    *calibration = (RGBColor){WS2812_CALIBRATION_R, WS2812_CALIBRATION_G, WS2812_CALIBRATION_B};
+}
+
+static void remap_load_effects_defaults(RemapEffects *effects)
+{
+    *effects = (RemapEffects){EFFECTS_DEFAULT_BASE, REMAP_EFFECT_FADE | REMAP_EFFECT_RIPPLE};
+}
+
+static void remap_load_action_defaults(ActionConfig *action)
+{
+    // All layers transparent, no combos or macros: behaves like the plain keymap
+    memset(action, 0, sizeof(ActionConfig));
+    action->tapping_term_ms = DEFAULT_TAPPING_TERM_MS;
+    action->combo_term_ms = DEFAULT_COMBO_TERM_MS;
+    action->tap_release_ms = DEFAULT_TAP_RELEASE_MS;
+}
 
 void remap_init(void)
 {
-    const StoredConfig *stored = (const StoredConfig *)(XIP_BASE + REMAP_CONFIG_OFFSET);
+    const StoredConfig *stored = hal_flash_read(REMAP_CONFIG_OFFSET);
+    RemapSnapshot *staging = remap_stage();
 
     if (stored->magic == FLASH_CONFIG_MAGIC)
     {
         // Load configuration from flash
-        memcpy(&current_config, &stored->config, sizeof(RemapConfig));
+        memcpy(&staging->config, &stored->config, sizeof(RemapConfig));
     }
     else
     {
         // Use default configuration
-        memcpy(current_config.keymap_keyboard, default_keymap_keyboard_mode,
-               sizeof(default_keymap_keyboard_mode));
-        memcpy(current_config.keymap_gamepad, default_keymap_gamepad_mode,
-               sizeof(default_keymap_gamepad_mode));
-        memcpy(current_config.button_colors, default_button_colors,
-               sizeof(default_button_colors));
-        current_config.brightness = DEFAULT_BRIGHTNESS;
-        current_config.anim_speed = DEFAULT_ANIM_SPEED;
+        remap_load_defaults(&staging->config);
+    }
+
+    // Configs saved before the action engine existed have no action block
+    if (stored->magic == FLASH_CONFIG_MAGIC && stored->action_magic == ACTION_CONFIG_MAGIC)
+    {
+        memcpy(&staging->action, &stored->action, sizeof(ActionConfig));
+    }
+    else
+    {
+        remap_load_action_defaults(&staging->action);
+    }
+
+    // Likewise the LED calibration, which follows the action block
+    if (stored->magic == FLASH_CONFIG_MAGIC && stored->action_magic == ACTION_CONFIG_MAGIC &&
+        stored->calibration_magic == CALIBRATION_MAGIC)
+    {
+        staging->calibration = stored->calibration;
+    }
+    else
+    {
+        remap_load_calibration_defaults(&staging->calibration);
+    }
+
+    // And the effect selection after that
+    if (stored->magic == FLASH_CONFIG_MAGIC && stored->action_magic == ACTION_CONFIG_MAGIC &&
+        stored->calibration_magic == CALIBRATION_MAGIC && stored->effects_magic == EFFECTS_MAGIC &&
+        stored->effects.base < EFFECT_BASE_COUNT)
+    {
+        staging->effects = stored->effects;
+    }
+    else
+    {
+        remap_load_effects_defaults(&staging->effects);
     }
 
     // Apply configuration
-    ws2812_set_brightness(current_config.brightness);
+    remap_publish(staging);
+}
+
+const RemapSnapshot *remap_acquire(void)
+{
+    const RemapSnapshot *snapshot = active_snapshot;
+    hal_fence_acquire();
+    return snapshot;
+}
+
+void remap_quiescent(void)
+{
+    // Core 0 readers never overlap the writer; in the host simulation both
+    // cores run as core 0 on one thread
+    if (hal_core_num() == 0)
+        return;
+
+    reader_sequence = config_sequence;
+    reader_running = true;
+}
+
+uint32_t remap_get_sequence(void)
+{
+    return config_sequence;
 }
 
 const RemapConfig *remap_get_config(void)
 {
-    return &current_config;
+    return &remap_acquire()->config;
+}
+
+const RemapTables *remap_get_tables(void)
+{
+    return &remap_acquire()->tables;
+}
+
+// Append the plain keys held on one layer to keys, capped at REMAP_MAX_KEYS
+void remap_lookup_keyboard(const RemapTables *tables, uint8_t layer, uint32_t btn, RemapKeyList *keys)
+{
+    for (int i = 0; i < REMAP_MASK_BYTES; i++)
+    {
+        const RemapKeyList *entry = &tables->keyboard_keys[layer][i][(btn >> (i * 8)) & (REMAP_LUT_SIZE - 1)];
+
+        keys->modifiers |= entry->modifiers;
+        for (int k = 0; k < entry->count && keys->count < REMAP_MAX_KEYS; k++)
+        {
+            keys->keycodes[keys->count++] = entry->keycodes[k];
+        }
+    }
 }
 
 void remap_get_raw_config(uint8_t *buffer, size_t max_len)
 {
-    const RemapConfig *config = remap_get_config();
-    size_t copy_len = sizeof(RemapConfig);
+    const RemapSnapshot *snapshot = remap_acquire();
+    uint8_t raw[REMAP_RAW_CONFIG_SIZE];
+    size_t copy_len = sizeof(raw);
+
+    memcpy(raw, &snapshot->config, sizeof(RemapConfig));
+    memcpy(raw + sizeof(RemapConfig), &snapshot->calibration, sizeof(RGBColor));
+    memcpy(raw + sizeof(RemapConfig) + sizeof(RGBColor), &snapshot->effects, sizeof(RemapEffects));
 
     if (copy_len > max_len)
         copy_len = max_len;
-    memcpy(buffer, config, copy_len);
+    memcpy(buffer, raw, copy_len);
+
+    if (copy_len < max_len)
+    {
+        memset(buffer + copy_len, 0, max_len - copy_len);
+    }
+}
+
+void remap_get_raw_action_config(uint16_t offset, uint8_t *buffer, size_t max_len)
+{
+    const uint8_t *action = (const uint8_t *)&remap_acquire()->action;
+    size_t copy_len = 0;
+
+    if (offset < sizeof(ActionConfig))
+    {
+        copy_len = sizeof(ActionConfig) - offset;
+        if (copy_len > max_len)
+            copy_len = max_len;
+        memcpy(buffer, action + offset, copy_len);
+    }
 
     if (copy_len < max_len)
     {
@@ -55,20 +321,46 @@ void remap_ret_firmware_version(uint8_t *buffer, size_t max_len)
 {
     const char version_info[] = FIRMWARE_VERSION "-" COMPILE_TIMESTAMP;
     size_t version_len = strlen(version_info);
-    
+
     if (version_len > max_len)
         version_len = max_len;
-    
+
     memcpy(buffer, version_info, version_len);
-    
+
     if (version_len < max_len)
     {
         memset(buffer + version_len, 0, max_len - version_len);
     }
 }
 
-bool remap_process_command(const uint8_t *data, uint16_t len)
+// Layer and macro references must name an existing layer or macro; the
+// engine checks again, but a bad action is rejected here, not stored
+static bool remap_action_valid(uint16_t action)
 {
+    switch (ACTION_TYPE(action))
+    {
+    case ACTION_TYPE_KEY:
+    case ACTION_TYPE_MT:
+        return true;
+    case ACTION_TYPE_MO:
+    case ACTION_TYPE_TG:
+        return ACTION_INDEX(action) < ACTION_LAYER_COUNT;
+    case ACTION_TYPE_LT:
+        return ACTION_PARAM(action) < ACTION_LAYER_COUNT;
+    case ACTION_TYPE_MACRO:
+        return ACTION_INDEX(action) < ACTION_MACRO_COUNT;
+    default:
+        return false;
+    }
+}
+
+// Apply a command to a staged config. Persisting is left to the caller, which
+// saves after every successfully processed command.
+static bool remap_apply_command(RemapSnapshot *staging, const uint8_t *data, uint16_t len)
+{
+    RemapConfig *config = &staging->config;
+    ActionConfig *action = &staging->action;
+
     if (len < 2)
         return false;
     uint8_t cmd_type = data[0];
@@ -84,7 +376,7 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
     case 0x01: // Remap keyboard key value
         if (cmd_len == BUTTON_COUNT)
         {
-            memcpy(current_config.keymap_keyboard, payload, BUTTON_COUNT);
+            memcpy(config->keymap_keyboard, payload, BUTTON_COUNT);
             return true;
         }
         break;
@@ -92,7 +384,7 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
     case 0x02: // Remap gamepad key value
         if (cmd_len == BUTTON_COUNT)
         {
-            memcpy(current_config.keymap_gamepad, payload, BUTTON_COUNT);
+            memcpy(config->keymap_gamepad, payload, BUTTON_COUNT);
             return true;
         }
         break;
@@ -102,9 +394,9 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
         {
             for (int i = 0; i < BUTTON_COUNT; i++)
             {
-                current_config.button_colors[i].r = payload[i * 3];
-                current_config.button_colors[i].g = payload[i * 3 + 1];
-                current_config.button_colors[i].b = payload[i * 3 + 2];
+                config->button_colors[i].r = payload[i * 3];
+                config->button_colors[i].g = payload[i * 3 + 1];
+                config->button_colors[i].b = payload[i * 3 + 2];
             }
             return true;
         }
@@ -113,8 +405,7 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
     case 0x04: // Set brightness
         if (cmd_len == 1)
         {
-            current_config.brightness = payload[0] / 255.0f;
-            ws2812_set_brightness(current_config.brightness);
+            config->brightness = payload[0] / 255.0f;
             return true;
         }
         break;
@@ -122,7 +413,7 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
     case 0x05: // Set animation speed
         if (cmd_len == 2)
         {
-            current_config.anim_speed = (payload[0] << 8) | payload[1];
+            config->anim_speed = (payload[0] << 8) | payload[1];
             return true;
         }
         break;
@@ -130,51 +421,128 @@ bool remap_process_command(const uint8_t *data, uint16_t len)
     case 0x06: // Restore default settings
         if (cmd_len == 0)
         {
-            // Restore keyboard mapping
-            memcpy(current_config.keymap_keyboard, default_keymap_keyboard_mode,
-                   sizeof(default_keymap_keyboard_mode));
-            // Restore gamepad mapping
-            memcpy(current_config.keymap_gamepad, default_keymap_gamepad_mode,
-                   sizeof(default_keymap_gamepad_mode));
-            // Restore button colors
-            memcpy(current_config.button_colors, default_button_colors,
-                   sizeof(default_button_colors));
-            // Restore brightness and animation speed
-            current_config.brightness = DEFAULT_BRIGHTNESS;
-            current_config.anim_speed = DEFAULT_ANIM_SPEED;
-
-            // Apply brightness setting
-            ws2812_set_brightness(current_config.brightness);
-
-            // Save to Flash
-            remap_save_config();
-
+            remap_load_defaults(config);
+            remap_load_action_defaults(action);
+            remap_load_calibration_defaults(&staging->calibration);
+            remap_load_effects_defaults(&staging->effects);
             return true;
         }
         break;
 
     case 0x07: // Save current configuration
-        if (cmd_len == 0)   
+        if (cmd_len == 0)
+        {
+            return true;
+        }
+        break;
+
+    case 0x08: // Set LED calibration: full scale of r, g, b (255 = unscaled)
+        if (cmd_len == 3)
+        {
+            staging->calibration = (RGBColor){payload[0], payload[1], payload[2]};
+            return true;
+        }
+        break;
+
+    case 0x09: // Set LED effects: base animation, REMAP_EFFECT_* reactive flags
+        if (cmd_len == 2 && payload[0] < EFFECT_BASE_COUNT &&
+            !(payload[1] & ~(REMAP_EFFECT_FADE | REMAP_EFFECT_RIPPLE)))
+        {
+            staging->effects = (RemapEffects){payload[0], payload[1]};
+            return true;
+        }
+        break;
+
+    case 0x10: // Set layer actions: layer, then one big-endian action per button
+        if (cmd_len == 1 + BUTTON_COUNT * 2 && payload[0] < ACTION_LAYER_COUNT)
         {
-            remap_save_config();
+            uint16_t actions[BUTTON_COUNT];
+            for (int i = 0; i < BUTTON_COUNT; i++)
+            {
+                actions[i] = (payload[1 + i * 2] << 8) | payload[2 + i * 2];
+                if (!remap_action_valid(actions[i]))
+                    return false;
+            }
+            memcpy(action->layers[payload[0]], actions, sizeof(actions));
             return true;
         }
+        break;
+
+    case 0x11: // Set combo: index, buttons, action
+        if (cmd_len == 5 && payload[0] < ACTION_COMBO_COUNT)
+        {
+            uint16_t combo_action = (payload[3] << 8) | payload[4];
+            if (!remap_action_valid(combo_action))
+                break;
+
+            ComboDef *combo = &action->combos[payload[0]];
+            combo->buttons = (payload[1] << 8) | payload[2];
+            combo->action = combo_action;
+            return true;
+        }
+        break;
+
+    case 0x12: // Set macro steps: macro, first step, then op/keycode/delay_us per step
+        if (cmd_len >= 2 && (cmd_len - 2) % 4 == 0 && payload[0] < ACTION_MACRO_COUNT)
+        {
+            uint8_t first = payload[1];
+            uint8_t count = (cmd_len - 2) / 4;
+            if (first + count > ACTION_MACRO_STEPS)
+                break;
+
+            for (int i = 0; i < count; i++)
+            {
+                const uint8_t *step = payload + 2 + i * 4;
+                action->macros[payload[0]][first + i] = (MacroStep){
+                    .op = step[0],
+                    .keycode = step[1],
+                    .delay_us = (step[2] << 8) | step[3]};
+            }
+            return true;
+        }
+        break;
+
+    case 0x13: // Set tapping term, combo term and tap release time (ms)
+        if (cmd_len == 6)
+        {
+            action->tapping_term_ms = (payload[0] << 8) | payload[1];
+            action->combo_term_ms = (payload[2] << 8) | payload[3];
+            action->tap_release_ms = (payload[4] << 8) | payload[5];
+            return true;
+        }
+        break;
     }
 
     return false;
 }
 
+bool remap_process_command(const uint8_t *data, uint16_t len)
+{
+    RemapSnapshot *staging = remap_stage();
+
+    if (!remap_apply_command(staging, data, len))
+        return false;
+
+    remap_publish(staging);
+    return true;
+}
+
 void remap_save_config(void)
 {
+    const RemapSnapshot *snapshot = remap_acquire();
     StoredConfig stored = {
         .magic = FLASH_CONFIG_MAGIC,
-        .config = current_config};
+        .config = snapshot->config,
+        .action_magic = ACTION_CONFIG_MAGIC,
+        .action = snapshot->action,
+        .calibration_magic = CALIBRATION_MAGIC,
+        .calibration = snapshot->calibration,
+        .effects_magic = EFFECTS_MAGIC,
+        .effects = snapshot->effects};
 
-    uint8_t sector[FLASH_SECTOR_SIZE] = {0};
-    memcpy(sector, &stored, sizeof(StoredConfig));
+    PROFILE_BEGIN_LONG(FLASH_SAVE);
 
-    uint32_t ints = save_and_disable_interrupts();
-    flash_range_erase(REMAP_CONFIG_OFFSET, FLASH_SECTOR_SIZE);
-    flash_range_program(REMAP_CONFIG_OFFSET, sector, FLASH_SECTOR_SIZE);
-    restore_interrupts(ints);
-}
\ No newline at end of file
+    hal_flash_write_sector(REMAP_CONFIG_OFFSET, &stored, sizeof(stored));
+
+    PROFILE_END_LONG(FLASH_SAVE);
+}
@@ -1,12 +1,20 @@
 #pragma once
 
 #include "config.h"
-#include "hardware/flash.h"
+#include "modules/hal/hal.h"
+#include "modules/rgb/ws2812.h"
+#include <stddef.h>
 
 #define FLASH_TARGET_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
 #define FLASH_CONFIG_MAGIC 0x55AA1234
+#define ACTION_CONFIG_MAGIC 0x41435431 // "ACT1"
+#define CALIBRATION_MAGIC 0x43414C31   // "CAL1"
+#define EFFECTS_MAGIC 0x45465831       // "EFX1"
 
 #define REMAP_CONFIG_SIZE sizeof(RemapConfig)
+// Raw HID 0x82 reply body: RemapConfig, the LED calibration, then the
+// effect selection
+#define REMAP_RAW_CONFIG_SIZE (sizeof(RemapConfig) + sizeof(RGBColor) + sizeof(RemapEffects))
 
 typedef struct
 {
@@ -17,17 +25,167 @@ typedef struct
     uint16_t anim_speed;
 } RemapConfig;
 
+// LED effect selection (modules/rgb/effects.h)
+#define REMAP_EFFECT_FADE 0x01   // Fade out after release
+#define REMAP_EFFECT_RIPPLE 0x02 // Ripple on press
+
+typedef struct
+{
+    uint8_t base;     // EffectBase
+    uint8_t reactive; // REMAP_EFFECT_* flags
+} RemapEffects;
+
+//--------------------------------------------------------------------+
+// Action engine configuration (layers, tap-hold, combos, macros)
+//--------------------------------------------------------------------+
+
+#define ACTION_LAYER_COUNT 4
+#define ACTION_COMBO_COUNT 8
+#define ACTION_MACRO_COUNT 4
+#define ACTION_MACRO_STEPS 16
+
+#define DEFAULT_TAPPING_TERM_MS 200
+#define DEFAULT_COMBO_TERM_MS 50
+#define DEFAULT_TAP_RELEASE_MS 10
+
+// 16-bit action codes. ACTION_NONE on a layer is transparent and falls
+// through to the layer below; on layer 0 it falls through to keymap_keyboard.
+#define ACTION_NONE 0x0000
+#define ACTION_KEY(kc) (0x0000 | (kc))
+#define ACTION_MO(layer) (0x1000 | (layer))
+#define ACTION_TG(layer) (0x2000 | (layer))
+#define ACTION_LT(layer, kc) (0x3000 | ((layer) << 8) | (kc))
+#define ACTION_MT(mod, kc) (0x4000 | ((mod) << 8) | (kc))
+#define ACTION_MACRO(index) (0x5000 | (index))
+
+#define ACTION_TYPE(action) ((action) & 0xF000)
+#define ACTION_PARAM(action) (((action) >> 8) & 0x0F)
+#define ACTION_KEYCODE(action) ((action) & 0xFF)
+#define ACTION_INDEX(action) ((action) & 0xFF)
+
+#define ACTION_TYPE_KEY 0x0000
+#define ACTION_TYPE_MO 0x1000
+#define ACTION_TYPE_TG 0x2000
+#define ACTION_TYPE_LT 0x3000
+#define ACTION_TYPE_MT 0x4000
+#define ACTION_TYPE_MACRO 0x5000
+
+typedef enum
+{
+    MACRO_OP_END,
+    MACRO_OP_PRESS,
+    MACRO_OP_RELEASE,
+    MACRO_OP_TAP,
+    MACRO_OP_WAIT
+} MacroOp;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t keycode;
+    uint16_t delay_us; // Wait after this step (TAP: hold time)
+} MacroStep;
+
+typedef struct
+{
+    uint16_t buttons; // Bitmask of buttons that must be pressed together
+    uint16_t action;
+} ComboDef;
+
+typedef struct
+{
+    uint16_t layers[ACTION_LAYER_COUNT][BUTTON_COUNT];
+    ComboDef combos[ACTION_COMBO_COUNT];
+    MacroStep macros[ACTION_MACRO_COUNT][ACTION_MACRO_STEPS];
+    uint16_t tapping_term_ms;
+    uint16_t combo_term_ms;
+    uint16_t tap_release_ms;
+} ActionConfig;
+
+//--------------------------------------------------------------------+
+// Derived tables
+//--------------------------------------------------------------------+
+
+// Derived lookup tables, compiled from the active RemapConfig whenever it
+// changes so the per-frame report and LED paths are plain table lookups.
+#define REMAP_MASK_BYTES ((BUTTON_COUNT + 7) / 8)
+#define REMAP_LUT_SIZE (BUTTON_COUNT >= 8 ? 256 : (1u << BUTTON_COUNT))
+#define REMAP_MAX_KEYS 6
+
+typedef struct
+{
+    uint8_t modifiers;
+    uint8_t count;
+    uint8_t keycodes[REMAP_MAX_KEYS];
+} RemapKeyList;
+
+typedef struct
+{
+    // Indexed by one byte of the pressed-button bitmask
+    uint32_t gamepad_buttons[REMAP_MASK_BYTES][REMAP_LUT_SIZE];
+    // Per layer; only buttons whose resolved action is a plain key contribute
+    RemapKeyList keyboard_keys[ACTION_LAYER_COUNT][REMAP_MASK_BYTES][REMAP_LUT_SIZE];
+    // Layer actions with transparency already resolved
+    uint16_t layer_actions[ACTION_LAYER_COUNT][BUTTON_COUNT];
+    uint32_t combo_buttons;
+    // Output tables for the configured brightness, and the button colors
+    // pre-encoded with them
+    ws2812_luts_t luts;
+    uint32_t led_words[BUTTON_COUNT];
+} RemapTables;
+
+// One published version of the config together with its derived tables.
+// Readers take a snapshot once per frame; sequence increments on every publish.
+typedef struct
+{
+    RemapConfig config;
+    ActionConfig action;
+    RGBColor calibration; // WS2812 full scale per channel, 255 = unscaled
+    RemapEffects effects;
+    RemapTables tables;
+    uint32_t sequence;
+} RemapSnapshot;
+
 #pragma pack(push, 1)
 typedef struct
 {
     uint32_t magic;
     RemapConfig config;
+    uint32_t action_magic;
+    ActionConfig action;
+    uint32_t calibration_magic;
+    RGBColor calibration;
+    uint32_t effects_magic;
+    RemapEffects effects;
 } StoredConfig;
 #pragma pack(pop)
 
 void remap_init(void);
+const RemapSnapshot *remap_acquire(void);
+// Core 1, at a point where it holds no snapshot (see remap.c)
+void remap_quiescent(void);
+uint32_t remap_get_sequence(void);
 const RemapConfig *remap_get_config(void);
+const RemapTables *remap_get_tables(void);
+void remap_lookup_keyboard(const RemapTables *tables, uint8_t layer, uint32_t btn, RemapKeyList *keys);
 bool remap_process_command(const uint8_t *data, uint16_t len);
 void remap_get_raw_config(uint8_t *buffer, size_t max_len);
+void remap_get_raw_action_config(uint16_t offset, uint8_t *buffer, size_t max_len);
 void remap_ret_firmware_version(uint8_t *buffer, size_t max_len);
 void remap_save_config(void);
+
+static inline uint32_t remap_lookup_gamepad(const RemapTables *tables, uint32_t btn)
+{
+    uint32_t buttons = 0;
+    for (int i = 0; i < REMAP_MASK_BYTES; i++)
+    {
+        buttons |= tables->gamepad_buttons[i][(btn >> (i * 8)) & (REMAP_LUT_SIZE - 1)];
+    }
+    return buttons;
+}
+
+// HID modifier keycodes (0xE0-0xE7) map onto the report's modifier byte
+static inline bool remap_keycode_is_modifier(uint8_t keycode)
+{
+    return keycode >= 0xE0 && keycode <= 0xE7;
+}
@@ -0,0 +1,109 @@
+#include "report.h"
+#include "modules/action/action.h"
+#include "modules/usb/usb_descriptors.h"
+#include "modules/hal/hal.h"
+#include "modules/trace/trace.h"
+#include <string.h>
+#include <math.h>
+
+static RemapKeyList prev_keys;
+static float remaining_delta[2];
+static uint16_t gamepad_axis[2];
+
+void report_reset(void)
+{
+    memset(&prev_keys, 0, sizeof(prev_keys));
+    remaining_delta[0] = remaining_delta[1] = 0.0f;
+    gamepad_axis[0] = gamepad_axis[1] = 0;
+}
+
+void report_add_mouse_motion(ReportAxis axis, int32_t delta)
+{
+    remaining_delta[axis] += delta;
+}
+
+void report_add_gamepad_motion(ReportAxis axis, int32_t delta)
+{
+    gamepad_axis[axis] = (uint16_t)(gamepad_axis[axis] + delta) % 512; // 512 cycle period (2 full rotations)
+}
+
+// Take about 1/MOUSE_SMOOTHING_FACTOR of the remaining motion
+static int8_t smooth_step(float *remaining)
+{
+    if (fabsf(*remaining) < 1.0f)
+        return 0;
+
+    const float ideal_step = *remaining / MOUSE_SMOOTHING_FACTOR;
+    int8_t quantized_step = (int8_t)roundf(ideal_step);
+
+    if (fabsf((float)quantized_step) > fabsf(*remaining))
+    {
+        quantized_step = (*remaining > 0) ? 1 : -1;
+    }
+
+    *remaining -= quantized_step;
+    return quantized_step;
+}
+
+// The trace span ends in tud_hid_report_complete_cb()
+static inline bool queued(uint8_t itf, bool sent)
+{
+    if (sent)
+        TRACE_EVENT(REPORT_QUEUED, itf, 0);
+    return sent;
+}
+
+bool report_send_keyboard(void)
+{
+    if (!hal_hid_ready(INTERFACE_KEYBOARD))
+        return false;
+
+    // Output can change without a button change (tap releases, macros), so
+    // compare the resolved report rather than the raw button state
+    RemapKeyList keys;
+    action_build_keyboard(&keys);
+    if (memcmp(&keys, &prev_keys, sizeof(keys)) == 0)
+        return false;
+    prev_keys = keys;
+
+    uint8_t keycode[6] = {0};
+    memcpy(keycode, keys.keycodes, keys.count);
+    return queued(INTERFACE_KEYBOARD,
+                  hal_hid_keyboard_report(INTERFACE_KEYBOARD, keys.modifiers, keys.count ? keycode : NULL));
+}
+
+bool report_send_mouse(void)
+{
+    if (!hal_hid_ready(INTERFACE_MOUSE))
+        return false;
+
+    int8_t step_x = smooth_step(&remaining_delta[0]) * MOUSE_SENSITIVITY_MULTIPLIER;
+    int8_t step_y = smooth_step(&remaining_delta[1]) * MOUSE_SENSITIVITY_MULTIPLIER;
+    if (step_x == 0 && step_y == 0)
+        return false;
+
+    return queued(INTERFACE_MOUSE, hal_hid_mouse_report(INTERFACE_MOUSE, 0x00, step_x, step_y, 0, 0));
+}
+
+bool report_send_gamepad(uint32_t btn_state)
+{
+    if (!hal_hid_ready(INTERFACE_GAMEPAD))
+        return false;
+
+    uint32_t gamepad_buttons = remap_lookup_gamepad(remap_get_tables(), btn_state);
+
+    // Map encoder positions to gamepad axes
+    int16_t mapped_x = (int16_t)gamepad_axis[0] * 255 / 256 - 255;
+    int16_t mapped_y = (int16_t)gamepad_axis[1] * 255 / 256 - 255;
+
+    bool sent = hal_hid_gamepad_report(INTERFACE_GAMEPAD,
+                                       (int8_t)mapped_x, // X
+                                       (int8_t)mapped_y, // Y
+                                       0,                // Z
+                                       0,                // Rz
+                                       0,                // Rx
+                                       0,                // Ry
+                                       0,                // Hat
+                                       gamepad_buttons);
+    return queued(INTERFACE_GAMEPAD, sent);
+}
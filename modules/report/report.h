@@ -0,0 +1,36 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// HID report building for the keyboard/mouse and gamepad modes. Encoder
+// motion accumulates here; in mouse mode it is drained a fraction per report
+// so the pointer glides instead of jumping. Reports go out through the HAL.
+
+#define ENCODER_BASE_SENSITIVITY 5     // Base encoder sensitivity
+#define MOUSE_SENSITIVITY_MULTIPLIER 2 // Mouse movement multiplier
+#define GAMEPAD_SENSITIVITY 10         // Gamepad axis sensitivity
+#define MOUSE_SMOOTHING_FACTOR 6.0f    // Smoothing factor for mouse movement
+
+typedef enum
+{
+    REPORT_AXIS_X,
+    REPORT_AXIS_Y
+} ReportAxis;
+
+void report_reset(void);
+
+// Encoder motion in keyboard/mouse mode
+void report_add_mouse_motion(ReportAxis axis, int32_t delta);
+// Encoder motion in gamepad mode; an axis wraps every 512 counts
+void report_add_gamepad_motion(ReportAxis axis, int32_t delta);
+
+// Each returns true if a report was sent
+// Keys resolved by the action engine; only sent when they change
+bool report_send_keyboard(void);
+// One smoothing step of the pending mouse motion
+bool report_send_mouse(void);
+bool report_send_gamepad(uint32_t btn_state);
+
+#endif
@@ -0,0 +1,107 @@
+#include "report_task.h"
+#include "report.h"
+#include "modules/action/action.h"
+#include "modules/hal/hal.h"
+#include "modules/log/log.h"
+
+static ReportMode mode;
+static EC11_Encoder *encoders[2];
+static uint32_t btn_state;
+static report_event_fn event_fn;
+static void *event_ctx;
+
+void report_encoder_x_callback(EC11_Direction dir, void *user_data)
+{
+    (void)user_data;
+    if (mode == REPORT_MODE_GAMEPAD)
+        report_add_gamepad_motion(REPORT_AXIS_X, dir * GAMEPAD_SENSITIVITY);
+    else
+        report_add_mouse_motion(REPORT_AXIS_X, dir * ENCODER_BASE_SENSITIVITY);
+}
+
+// The Y encoder is mounted the other way round
+void report_encoder_y_callback(EC11_Direction dir, void *user_data)
+{
+    (void)user_data;
+    if (mode == REPORT_MODE_GAMEPAD)
+        report_add_gamepad_motion(REPORT_AXIS_Y, -dir * GAMEPAD_SENSITIVITY);
+    else
+        report_add_mouse_motion(REPORT_AXIS_Y, -dir * ENCODER_BASE_SENSITIVITY);
+}
+
+void report_task_init(ReportMode report_mode, EC11_Encoder *encoder_x, EC11_Encoder *encoder_y)
+{
+    mode = report_mode;
+    encoders[0] = encoder_x;
+    encoders[1] = encoder_y;
+    btn_state = 0;
+    event_fn = NULL;
+    event_ctx = NULL;
+    report_reset();
+}
+
+void report_task_set_event_hook(report_event_fn fn, void *ctx)
+{
+    event_fn = fn;
+    event_ctx = ctx;
+}
+
+ReportMode report_task_mode(void)
+{
+    return mode;
+}
+
+uint32_t report_task_buttons(void)
+{
+    return btn_state;
+}
+
+void report_task_drain(void)
+{
+#if LOG_ENABLE
+    static uint32_t logged_dropped;
+    uint32_t dropped = input_get_dropped();
+    if (dropped != logged_dropped)
+    {
+        logged_dropped = dropped;
+        LOG(INPUT_DROPPED, dropped, 0);
+    }
+#endif
+
+    InputEvent event;
+    while (input_poll(&event))
+    {
+        if (event_fn)
+            event_fn(&event, btn_state, event_ctx);
+
+        ec11_push_delta(encoders[0], event.delta_x);
+        ec11_push_delta(encoders[1], event.delta_y);
+
+        if (event.btn_state != btn_state)
+        {
+            btn_state = event.btn_state;
+            if (mode == REPORT_MODE_KEYBOARD)
+                action_process(btn_state, event.timestamp_us);
+        }
+    }
+}
+
+bool report_task_run(void)
+{
+    report_task_drain();
+
+    if (hal_usb_suspended())
+    {
+        if (btn_state)
+            hal_usb_remote_wakeup();
+        return false;
+    }
+
+    if (mode == REPORT_MODE_GAMEPAD)
+        return report_send_gamepad(btn_state);
+
+    // Buttons were already fed to the action engine per input event
+    bool sent = report_send_keyboard();
+    report_send_mouse();
+    return sent;
+}
@@ -0,0 +1,42 @@
+#ifndef REPORT_TASK_H
+#define REPORT_TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/encoder/ec11.h"
+#include "modules/input/input.h"
+
+// The core 0 half of the input pipeline, shared by main.c and the host
+// tools: drains the core 1 input events into the encoders and the action
+// engine, then sends this period's reports for the current mode.
+
+typedef enum
+{
+    REPORT_MODE_KEYBOARD, // Keyboard and mouse; buttons go through the action engine
+    REPORT_MODE_GAMEPAD
+} ReportMode;
+
+// Sees every drained event before it is applied; prev_state is the
+// debounced button state before it
+typedef void (*report_event_fn)(const InputEvent *event, uint32_t prev_state, void *ctx);
+
+// Pass these to ec11_init(); the encoder motion follows the mode
+void report_encoder_x_callback(EC11_Direction dir, void *user_data);
+void report_encoder_y_callback(EC11_Direction dir, void *user_data);
+
+// Clears the button state and the pending reports
+void report_task_init(ReportMode mode, EC11_Encoder *encoder_x, EC11_Encoder *encoder_y);
+void report_task_set_event_hook(report_event_fn fn, void *ctx);
+
+ReportMode report_task_mode(void);
+// Debounced button state after the last drained event
+uint32_t report_task_buttons(void);
+
+// Apply every queued input event in order, with its sample timestamp
+void report_task_drain(void);
+// Drain, then send the reports. While the bus is suspended a held button
+// requests a remote wakeup instead. True if a keyboard or gamepad report
+// was sent.
+bool report_task_run(void);
+
+#endif
@@ -0,0 +1,467 @@
+#include "effects.h"
+#include <string.h>
+#include "modules/profile/profile.h"
+#if WS2812_STRIPS
+#include "ws2812_parallel.h"
+#endif
+
+#define HUE_STEPS 1536 // 6 regions of 256
+
+typedef struct
+{
+    bool active;
+    uint8_t center;
+    RGBColor color;
+    uint64_t start_us;
+} Ripple;
+
+typedef struct
+{
+    bool active;
+    uint16_t pixel;
+    RGBColor color;
+    uint8_t alpha;
+    uint8_t blend;
+} Overlay;
+
+static const uint8_t *button_led_map;
+static uint8_t frame_rgb[NUM_PIXELS][3];
+
+static EffectBase base_effect = EFFECTS_DEFAULT_BASE;
+static bool fade_enabled = true;
+static bool ripple_enabled = true;
+
+// Effect clock, advanced by real time scaled with anim_speed
+static uint64_t effect_us;
+static uint64_t last_clock_us;
+static uint64_t last_frame_us;
+
+static uint32_t btn_state;
+static uint32_t last_sequence;
+static bool force_redraw = true;
+
+static uint32_t fading_mask;
+static uint64_t release_us[BUTTON_COUNT];
+static Ripple ripples[EFFECTS_RIPPLE_SLOTS];
+static Overlay overlays[EFFECTS_OVERLAY_SLOTS];
+
+static EffectsStats stats;
+
+//--------------------------------------------------------------------+
+// Fixed-point helpers
+//--------------------------------------------------------------------+
+
+// a * b / 255, exact at both ends of the range
+static inline uint8_t scale8(uint8_t a, uint8_t b)
+{
+    return (uint8_t)(((uint16_t)a * (uint16_t)(b + 1)) >> 8);
+}
+
+static inline uint8_t qadd8(uint8_t a, uint8_t b)
+{
+    uint16_t sum = (uint16_t)a + b;
+    return sum > 255 ? 255 : (uint8_t)sum;
+}
+
+static inline uint8_t lerp8(uint8_t from, uint8_t to, uint8_t alpha)
+{
+    return (uint8_t)(from + (((int16_t)to - from) * (alpha + 1) >> 8));
+}
+
+// h in [0, HUE_STEPS), s and v in [0, 255]
+static void hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v, uint8_t *rgb)
+{
+    uint8_t region = h >> 8;
+    uint8_t f = h & 0xFF;
+    uint8_t p = scale8(v, 255 - s);
+    uint8_t q = scale8(v, 255 - scale8(s, f));
+    uint8_t t = scale8(v, 255 - scale8(s, 255 - f));
+
+    switch (region)
+    {
+    case 0: rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+    case 1: rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+    case 2: rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+    case 3: rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+    case 4: rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+    default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+    }
+}
+
+static inline void blend_pixel(uint8_t *dst, RGBColor c, uint8_t alpha, EffectBlend blend)
+{
+    if (blend == EFFECT_BLEND_ADD)
+    {
+        dst[0] = qadd8(dst[0], scale8(c.r, alpha));
+        dst[1] = qadd8(dst[1], scale8(c.g, alpha));
+        dst[2] = qadd8(dst[2], scale8(c.b, alpha));
+    }
+    else
+    {
+        dst[0] = lerp8(dst[0], c.r, alpha);
+        dst[1] = lerp8(dst[1], c.g, alpha);
+        dst[2] = lerp8(dst[2], c.b, alpha);
+    }
+}
+
+// 0 -> 255 -> 0 over one period
+static inline uint8_t triangle8(uint32_t phase, uint32_t period)
+{
+    uint32_t x = (phase % period) * 512 / period;
+    return (uint8_t)(x < 256 ? x : 511 - x);
+}
+
+//--------------------------------------------------------------------+
+// Layers
+//--------------------------------------------------------------------+
+
+static void render_base(const RemapConfig *config)
+{
+    switch (base_effect)
+    {
+    case EFFECT_BASE_RAINBOW:
+    {
+        uint32_t period_us = EFFECTS_RAINBOW_PERIOD_MS * 1000u;
+        uint32_t offset = (uint32_t)((effect_us % period_us) * HUE_STEPS / period_us);
+        for (uint i = 0; i < NUM_PIXELS; i++)
+        {
+            uint16_t hue = (offset + i * HUE_STEPS / NUM_PIXELS) % HUE_STEPS;
+            hsv_to_rgb(hue, 255, 255, frame_rgb[i]);
+        }
+        break;
+    }
+    case EFFECT_BASE_BREATHE:
+    {
+        uint8_t level = triangle8((uint32_t)(effect_us / 1000), EFFECTS_BREATHE_PERIOD_MS);
+        level = scale8(level, level); // Roughly perceptual
+        memset(frame_rgb, 0, sizeof(frame_rgb));
+        for (int i = 0; i < BUTTON_COUNT; i++)
+        {
+            uint8_t *px = frame_rgb[button_led_map[i]];
+            px[0] = scale8(config->button_colors[i].r, level);
+            px[1] = scale8(config->button_colors[i].g, level);
+            px[2] = scale8(config->button_colors[i].b, level);
+        }
+        break;
+    }
+    case EFFECT_BASE_OFF:
+    default:
+        memset(frame_rgb, 0, sizeof(frame_rgb));
+        break;
+    }
+}
+
+#if WS2812_STRIPS
+// The strips carry the base animation only, the same on every strip: the
+// rainbow spread along the strip, or the button colors breathing in turn
+static void render_strips(const RemapConfig *config)
+{
+    uint32_t period_us = EFFECTS_RAINBOW_PERIOD_MS * 1000u;
+    uint32_t offset = (uint32_t)((effect_us % period_us) * HUE_STEPS / period_us);
+    uint8_t level = triangle8((uint32_t)(effect_us / 1000), EFFECTS_BREATHE_PERIOD_MS);
+    level = scale8(level, level);
+
+    for (uint i = 0; i < WS2812_STRIP_PIXELS; i++)
+    {
+        uint8_t rgb[3] = {0, 0, 0};
+        if (base_effect == EFFECT_BASE_RAINBOW)
+        {
+            hsv_to_rgb((offset + i * HUE_STEPS / WS2812_STRIP_PIXELS) % HUE_STEPS, 255, 255, rgb);
+        }
+        else if (base_effect == EFFECT_BASE_BREATHE)
+        {
+            RGBColor color = config->button_colors[i % BUTTON_COUNT];
+            rgb[0] = scale8(color.r, level);
+            rgb[1] = scale8(color.g, level);
+            rgb[2] = scale8(color.b, level);
+        }
+
+        uint32_t word = ws2812_encode_grb(rgb[0], rgb[1], rgb[2]);
+        for (uint s = 0; s < WS2812_STRIPS; s++)
+            ws2812_parallel_set_pixel(s, i, word);
+    }
+    ws2812_parallel_present();
+}
+#endif
+
+static void render_reactive(const RemapConfig *config)
+{
+    const uint32_t fade_us = EFFECTS_FADE_MS * 1000u;
+    const uint32_t ripple_us = EFFECTS_RIPPLE_MS * 1000u;
+
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (!(fading_mask & (1u << i)))
+            continue;
+
+        uint32_t elapsed = (uint32_t)(effect_us - release_us[i]);
+        if (elapsed >= fade_us)
+        {
+            fading_mask &= ~(1u << i);
+            continue;
+        }
+        uint8_t alpha = 255 - (uint8_t)((uint64_t)elapsed * 255 / fade_us);
+        blend_pixel(frame_rgb[button_led_map[i]], config->button_colors[i], alpha, EFFECT_BLEND_ALPHA);
+    }
+
+    for (int r = 0; r < EFFECTS_RIPPLE_SLOTS; r++)
+    {
+        Ripple *ripple = &ripples[r];
+        if (!ripple->active)
+            continue;
+
+        uint32_t elapsed = (uint32_t)(effect_us - ripple->start_us);
+        if (elapsed >= ripple_us)
+        {
+            ripple->active = false;
+            continue;
+        }
+
+        // Ring position and strength in 8.8 pixels
+        uint32_t radius_q8 = (uint32_t)((uint64_t)elapsed * (EFFECTS_RIPPLE_RADIUS << 8) / ripple_us);
+        uint8_t strength = 255 - (uint8_t)((uint64_t)elapsed * 255 / ripple_us);
+
+        int lo = (int)ripple->center - EFFECTS_RIPPLE_RADIUS - 1;
+        int hi = (int)ripple->center + EFFECTS_RIPPLE_RADIUS + 1;
+        if (lo < 0)
+            lo = 0;
+        if (hi > NUM_PIXELS - 1)
+            hi = NUM_PIXELS - 1;
+
+        for (int p = lo; p <= hi; p++)
+        {
+            int dist_q8 = (p - (int)ripple->center) * 256;
+            if (dist_q8 < 0)
+                dist_q8 = -dist_q8;
+            int offset = dist_q8 - (int)radius_q8;
+            if (offset < 0)
+                offset = -offset;
+            if (offset >= 256)
+                continue;
+
+            uint8_t weight = scale8(strength, (uint8_t)(255 - offset));
+            blend_pixel(frame_rgb[p], ripple->color, weight, EFFECT_BLEND_ADD);
+        }
+    }
+}
+
+static void render_overlays(void)
+{
+    for (int i = 0; i < EFFECTS_OVERLAY_SLOTS; i++)
+    {
+        const Overlay *ov = &overlays[i];
+        if (ov->active && ov->pixel < NUM_PIXELS)
+        {
+            blend_pixel(frame_rgb[ov->pixel], ov->color, ov->alpha, (EffectBlend)ov->blend);
+        }
+    }
+}
+
+static bool reactive_active(void)
+{
+    if (fading_mask)
+        return true;
+    for (int r = 0; r < EFFECTS_RIPPLE_SLOTS; r++)
+    {
+        if (ripples[r].active)
+            return true;
+    }
+    return false;
+}
+
+static void spawn_ripple(int button, const RemapConfig *config)
+{
+    // Reuse a free slot, otherwise the oldest ripple
+    Ripple *slot = &ripples[0];
+    for (int r = 0; r < EFFECTS_RIPPLE_SLOTS; r++)
+    {
+        if (!ripples[r].active)
+        {
+            slot = &ripples[r];
+            break;
+        }
+        if (ripples[r].start_us < slot->start_us)
+            slot = &ripples[r];
+    }
+
+    slot->active = true;
+    slot->center = button_led_map[button];
+    slot->color = config->button_colors[button];
+    slot->start_us = effect_us;
+}
+
+// Advance the effect clock; anim_speed is a percentage and 0 freezes it.
+// Inputs carry core 0's post time, which can be a little later than the
+// render time core 1 read before popping them, so the clock never steps back.
+static void advance_clock(uint64_t now_us, uint16_t speed)
+{
+    if (now_us <= last_clock_us)
+        return;
+    effect_us += (now_us - last_clock_us) * speed / 100;
+    last_clock_us = now_us;
+}
+
+//--------------------------------------------------------------------+
+// Public API
+//--------------------------------------------------------------------+
+
+void effects_init(const uint8_t *led_map)
+{
+    button_led_map = led_map;
+    memset(ripples, 0, sizeof(ripples));
+    memset(overlays, 0, sizeof(overlays));
+    memset(&stats, 0, sizeof(stats));
+    fading_mask = 0;
+    effect_us = 0;
+    last_clock_us = hal_time_us_64();
+    last_frame_us = 0;
+    force_redraw = true;
+}
+
+void effects_set_base(EffectBase base)
+{
+    if (base < EFFECT_BASE_COUNT && base != base_effect)
+    {
+        base_effect = base;
+        force_redraw = true;
+    }
+}
+
+void effects_set_reactive(bool fade, bool ripple)
+{
+    fade_enabled = fade;
+    ripple_enabled = ripple;
+}
+
+void effects_set_overlay(uint slot, uint pixel, RGBColor color, uint8_t alpha, EffectBlend blend)
+{
+    if (slot >= EFFECTS_OVERLAY_SLOTS)
+        return;
+
+    Overlay *ov = &overlays[slot];
+    if (ov->active && ov->pixel == pixel && ov->alpha == alpha && ov->blend == blend &&
+        memcmp(&ov->color, &color, sizeof(color)) == 0)
+    {
+        return;
+    }
+
+    ov->active = true;
+    ov->pixel = pixel;
+    ov->color = color;
+    ov->alpha = alpha;
+    ov->blend = blend;
+    force_redraw = true;
+}
+
+void effects_clear_overlay(uint slot)
+{
+    if (slot < EFFECTS_OVERLAY_SLOTS && overlays[slot].active)
+    {
+        overlays[slot].active = false;
+        force_redraw = true;
+    }
+}
+
+void effects_input(uint32_t state, uint64_t now_us)
+{
+    uint32_t changed = state ^ btn_state;
+    if (!changed)
+        return;
+
+    const RemapConfig *config = &remap_acquire()->config;
+    uint16_t speed = config->anim_speed;
+    advance_clock(now_us, speed);
+    btn_state = state;
+    force_redraw = true;
+
+    // A speed of 0 also disables the reactive effects
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        uint32_t bit = 1u << i;
+        if (!(changed & bit))
+            continue;
+
+        if (btn_state & bit)
+        {
+            fading_mask &= ~bit;
+            if (ripple_enabled && speed)
+                spawn_ripple(i, config);
+        }
+        else if (fade_enabled && speed)
+        {
+            release_us[i] = effect_us;
+            fading_mask |= bit;
+        }
+    }
+}
+
+void effects_task(uint64_t now_us)
+{
+    uint32_t sequence = remap_get_sequence();
+    bool animating = base_effect != EFFECT_BASE_OFF || reactive_active();
+    bool tick = animating && (now_us - last_frame_us) >= UPDATE_INTERVAL_MS * 1000u;
+
+    if (!tick && !force_redraw && sequence == last_sequence)
+        return;
+
+    PROFILE_BEGIN(EFFECTS);
+    uint32_t start = hal_time_us_32();
+    const RemapSnapshot *snapshot = remap_acquire();
+    const RemapConfig *config = &snapshot->config;
+
+    advance_clock(now_us, config->anim_speed);
+    last_frame_us = now_us;
+    last_sequence = sequence;
+    force_redraw = false;
+
+    render_base(config);
+
+    bool overrun = (hal_time_us_32() - start) >= EFFECTS_FRAME_BUDGET_US;
+    if (!overrun)
+    {
+        render_reactive(config);
+    }
+    render_overlays();
+
+    ws2812_begin_frame();
+    ws2812_encode_frame(0, frame_rgb[0], NUM_PIXELS);
+
+    // Held buttons show their exact config color on top of everything
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (btn_state & (1u << i))
+        {
+#if WS2812_DITHER
+            // Through the 8.8 tables like every other pixel, so the held
+            // colors keep their fraction instead of the quantized word
+            RGBColor color = config->button_colors[i];
+            set_button_color(button_led_map[i], color.r, color.g, color.b);
+#else
+            set_button_word(button_led_map[i], snapshot->tables.led_words[i]);
+#endif
+        }
+    }
+    ws2812_present();
+#if WS2812_STRIPS
+    render_strips(config);
+#endif
+    PROFILE_END(EFFECTS);
+
+    uint32_t elapsed = hal_time_us_32() - start;
+    stats.frames++;
+    stats.last_render_us = elapsed;
+    if (elapsed > stats.max_render_us)
+        stats.max_render_us = elapsed;
+    if (overrun || elapsed > EFFECTS_FRAME_BUDGET_US)
+        stats.overruns++;
+}
+
+void effects_invalidate(void)
+{
+    force_redraw = true;
+}
+
+void effects_get_stats(EffectsStats *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,97 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/remap/remap.h"
+#include "ws2812.h"
+
+// Layered LED effect engine. Each frame is composed in an 8-bit RGB working
+// buffer from bottom to top:
+//   1. base animation (off, rainbow, breathe)
+//   2. reactive layer: fade-out after release and ripples spawned on press
+//   3. status overlays (opaque or alpha-blended single pixels)
+// and then encoded once through the ws2812 channel tables. Held buttons are
+// drawn last with their pre-encoded config colors.
+// All math is fixed point; effect time runs at RemapConfig.anim_speed percent.
+// The base animation and the reactive layers are chosen per config (remap
+// command 0x09); led_render applies them whenever the config changes.
+// Boards with parallel strips (WS2812_STRIPS) get the base animation on
+// those too.
+
+// Base animation of a default config
+#ifndef EFFECTS_DEFAULT_BASE
+#define EFFECTS_DEFAULT_BASE EFFECT_BASE_OFF
+#endif
+
+// Render budget per frame. If the base layer has already used it up, the
+// reactive layer is dropped for that frame so LED work never holds up input.
+#ifndef EFFECTS_FRAME_BUDGET_US
+#define EFFECTS_FRAME_BUDGET_US 500
+#endif
+
+// Durations at anim_speed 100
+#ifndef EFFECTS_FADE_MS
+#define EFFECTS_FADE_MS 300
+#endif
+#ifndef EFFECTS_RIPPLE_MS
+#define EFFECTS_RIPPLE_MS 400
+#endif
+#ifndef EFFECTS_RIPPLE_RADIUS
+#define EFFECTS_RIPPLE_RADIUS 3
+#endif
+#ifndef EFFECTS_RAINBOW_PERIOD_MS
+#define EFFECTS_RAINBOW_PERIOD_MS 4000
+#endif
+#ifndef EFFECTS_BREATHE_PERIOD_MS
+#define EFFECTS_BREATHE_PERIOD_MS 3000
+#endif
+
+#define EFFECTS_RIPPLE_SLOTS 8
+#define EFFECTS_OVERLAY_SLOTS 4
+
+typedef enum
+{
+    EFFECT_BASE_OFF,
+    EFFECT_BASE_RAINBOW,
+    EFFECT_BASE_BREATHE,
+    EFFECT_BASE_COUNT
+} EffectBase;
+
+typedef enum
+{
+    EFFECT_BLEND_ALPHA,
+    EFFECT_BLEND_ADD
+} EffectBlend;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t overruns;       // Frames that hit the budget and dropped layers
+    uint32_t last_render_us;
+    uint32_t max_render_us;
+} EffectsStats;
+
+// led_map[i] is the pixel index of button i
+void effects_init(const uint8_t *led_map);
+void effects_set_base(EffectBase base);
+void effects_set_reactive(bool fade, bool ripple);
+
+// Status overlays sit above the animation but below held buttons
+void effects_set_overlay(uint slot, uint pixel, RGBColor color, uint8_t alpha, EffectBlend blend);
+void effects_clear_overlay(uint slot);
+
+// Feed the button state; presses spawn ripples and releases start fades.
+// Every change should be fed, even if several arrive before the next frame.
+void effects_input(uint32_t btn_state, uint64_t now_us);
+
+// Call every loop iteration. Renders and presents a frame only when the
+// animation ticked, a button changed or the config was republished.
+void effects_task(uint64_t now_us);
+
+// Force a full redraw, e.g. after something else drew to the strip
+void effects_invalidate(void);
+
+void effects_get_stats(EffectsStats *stats);
+
+#endif
@@ -0,0 +1,161 @@
+#include "led_render.h"
+#include "modules/spsc/spsc.h"
+#include "ws2812.h"
+#include "effects.h"
+#include "led_stream.h"
+#if WS2812_STRIPS
+#include "ws2812_parallel.h"
+#if WS2812_STRIP_PIXELS > WS2812_PARALLEL_MAX_PIXELS
+#error "WS2812_STRIP_PIXELS exceeds WS2812_PARALLEL_MAX_PIXELS"
+#endif
+#endif
+#include "modules/sched/sched.h"
+#include "modules/be/be.h"
+#include <string.h>
+
+static SpscRing input_ring;
+static LedInput input_storage[LED_RENDER_QUEUE_SIZE];
+static SpscRing stream_ring;
+static LedStreamReport stream_storage[LED_STREAM_QUEUE_SIZE];
+
+static const uint8_t *button_led_map;
+static uint status_led;
+static uint32_t luts_sequence; // Config the ws2812 tables were taken from
+
+// Producer state, core 0 only
+static uint32_t posted_btn_state;
+static uint8_t posted_layer;
+
+// Tint the status LED while a non-base action layer is active
+static void update_status_overlay(uint8_t layer)
+{
+    static const RGBColor layer_colors[ACTION_LAYER_COUNT] = {
+        {0, 0, 0}, {0, 160, 255}, {255, 160, 0}, {160, 0, 255}};
+
+    if (layer == 0 || layer >= ACTION_LAYER_COUNT)
+    {
+        effects_clear_overlay(0);
+        return;
+    }
+    effects_set_overlay(0, status_led, layer_colors[layer], 160, EFFECT_BLEND_ALPHA);
+}
+
+static void render_task(void *ctx)
+{
+    (void)ctx;
+
+    // Nothing on core 1 holds a config snapshot between frames; the ws2812
+    // tables are copied out of it
+    remap_quiescent();
+    const RemapSnapshot *snapshot = remap_acquire();
+    if (snapshot->sequence != luts_sequence)
+    {
+        ws2812_use_luts(&snapshot->tables.luts);
+        effects_set_base((EffectBase)snapshot->effects.base);
+        effects_set_reactive(snapshot->effects.reactive & REMAP_EFFECT_FADE,
+                             snapshot->effects.reactive & REMAP_EFFECT_RIPPLE);
+        luts_sequence = snapshot->sequence;
+    }
+
+    // Feed every queued change so short taps still get their effects
+    LedInput input;
+    while (spsc_pop(&input_ring, &input))
+    {
+        effects_input(input.btn_state, input.timestamp_us);
+        update_status_overlay(input.layer);
+    }
+
+    uint64_t now = hal_time_us_64();
+    LedStreamReport report;
+    while (spsc_pop(&stream_ring, &report))
+    {
+        led_stream_process(report.data, report.len, now);
+    }
+
+    // A live host stream owns the strip; effects resume when it stops
+    if (!led_stream_active(now))
+    {
+        effects_task(now);
+    }
+}
+
+#if WS2812_DITHER
+static void dither_task(void *ctx)
+{
+    (void)ctx;
+    ws2812_dither_task();
+}
+#endif
+
+void led_render_init(const uint8_t *led_map, uint status_pixel)
+{
+    button_led_map = led_map;
+    status_led = status_pixel;
+    spsc_init(&input_ring, input_storage, sizeof(LedInput), LED_RENDER_QUEUE_SIZE);
+    spsc_init(&stream_ring, stream_storage, sizeof(LedStreamReport), LED_STREAM_QUEUE_SIZE);
+}
+
+void led_render_start(Scheduler *sched)
+{
+    // IRQ handlers and the latch alarm pool attach to the calling core
+    ws2812_init();
+#if WS2812_STRIPS
+    ws2812_parallel_init(WS2812_STRIPS_PIN_BASE, WS2812_STRIPS, WS2812_STRIP_PIXELS, ws2812_get_latch_pool());
+#endif
+    effects_init(button_led_map);
+
+#if WS2812_DITHER
+    // The pacer keeps the steadiest timing
+    sched_add(sched, "dither", dither_task, NULL, WS2812_DITHER_PERIOD_US, 0);
+#endif
+    sched_add(sched, "render", render_task, NULL, LED_RENDER_PERIOD_US, 1);
+}
+
+void led_render_post(uint32_t btn_state, uint8_t layer)
+{
+    if (btn_state == posted_btn_state && layer == posted_layer)
+        return;
+
+    LedInput input = {
+        .btn_state = btn_state,
+        .layer = layer,
+        .timestamp_us = hal_time_us_64()};
+
+    // On a full ring the change is retried on the next call
+    if (spsc_push(&input_ring, &input))
+    {
+        posted_btn_state = btn_state;
+        posted_layer = layer;
+    }
+}
+
+void led_render_post_stream(const uint8_t *report, uint16_t len)
+{
+    LedStreamReport msg;
+    msg.len = len < sizeof(msg.data) ? len : sizeof(msg.data);
+    memcpy(msg.data, report, msg.len);
+    spsc_push(&stream_ring, &msg);
+}
+
+size_t led_render_write_report(uint8_t *buffer, size_t max_len)
+{
+    const size_t len = 3 + 6 * 4;
+    if (max_len < len)
+        return 0;
+
+    const RemapEffects *selected = &remap_acquire()->effects;
+    EffectsStats stats;
+    effects_get_stats(&stats);
+
+    uint8_t *p = buffer;
+    *p++ = LED_STATUS_COMMAND;
+    *p++ = selected->base;
+    *p++ = selected->reactive;
+    p = put_be32(p, stats.frames);
+    p = put_be32(p, stats.overruns);
+    p = put_be32(p, stats.last_render_us);
+    p = put_be32(p, stats.max_render_us);
+    p = put_be32(p, input_ring.dropped);
+    p = put_be32(p, stream_ring.dropped);
+    return len;
+}
@@ -0,0 +1,63 @@
+#ifndef LED_RENDER_H
+#define LED_RENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "modules/hal/hal.h"
+#include "modules/sched/sched.h"
+
+// LED rendering on core 1. Core 1 owns the WS2812 PIO/DMA, its IRQ and the
+// latch alarm, and runs the effect engine as scheduler tasks. Core 0 only posts input state
+// through a lock-free SPSC ring, so a heavy effect can never delay input,
+// USB or report handling. Config reaches core 1 through the remap snapshots.
+//
+// Raw HID 0x89 -> [0x89, effect base, reactive flags; effect frames,
+//                  overruns, last and max render time in us, input posts
+//                  deferred and stream reports dropped on a full queue
+//                  (BE32)]
+
+#define LED_STATUS_COMMAND 0x89
+
+#ifndef LED_RENDER_QUEUE_SIZE
+#define LED_RENDER_QUEUE_SIZE 16 // Power of two
+#endif
+
+// How often core 1 drains its queues and checks for a due effect frame
+#ifndef LED_RENDER_PERIOD_US
+#define LED_RENDER_PERIOD_US 500
+#endif
+
+#ifndef LED_STREAM_QUEUE_SIZE
+#define LED_STREAM_QUEUE_SIZE 16 // Power of two
+#endif
+
+typedef struct
+{
+    uint32_t btn_state;
+    uint8_t layer;
+    uint64_t timestamp_us;
+} LedInput;
+
+typedef struct
+{
+    uint16_t len;
+    uint8_t data[64];
+} LedStreamReport;
+
+// Core 0, before core 1 starts. status_pixel shows the active action layer.
+void led_render_init(const uint8_t *led_map, uint status_pixel);
+
+// Core 1: set up the strip and effects and add the render tasks. The render
+// task takes the ws2812 output tables from the current config snapshot.
+void led_render_start(Scheduler *sched);
+
+// Core 0: post the current input state; only changes are queued
+void led_render_post(uint32_t btn_state, uint8_t layer);
+
+// Core 0: forward a raw HID lighting stream report (0x20-0x2F) to core 1
+void led_render_post_stream(const uint8_t *report, uint16_t len);
+
+// Core 0: the 0x89 reply; the stats are read while core 1 updates them
+size_t led_render_write_report(uint8_t *buffer, size_t max_len);
+
+#endif
@@ -0,0 +1,126 @@
+#include "led_stream.h"
+#include "ws2812.h"
+#include "effects.h"
+
+static bool active = false;
+static bool in_frame = false;
+static uint64_t last_report_us;
+
+// Pixels changed by the frame being received and by the last committed one,
+// relative to the frame in the front buffer
+static uint span_lo, span_hi;
+static uint prev_lo, prev_hi;
+
+static void begin_frame(bool full)
+{
+    // A repeated BEGIN continues the open delta frame, so nothing written
+    // so far drops out of its span
+    if (in_frame && !full)
+        return;
+
+    if (!active)
+    {
+        // The strip still shows an effects frame; treat all of it as changed
+        active = true;
+        prev_lo = 0;
+        prev_hi = NUM_PIXELS;
+    }
+
+    if (full)
+    {
+        ws2812_begin_frame();
+        clear_pixels();
+        span_lo = 0;
+        span_hi = NUM_PIXELS;
+    }
+    else if (ws2812_begin_frame_delta(prev_lo, prev_hi - prev_lo))
+    {
+        // The last frame was never sent; its changes are part of this one
+        span_lo = prev_lo;
+        span_hi = prev_hi;
+    }
+    else
+    {
+        span_lo = NUM_PIXELS;
+        span_hi = 0;
+    }
+    in_frame = true;
+}
+
+static void stop_stream(void)
+{
+    active = false;
+    in_frame = false;
+    effects_invalidate();
+}
+
+void led_stream_process(const uint8_t *report, uint16_t len, uint64_t now_us)
+{
+    if (len < 1)
+        return;
+    last_report_us = now_us;
+
+    switch (report[0])
+    {
+    case STREAM_CMD_BEGIN:
+        begin_frame(len >= 2 && (report[1] & STREAM_FLAG_FULL));
+        break;
+
+    case STREAM_CMD_PIXELS:
+    {
+        if (len < 4)
+            break;
+        uint offset = (report[1] << 8) | report[2];
+        uint count = report[3];
+        if (count > (uint)(len - 4) / 3)
+            count = (len - 4) / 3;
+        if (offset >= NUM_PIXELS || count == 0)
+            break;
+        if (count > NUM_PIXELS - offset)
+            count = NUM_PIXELS - offset;
+
+        if (!in_frame)
+            begin_frame(false);
+
+        ws2812_encode_frame(offset, report + 4, count);
+        if (offset < span_lo)
+            span_lo = offset;
+        if (offset + count > span_hi)
+            span_hi = offset + count;
+        break;
+    }
+
+    case STREAM_CMD_COMMIT:
+        if (!in_frame)
+            break;
+        ws2812_present();
+        in_frame = false;
+        if (span_lo < span_hi)
+        {
+            prev_lo = span_lo;
+            prev_hi = span_hi;
+        }
+        else
+        {
+            prev_lo = prev_hi = 0;
+        }
+        break;
+
+    case STREAM_CMD_STOP:
+        if (active)
+            stop_stream();
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool led_stream_active(uint64_t now_us)
+{
+    if (active && now_us - last_report_us > LED_STREAM_TIMEOUT_MS * 1000ull)
+    {
+        stop_stream();
+    }
+    return active;
+}
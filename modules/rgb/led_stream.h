@@ -0,0 +1,45 @@
+#ifndef LED_STREAM_H
+#define LED_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host-streamed LED frames over raw HID. Reports are forwarded to core 1
+// unchanged and decoded there straight into the back framebuffer. Nothing
+// is saved to flash and no reply is sent, so a host can push frames as
+// fast as the endpoint allows. Reports that find the core 1 queue full are
+// dropped and counted in the raw HID 0x89 reply (led_render.h).
+//
+//   0x20 BEGIN   flags                       start a frame
+//   0x21 PIXELS  offset(BE16) count rgb...   up to 20 pixels per report
+//   0x22 COMMIT                              present the frame
+//   0x23 STOP                                hand the LEDs back to the effects
+//
+// Without STREAM_FLAG_FULL, a frame only replaces the pixels it sends and
+// keeps the rest of the previous frame. A PIXELS report without a BEGIN
+// starts such a delta frame. If no report arrives for LED_STREAM_TIMEOUT_MS,
+// the effect engine takes over again.
+
+#define STREAM_CMD_FIRST 0x20
+#define STREAM_CMD_LAST 0x2F
+#define STREAM_CMD_BEGIN 0x20
+#define STREAM_CMD_PIXELS 0x21
+#define STREAM_CMD_COMMIT 0x22
+#define STREAM_CMD_STOP 0x23
+
+#define STREAM_FLAG_FULL 0x01 // Start from a black frame
+
+#ifndef LED_STREAM_TIMEOUT_MS
+#define LED_STREAM_TIMEOUT_MS 500
+#endif
+
+static inline bool led_stream_is_command(uint8_t cmd)
+{
+    return cmd >= STREAM_CMD_FIRST && cmd <= STREAM_CMD_LAST;
+}
+
+// Core 1 only
+void led_stream_process(const uint8_t *report, uint16_t len, uint64_t now_us);
+bool led_stream_active(uint64_t now_us);
+
+#endif
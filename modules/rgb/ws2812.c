@@ -1,174 +1,494 @@
 #include "ws2812.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include "modules/profile/profile.h"
+#include "modules/trace/trace.h"
 
 
 
-static PIO pio;
-static uint sm;
-static uint offset;
-static uint32_t pixel_buffer[NUM_PIXELS];
-static uint32_t dma_buffer[NUM_PIXELS];
-static int dma_chan;
-static dma_state_t dma_state = DMA_IDLE;
-static uint32_t last_update_time = 0;
-static float current_brightness = 1.0f;
+static hal_pio_sm_t pio_sm;
+static uint dma_chan;
+static volatile dma_state_t dma_state = DMA_IDLE;
 
-void __isr dma_complete_handler(void)
+// Output tables in use, copied in by ws2812_use_luts(). Two copies, so the
+// tables a compact frame in flight was started with (frame_luts) are never
+// the ones being overwritten.
+static ws2812_luts_t lut_buffers[2];
+static ws2812_luts_t *luts = &lut_buffers[0];
+static const ws2812_luts_t *frame_luts = &lut_buffers[0];
+
+// Front/back frames: the renderer fills the back buffer while the DMA reads
+// the front one, and presenting a frame is a pointer swap instead of a copy.
+static ws2812_pixel_t frame_buffers[2][NUM_PIXELS];
+static ws2812_pixel_t *pixel_buffer = frame_buffers[0];
+static ws2812_pixel_t *dma_buffer = frame_buffers[1];
+static volatile bool frame_pending = false; // Presented, waiting for the DMA to finish
+static volatile bool frame_ready = false;   // Swapped to the front, not yet sent
+static hal_lock_t *frame_lock;
+
+// Alarm pool created on the core that calls ws2812_init(), so the latch
+// callback runs on the same core as the DMA IRQ
+static hal_alarm_pool_t *latch_pool;
+
+#if WS2812_DITHER
+// Per-pixel 8.8 target and error state, stored r, g, b
+static uint16_t dither_target[NUM_PIXELS][3];
+static uint8_t dither_error[NUM_PIXELS][3];
+static bool dither_dirty = false;    // A new frame was presented
+static uint16_t dither_fraction = 0; // OR of the fractional bytes in the frame
+#endif
+
+#if WS2812_COMPACT
+// Ping-pong staging for the expanded words. The IRQ queues one chunk and
+// expands the next while it is being sent.
+static uint32_t chunk_words[2][WS2812_CHUNK_PIXELS];
+static uint chunk_pos;   // Next pixel of dma_buffer to expand
+static uint chunk_ready; // Pixels waiting in chunk_words[chunk_next]
+static uint chunk_next;
+#endif
+
+#if WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+static uint8_t palette[256][3];
+#endif
+
+// Caller holds frame_lock
+static void HAL_RAM_FUNC(swap_if_pending)(void)
 {
-    if (dma_channel_get_irq0_status(dma_chan))
+    if (frame_pending)
     {
-        dma_channel_acknowledge_irq0(dma_chan);
-        dma_state = DMA_COMPLETE;
+        ws2812_pixel_t *front = pixel_buffer;
+        pixel_buffer = dma_buffer;
+        dma_buffer = front;
+        frame_pending = false;
+        frame_ready = true;
     }
 }
 
-void ws2812_init(void)
+void ws2812_build_luts(ws2812_luts_t *out, float brightness, uint8_t cal_r, uint8_t cal_g, uint8_t cal_b)
 {
+    const uint8_t calibration[3] = {cal_r, cal_g, cal_b};
 
-    bool success = pio_claim_free_sm_and_add_program_for_gpio_range(
-        &ws2812_program, &pio, &sm, &offset, WS2812_PIN, 1, true);
-    hard_assert(success);
+    brightness = (brightness < 0.0f) ? 0.0f : (brightness > 1.0f) ? 1.0f
+                                                                  : brightness;
+    for (int v = 0; v < 256; v++)
+    {
+        float level = v / 255.0f;
+        if (WS2812_GAMMA != 1.0f)
+        {
+            level = powf(level, WS2812_GAMMA);
+        }
+        level *= brightness;
 
-    ws2812_program_init(pio, sm, offset, WS2812_PIN, 800000, false);
+        for (int ch = 0; ch < 3; ch++)
+        {
+            out->channel[ch][v] = (uint8_t)(level * calibration[ch] + 0.5f);
+#if WS2812_DITHER
+            out->channel16[ch][v] = (uint16_t)(level * calibration[ch] * 256.0f + 0.5f);
+#endif
+        }
+    }
 
-    clear_pixels();
+#if WS2812_FORMAT == WS2812_FORMAT_RGB565
+    for (int v = 0; v < 64; v++)
+    {
+        out->g6[v] = out->channel[1][(v << 2) | (v >> 4)];
+        if (v < 32)
+        {
+            out->r5[v] = out->channel[0][(v << 3) | (v >> 2)];
+            out->b5[v] = out->channel[2][(v << 3) | (v >> 2)];
+        }
+    }
+#endif
+}
 
-    dma_chan = dma_claim_unused_channel(true);
-    dma_channel_config c = dma_channel_get_default_config(dma_chan);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
-    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+static inline uint32_t adjusted_rgb_to_grb(const ws2812_luts_t *tables, uint8_t r, uint8_t g, uint8_t b)
+{
+    // 应用亮度调整 (查表)
+    return ((uint32_t)tables->channel[1][g] << 24) |
+           ((uint32_t)tables->channel[0][r] << 16) |
+           ((uint32_t)tables->channel[2][b] << 8);
+}
 
-    dma_channel_configure(
-        dma_chan,
-        &c,
-        &pio->txf[sm],
-        dma_buffer,
-        NUM_PIXELS,
-        false
-    );
+static inline ws2812_pixel_t pack_pixel(const ws2812_luts_t *tables, uint8_t r, uint8_t g, uint8_t b)
+{
+#if WS2812_FORMAT == WS2812_FORMAT_RGB565
+    (void)tables;
+    return (ws2812_pixel_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+#elif WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+    (void)tables;
+    return (ws2812_pixel_t)((r & 0xE0) | ((g & 0xE0) >> 3) | (b >> 6));
+#else
+    return adjusted_rgb_to_grb(tables, r, g, b);
+#endif
+}
 
-    dma_channel_set_irq0_enabled(dma_chan, true);
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_complete_handler);
-    irq_set_enabled(DMA_IRQ_0, true);
+#if WS2812_DITHER
+static inline void dither_set(uint index, uint16_t r, uint16_t g, uint16_t b)
+{
+    dither_target[index][0] = r;
+    dither_target[index][1] = g;
+    dither_target[index][2] = b;
+    dither_fraction |= (r | g | b) & 0xFF;
 }
 
-void ws2812_cleanup(void)
+static inline void dither_set_rgb(uint index, uint8_t r, uint8_t g, uint8_t b)
 {
-    dma_channel_unclaim(dma_chan);
-    pio_remove_program_and_unclaim_sm(&ws2812_program, pio, sm, offset);
+    dither_set(index, luts->channel16[0][r], luts->channel16[1][g], luts->channel16[2][b]);
 }
+#endif
 
-uint32_t *ws2812_get_buffer(void)
+#if WS2812_COMPACT
+static inline uint32_t expand_pixel(ws2812_pixel_t p)
 {
-    return pixel_buffer;
+#if WS2812_FORMAT == WS2812_FORMAT_RGB565
+    return ((uint32_t)frame_luts->g6[(p >> 5) & 0x3F] << 24) |
+           ((uint32_t)frame_luts->r5[p >> 11] << 16) |
+           ((uint32_t)frame_luts->b5[p & 0x1F] << 8);
+#else
+    return adjusted_rgb_to_grb(frame_luts, palette[p][0], palette[p][1], palette[p][2]);
+#endif
+}
+
+// Expand the next chunk of the front buffer into chunk_words[chunk_next]
+static void HAL_RAM_FUNC(expand_next_chunk)(void)
+{
+    uint count = NUM_PIXELS - chunk_pos;
+    if (count > WS2812_CHUNK_PIXELS)
+        count = WS2812_CHUNK_PIXELS;
+
+    uint32_t *dst = chunk_words[chunk_next];
+    const ws2812_pixel_t *src = dma_buffer + chunk_pos;
+    for (uint i = 0; i < count; i++)
+    {
+        dst[i] = expand_pixel(src[i]);
+    }
+    chunk_pos += count;
+    chunk_ready = count;
+}
+
+// Send the expanded chunk and expand the one after it; false at end of frame
+static bool HAL_RAM_FUNC(send_next_chunk)(void)
+{
+    if (chunk_ready == 0)
+        return false;
+
+    TRACE_EVENT(LED_DMA_START, dma_chan, chunk_ready);
+    hal_dma_stream_start(dma_chan, chunk_words[chunk_next], chunk_ready);
+
+    chunk_next ^= 1;
+    expand_next_chunk();
+    return true;
 }
+#endif
 
-void ws2812_update_buffer(void)
+// Caller holds frame_lock; DMA is not running
+static void HAL_RAM_FUNC(start_frame_dma)(void)
 {
-    memcpy(dma_buffer, pixel_buffer, NUM_PIXELS * sizeof(uint32_t));
+#if WS2812_COMPACT
+    // The whole frame expands with the tables current at its start
+    frame_luts = luts;
+    chunk_pos = 0;
+    chunk_next = 0;
+    expand_next_chunk();
+    send_next_chunk();
+#else
+    TRACE_EVENT(LED_DMA_START, dma_chan, NUM_PIXELS);
+    hal_dma_stream_start(dma_chan, dma_buffer, NUM_PIXELS);
+#endif
 }
 
-void ws2812_start_transfer(void)
+// Caller holds frame_lock; the strip has latched the previous frame
+static void HAL_RAM_FUNC(start_dma_if_ready)(void)
 {
-    if (dma_state != DMA_IDLE)
+    swap_if_pending();
+    if (frame_ready)
+    {
+        frame_ready = false;
+        dma_state = DMA_TRANSFERRING;
+        start_frame_dma();
+    }
+    else
+    {
+        dma_state = DMA_IDLE;
+    }
+}
+
+// Fires once the last pixel has left the PIO and the reset gap has elapsed
+static int64_t HAL_RAM_FUNC(latch_complete_callback)(hal_alarm_id_t id, void *user_data)
+{
+    (void)id;
+    (void)user_data;
+
+    hal_lock_enter_isr(frame_lock);
+    start_dma_if_ready();
+    hal_lock_exit_isr(frame_lock);
+    return 0;
+}
+
+// DMA IRQ, once per transfer. Stays in flash: the end of a frame queues the
+// latch alarm through the SDK's alarm pool, which runs from flash anyway.
+static void dma_complete_handler(uint chan)
+{
+    (void)chan;
+    TRACE_EVENT(LED_DMA_DONE, chan, 0);
+
+#if WS2812_COMPACT
+    // Mid-frame: queue the next expanded chunk
+    if (send_next_chunk())
         return;
+#endif
 
-    while (!pio_sm_is_tx_fifo_empty(pio, sm))
+    // The DMA finishes when the last word enters the FIFO; the PIO still
+    // has to shift out what is queued (plus the word in the OSR) before
+    // the reset gap starts.
+    uint queued = hal_pio_tx_level(&pio_sm) + 1;
+    uint32_t latch_us = queued * WS2812_WORD_US + WS2812_RESET_US;
+
+    hal_lock_enter_isr(frame_lock);
+    dma_state = DMA_COMPLETE;
+    hal_lock_exit_isr(frame_lock);
+
+    if (!hal_timeout_add(latch_pool, latch_us, latch_complete_callback, NULL))
+    {
+        // No free alarm slot: fall back to the next present() starting it
+        hal_lock_enter_isr(frame_lock);
+        dma_state = DMA_IDLE;
+        hal_lock_exit_isr(frame_lock);
+    }
+}
+
+void ws2812_init(void)
+{
+    bool success = hal_pio_ws2812_init(&pio_sm, WS2812_PIN, 800000);
+    hal_assert(success);
+
+    frame_lock = hal_lock_claim();
+    latch_pool = hal_alarm_pool_create(WS2812_LATCH_ALARMS);
+#if WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+    // Default RGB332 palette
+    for (int i = 0; i < 256; i++)
     {
-        tight_loop_contents();
+        palette[i][0] = (uint8_t)((i >> 5) * 255 / 7);
+        palette[i][1] = (uint8_t)(((i >> 2) & 7) * 255 / 7);
+        palette[i][2] = (uint8_t)((i & 3) * 255 / 3);
     }
+#endif
+    ws2812_build_luts(luts, 1.0f, WS2812_CALIBRATION_R, WS2812_CALIBRATION_G, WS2812_CALIBRATION_B);
+    clear_pixels();
 
-    dma_channel_set_read_addr(dma_chan, dma_buffer, true);
-    dma_state = DMA_TRANSFERRING;
+    dma_chan = hal_dma_stream_claim(&pio_sm, dma_complete_handler);
 }
 
-bool ws2812_is_busy(void)
+void ws2812_cleanup(void)
 {
-    return dma_state != DMA_IDLE;
+    hal_dma_stream_release(dma_chan);
+    hal_pio_ws2812_deinit(&pio_sm);
 }
 
-dma_state_t ws2812_get_dma_state(void)
+ws2812_pixel_t *ws2812_get_buffer(void)
 {
-    return dma_state;
+    return pixel_buffer;
 }
 
-void ws2812_update_state(void)
+// Returns true if the back buffer still held the latest presented frame
+static bool take_back_buffer(void)
 {
-    if (dma_state == DMA_COMPLETE)
+    // Take the back buffer back from a presented but unsent frame; the new
+    // frame replaces it
+    uint32_t save = hal_lock_enter(frame_lock);
+    bool was_pending = frame_pending;
+    frame_pending = false;
+    hal_lock_exit(frame_lock, save);
+    return was_pending;
+}
+
+static void queue_back_buffer(void)
+{
+    uint32_t save = hal_lock_enter(frame_lock);
+    frame_pending = true;
+    if (dma_state == DMA_IDLE)
     {
-        dma_state = DMA_IDLE;
+        // Idle means the previous frame has latched: send right away
+        start_dma_if_ready();
     }
+    hal_lock_exit(frame_lock, save);
+}
+
+// The renderer must redraw every pixel
+ws2812_pixel_t *ws2812_begin_frame(void)
+{
+#if WS2812_DITHER
+    dither_fraction = 0;
+#else
+    take_back_buffer();
+#endif
+    return pixel_buffer;
 }
 
-static uint32_t adjusted_rgb_to_grb(uint8_t r, uint8_t g, uint8_t b)
+bool ws2812_begin_frame_delta(uint start, uint count)
 {
-    // 应用亮度调整
-    r = (uint8_t)(r * current_brightness);
-    g = (uint8_t)(g * current_brightness);
-    b = (uint8_t)(b * current_brightness);
+#if WS2812_DITHER
+    // Single target buffer: always holds the latest frame
+    (void)start;
+    (void)count;
+    return true;
+#else
+    if (take_back_buffer())
+        return true;
 
-    return (((uint32_t)g << 16) | ((uint32_t)r << 8) | b) << 8;
+    // After a swap the back buffer is one frame behind the front; bring the
+    // span the front frame changed up to date
+    if (start < NUM_PIXELS)
+    {
+        if (count > NUM_PIXELS - start)
+            count = NUM_PIXELS - start;
+        memcpy(pixel_buffer + start, dma_buffer + start, count * sizeof(ws2812_pixel_t));
+    }
+    return false;
+#endif
 }
 
-void set_button_color(uint index, uint8_t r, uint8_t g, uint8_t b)
+void ws2812_present(void)
 {
-    if (index < NUM_PIXELS)
+#if WS2812_DITHER
+    dither_dirty = true;
+#else
+    queue_back_buffer();
+#endif
+}
+
+#if WS2812_DITHER
+void ws2812_dither_task(void)
+{
+    // Fully integer frames need no refresh once sent
+    if (!dither_dirty && !dither_fraction)
+        return;
+    dither_dirty = false;
+    PROFILE_BEGIN(DITHER);
+
+    take_back_buffer();
+    for (uint i = 0; i < NUM_PIXELS; i++)
     {
-        pixel_buffer[index] = adjusted_rgb_to_grb(r, g, b);
+        uint16_t *target = dither_target[i];
+        uint8_t *error = dither_error[i];
+
+        // Integer part goes out, the remainder carries into the next frame
+        uint16_t r = target[0] + error[0];
+        uint16_t g = target[1] + error[1];
+        uint16_t b = target[2] + error[2];
+        error[0] = r & 0xFF;
+        error[1] = g & 0xFF;
+        error[2] = b & 0xFF;
+
+        pixel_buffer[i] = ((uint32_t)(g >> 8) << 24) | ((uint32_t)(r >> 8) << 16) | ((uint32_t)(b >> 8) << 8);
     }
+    queue_back_buffer();
+    PROFILE_END(DITHER);
 }
+#endif
 
-void ws2812_set_brightness(float brightness)
+bool ws2812_is_busy(void)
 {
-    current_brightness = (brightness < 0.0f) ? 0.0f : (brightness > 1.0f) ? 1.0f
-                                                                          : brightness;
+    return dma_state != DMA_IDLE;
 }
 
-void clear_pixels(void)
+dma_state_t ws2812_get_dma_state(void)
 {
-    memset(pixel_buffer, 0, NUM_PIXELS * sizeof(uint32_t));
+    return dma_state;
 }
 
+hal_alarm_pool_t *ws2812_get_latch_pool(void)
+{
+    return latch_pool;
+}
 
+void set_button_color(uint index, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (index < NUM_PIXELS)
+    {
+#if WS2812_DITHER
+        dither_set_rgb(index, r, g, b);
+#else
+        pixel_buffer[index] = pack_pixel(luts, r, g, b);
+#endif
+    }
+}
 
-void pattern_rainbow(uint t)
+void set_button_word(uint index, uint32_t pixel)
 {
-    for (uint i = 0; i < NUM_PIXELS; ++i)
+    if (index < NUM_PIXELS)
     {
-        uint8_t r, g, b;
-        uint16_t hue = (t + i * 256 / NUM_PIXELS) % 256;
+#if WS2812_DITHER
+        // Pre-encoded words are already quantized; no fraction to carry
+        dither_set(index, (pixel >> 8) & 0xFF00, (pixel >> 16) & 0xFF00, pixel & 0xFF00);
+#else
+        pixel_buffer[index] = (ws2812_pixel_t)pixel;
+#endif
+    }
+}
 
-        if (hue < 85)
-        {
-            r = 255 - hue * 3;
-            g = hue * 3;
-            b = 0;
-        }
-        else if (hue < 170)
-        {
-            hue -= 85;
-            r = 0;
-            g = 255 - hue * 3;
-            b = hue * 3;
-        }
-        else
-        {
-            hue -= 170;
-            r = hue * 3;
-            g = 0;
-            b = 255 - hue * 3;
-        }
+uint32_t ws2812_encode_color(uint8_t r, uint8_t g, uint8_t b)
+{
+    return pack_pixel(luts, r, g, b);
+}
 
-        set_button_color(i, r, g, b);
-    }
+uint32_t ws2812_encode_color_with(const ws2812_luts_t *tables, uint8_t r, uint8_t g, uint8_t b)
+{
+    return pack_pixel(tables, r, g, b);
+}
+
+uint32_t ws2812_encode_grb(uint8_t r, uint8_t g, uint8_t b)
+{
+    return adjusted_rgb_to_grb(luts, r, g, b);
 }
 
-void pattern_black(uint t)
+void ws2812_encode_frame(uint start, const uint8_t *rgb, uint count)
 {
-    // 全黑模式
-    for (uint i = 0; i < NUM_PIXELS; ++i)
+    if (start >= NUM_PIXELS)
+        return;
+    if (count > NUM_PIXELS - start)
+        count = NUM_PIXELS - start;
+
+#if WS2812_DITHER
+    for (uint i = 0; i < count; i++, rgb += 3)
+    {
+        dither_set_rgb(start + i, rgb[0], rgb[1], rgb[2]);
+    }
+#else
+    ws2812_pixel_t *dst = pixel_buffer + start;
+    for (uint i = 0; i < count; i++, rgb += 3)
     {
-        set_button_color(i, 0,0,0);
+        dst[i] = pack_pixel(luts, rgb[0], rgb[1], rgb[2]);
     }
-}
\ No newline at end of file
+#endif
+}
+
+void ws2812_use_luts(const ws2812_luts_t *tables)
+{
+    // Under frame_lock no compact frame can start and latch the buffer
+    // being filled
+    uint32_t save = hal_lock_enter(frame_lock);
+    ws2812_luts_t *next = (frame_luts == &lut_buffers[0]) ? &lut_buffers[1] : &lut_buffers[0];
+    memcpy(next, tables, sizeof(*next));
+    luts = next;
+    hal_lock_exit(frame_lock, save);
+}
+
+void clear_pixels(void)
+{
+#if WS2812_DITHER
+    memset(dither_target, 0, sizeof(dither_target));
+#endif
+    memset(pixel_buffer, 0, NUM_PIXELS * sizeof(ws2812_pixel_t));
+}
+
+#if WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+void ws2812_set_palette(uint8_t index, uint8_t r, uint8_t g, uint8_t b)
+{
+    palette[index][0] = r;
+    palette[index][1] = g;
+    palette[index][2] = b;
+}
+#endif
+
@@ -1,47 +1,164 @@
 #ifndef WS2812_H
 #define WS2812_H
 
-#include "pico/stdlib.h"
-#include "hardware/pio.h"
-#include "hardware/dma.h"
-#include "hardware/irq.h"
-#include "ws2812.pio.h"
+#include "modules/hal/hal.h"
+#include "phac_board.h" // NUM_PIXELS, WS2812_PIN
 
-#ifndef NUM_PIXELS
-#define NUM_PIXELS 150
+// Output gamma; 1.0 keeps the linear response of the original encoder
+#ifndef WS2812_GAMMA
+#define WS2812_GAMMA 1.0f
 #endif
 
-#ifndef WS2812_PIN
-#define WS2812_PIN 11
+// Default per-channel full-scale calibration (255 = unscaled); raw HID
+// config command 0x08 changes it at run time
+#ifndef WS2812_CALIBRATION_R
+#define WS2812_CALIBRATION_R 255
+#endif
+#ifndef WS2812_CALIBRATION_G
+#define WS2812_CALIBRATION_G 255
+#endif
+#ifndef WS2812_CALIBRATION_B
+#define WS2812_CALIBRATION_B 255
+#endif
+
+// Framebuffer format. GRB32 keeps one pre-shifted GRB word per pixel that the
+// DMA sends as is. The compact formats store 16-bit RGB565 or 8-bit palette
+// indices and are expanded to GRB words in small chunks from the DMA IRQ,
+// with brightness, gamma and calibration applied during expansion. They save
+// 2 or 3 bytes per pixel per buffer, at the cost of a few hundred bytes of
+// staging and tables, so they pay off on long strips.
+#define WS2812_FORMAT_GRB32 0
+#define WS2812_FORMAT_RGB565 1
+#define WS2812_FORMAT_PALETTE8 2
+
+#ifndef WS2812_FORMAT
+#define WS2812_FORMAT WS2812_FORMAT_GRB32
+#endif
+
+#if WS2812_FORMAT == WS2812_FORMAT_RGB565
+typedef uint16_t ws2812_pixel_t;
+#elif WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+typedef uint8_t ws2812_pixel_t;
+#else
+typedef uint32_t ws2812_pixel_t;
+#endif
+
+#define WS2812_COMPACT (WS2812_FORMAT != WS2812_FORMAT_GRB32)
+
+// Pixels expanded per DMA chunk in the compact formats. The 8-word TX FIFO
+// covers 240us of output, far more than the IRQ needs to queue the next chunk.
+#ifndef WS2812_CHUNK_PIXELS
+#define WS2812_CHUNK_PIXELS 16
+#endif
+
+// Temporal dithering. Pixels keep 8.8 fixed-point channel values, and each
+// refresh sends the integer part plus the carry of an error accumulator. Low
+// brightness fades then average out between the 8-bit steps instead of
+// stepping. Requires the GRB32 format.
+#ifndef WS2812_DITHER
+#define WS2812_DITHER (!WS2812_COMPACT)
+#endif
+
+#if WS2812_DITHER && WS2812_COMPACT
+#error "WS2812_DITHER requires WS2812_FORMAT_GRB32"
+#endif
+
+// Dither refresh period: a full frame plus reset gap with some headroom,
+// and no faster than 400Hz
+#ifndef WS2812_DITHER_PERIOD_US
+#define WS2812_DITHER_PERIOD_US \
+    (NUM_PIXELS * WS2812_WORD_US + WS2812_RESET_US + 200 > 2500 ? NUM_PIXELS * WS2812_WORD_US + WS2812_RESET_US + 200 : 2500)
 #endif
 
 #ifndef UPDATE_INTERVAL_MS
 #define UPDATE_INTERVAL_MS 10
 #endif
 
+// WS2812 reset/latch gap. The datasheet minimum is 50us, but newer WS2812B
+// revisions need 280us; the gap is timed by an alarm so it costs no CPU.
+#ifndef WS2812_RESET_US
+#define WS2812_RESET_US 300
+#endif
+
+// One latch alarm per chain is outstanding at a time; ws2812_parallel
+// times its latch on the same pool
+#define WS2812_LATCH_ALARMS 2
+
+// Time to shift out one 24-bit pixel at 800kHz
+#define WS2812_WORD_US 30
+
+// Output tables with gamma, calibration and brightness folded in, so
+// encoding a pixel is three byte lookups. Built alongside each config
+// snapshot (remap) and copied in on the LED core by ws2812_use_luts(), so
+// they never change under a frame being encoded or expanded.
+typedef struct
+{
+    uint8_t channel[3][256]; // r, g, b
+#if WS2812_DITHER
+    uint16_t channel16[3][256]; // 8.8
+#endif
+#if WS2812_FORMAT == WS2812_FORMAT_RGB565
+    uint8_t r5[32];
+    uint8_t g6[64];
+    uint8_t b5[32];
+#endif
+} ws2812_luts_t;
+
 typedef enum
 {
-    DMA_IDLE,
-    DMA_TRANSFERRING,
-    DMA_COMPLETE
+    DMA_IDLE,         // Last frame latched, a new one starts on present
+    DMA_TRANSFERRING, // DMA feeding the PIO
+    DMA_COMPLETE      // DMA done, waiting for the PIO to drain and the reset gap
 } dma_state_t;
 
 void ws2812_init(void);
 void ws2812_cleanup(void);
 
 void set_button_color(uint index, uint8_t r, uint8_t g, uint8_t b);
-void ws2812_set_brightness(float brightness);
+// Encoded pixels are ws2812_pixel_t values carried in a uint32_t
+void set_button_word(uint index, uint32_t pixel);
+uint32_t ws2812_encode_color(uint8_t r, uint8_t g, uint8_t b);
+// Same encoding with tables that are not (yet) in use; any core
+uint32_t ws2812_encode_color_with(const ws2812_luts_t *tables, uint8_t r, uint8_t g, uint8_t b);
+// GRB << 8 through the current tables, whatever WS2812_FORMAT is; the word
+// format of ws2812_parallel
+uint32_t ws2812_encode_grb(uint8_t r, uint8_t g, uint8_t b);
+// cal_* is each channel's full scale, 255 = unscaled
+void ws2812_build_luts(ws2812_luts_t *tables, float brightness, uint8_t cal_r, uint8_t cal_g, uint8_t cal_b);
+// LED core: switch to a copy of tables, from the next encoded pixel or frame
+void ws2812_use_luts(const ws2812_luts_t *tables);
+void ws2812_encode_frame(uint start, const uint8_t *rgb, uint count);
 void clear_pixels(void);
 
-uint32_t *ws2812_get_buffer(void);
-void ws2812_update_buffer(void);
+#if WS2812_FORMAT == WS2812_FORMAT_PALETTE8
+// The default palette is RGB332, which is what ws2812_encode_color() packs to.
+// With a custom palette, write indices with set_button_word() instead.
+void ws2812_set_palette(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+#endif
+
+ws2812_pixel_t *ws2812_get_buffer(void);
+ws2812_pixel_t *ws2812_begin_frame(void);
+void ws2812_present(void);
+
+// Start a frame that only changes some pixels of the last presented one.
+// [start, start + count) must cover every pixel the front frame changed.
+// Returns true if the back buffer still held an unsent frame, which the
+// new one then replaces, so its changes carry over into the new frame.
+bool ws2812_begin_frame_delta(uint start, uint count);
+
+#if WS2812_DITHER
+// With dithering, drawing goes through set_button_color(), set_button_word()
+// and ws2812_encode_frame(), and ws2812_present() only marks the frame as
+// new. This pacer sends it, and keeps refreshing while any pixel has a
+// fractional part. Schedule it every WS2812_DITHER_PERIOD_US.
+void ws2812_dither_task(void);
+#endif
 
-void ws2812_start_transfer(void);
 bool ws2812_is_busy(void);
 dma_state_t ws2812_get_dma_state(void);
+// Latch alarm pool, on the core that called ws2812_init()
+hal_alarm_pool_t *ws2812_get_latch_pool(void);
 
-void pattern_rainbow(uint t);
-void pattern_black(uint t);
 
 
 #endif
\ No newline at end of file
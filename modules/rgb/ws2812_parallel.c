@@ -0,0 +1,210 @@
+#include "ws2812_parallel.h"
+#include "ws2812.h"
+#include <string.h>
+
+#define BITS_PER_PIXEL 24
+
+static hal_pio_sm_t pio_sm;
+static int dma_chan = -1;
+static uint strips;
+static uint pixels;
+static volatile dma_state_t dma_state = DMA_IDLE;
+
+// Unused strips stay zero, so every transpose works on a full 8x8 block
+static uint32_t strip_pixels[WS2812_PARALLEL_MAX_STRIPS][WS2812_PARALLEL_MAX_PIXELS];
+
+// One byte per bit time, double buffered like ws2812's frames
+static uint8_t plane_buffers[2][WS2812_PARALLEL_MAX_PIXELS * BITS_PER_PIXEL];
+static uint8_t *back_planes = plane_buffers[0];
+static uint8_t *front_planes = plane_buffers[1];
+static volatile bool frame_pending = false;
+static hal_lock_t *frame_lock; // Claimed once, kept across cleanup
+
+// Shared with ws2812, so a latch alarm can outlive cleanup; it only acts if
+// the generation it was queued in is still running
+static hal_alarm_pool_t *latch_pool;
+static volatile uint32_t generation;
+
+// 8x8 bit-matrix transpose on two 32-bit words (Hacker's Delight
+// transpose8rS32). Row r of the input becomes bit 7 - r of each output byte.
+static inline void transpose8(uint32_t *hi, uint32_t *lo)
+{
+    uint32_t x = *hi;
+    uint32_t y = *lo;
+    uint32_t t;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA;
+    x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA;
+    y = y ^ t ^ (t << 7);
+
+    t = (x ^ (x >> 14)) & 0x0000CCCC;
+    x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC;
+    y = y ^ t ^ (t << 14);
+
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+
+    *hi = t;
+    *lo = y;
+}
+
+// Turn one pixel row of all strips into 24 bytes, MSB of green first
+static void transpose_pixel(uint index, uint8_t *out)
+{
+    for (int shift = 24; shift >= 8; shift -= 8)
+    {
+        // Strip s goes into row 7 - s so it ends up on bit s (pin_base + s)
+        uint32_t hi = ((strip_pixels[7][index] >> shift & 0xFF) << 24) |
+                      ((strip_pixels[6][index] >> shift & 0xFF) << 16) |
+                      ((strip_pixels[5][index] >> shift & 0xFF) << 8) |
+                      (strip_pixels[4][index] >> shift & 0xFF);
+        uint32_t lo = ((strip_pixels[3][index] >> shift & 0xFF) << 24) |
+                      ((strip_pixels[2][index] >> shift & 0xFF) << 16) |
+                      ((strip_pixels[1][index] >> shift & 0xFF) << 8) |
+                      (strip_pixels[0][index] >> shift & 0xFF);
+
+        transpose8(&hi, &lo);
+
+        out[0] = hi >> 24;
+        out[1] = hi >> 16;
+        out[2] = hi >> 8;
+        out[3] = hi;
+        out[4] = lo >> 24;
+        out[5] = lo >> 16;
+        out[6] = lo >> 8;
+        out[7] = lo;
+        out += 8;
+    }
+}
+
+// Caller holds frame_lock; the strips have latched the previous frame
+static void HAL_RAM_FUNC(start_dma_if_ready)(void)
+{
+    if (frame_pending)
+    {
+        uint8_t *front = front_planes;
+        front_planes = back_planes;
+        back_planes = front;
+        frame_pending = false;
+
+        dma_state = DMA_TRANSFERRING;
+        hal_dma_byte_stream_start(dma_chan, front_planes, pixels * BITS_PER_PIXEL);
+    }
+    else
+    {
+        dma_state = DMA_IDLE;
+    }
+}
+
+static int64_t HAL_RAM_FUNC(latch_complete_callback)(hal_alarm_id_t id, void *user_data)
+{
+    (void)id;
+
+    hal_lock_enter_isr(frame_lock);
+    if ((uint32_t)(uintptr_t)user_data == generation && dma_chan >= 0)
+        start_dma_if_ready();
+    hal_lock_exit_isr(frame_lock);
+    return 0;
+}
+
+// DMA IRQ, once per frame; queues the latch alarm, so it runs from flash
+static void dma_complete_handler(uint chan)
+{
+    (void)chan;
+
+    // The FIFO still holds up to 8 bit times (plus one in the OSR), 1.25us each
+    uint queued = hal_pio_tx_level(&pio_sm) + 1;
+    uint32_t latch_us = (queued * 5 + 3) / 4 + WS2812_RESET_US;
+
+    hal_lock_enter_isr(frame_lock);
+    dma_state = DMA_COMPLETE;
+    hal_lock_exit_isr(frame_lock);
+
+    if (!hal_timeout_add(latch_pool, latch_us, latch_complete_callback, (void *)(uintptr_t)generation))
+    {
+        // No free alarm slot: fall back to the next present() starting it
+        hal_lock_enter_isr(frame_lock);
+        dma_state = DMA_IDLE;
+        hal_lock_exit_isr(frame_lock);
+    }
+}
+
+void ws2812_parallel_init(uint pin_base, uint strip_count, uint pixels_per_strip, hal_alarm_pool_t *pool)
+{
+    hal_assert(strip_count >= 1 && strip_count <= WS2812_PARALLEL_MAX_STRIPS);
+    hal_assert(pixels_per_strip <= WS2812_PARALLEL_MAX_PIXELS);
+
+    strips = strip_count;
+    pixels = pixels_per_strip;
+    memset(strip_pixels, 0, sizeof(strip_pixels));
+    memset(plane_buffers, 0, sizeof(plane_buffers));
+
+    bool success = hal_pio_ws2812_parallel_init(&pio_sm, pin_base, strip_count, 800000);
+    hal_assert(success);
+
+    if (!frame_lock)
+        frame_lock = hal_lock_claim();
+    latch_pool = pool;
+    generation++;
+
+    dma_chan = hal_dma_byte_stream_claim(&pio_sm, dma_complete_handler);
+}
+
+// Releases what init claimed, so init can run again
+void ws2812_parallel_cleanup(void)
+{
+    hal_dma_stream_release(dma_chan);
+
+    // A latch alarm still pending in the shared pool finds a new generation
+    uint32_t save = hal_lock_enter(frame_lock);
+    dma_chan = -1;
+    generation++;
+    dma_state = DMA_IDLE;
+    frame_pending = false;
+    hal_lock_exit(frame_lock, save);
+
+    hal_pio_ws2812_parallel_deinit(&pio_sm);
+}
+
+uint32_t *ws2812_parallel_get_strip(uint strip)
+{
+    return strip < strips ? strip_pixels[strip] : NULL;
+}
+
+void ws2812_parallel_set_pixel(uint strip, uint index, uint32_t grb)
+{
+    if (strip < strips && index < pixels)
+    {
+        strip_pixels[strip][index] = grb;
+    }
+}
+
+void ws2812_parallel_present(void)
+{
+    // The back buffer is never read by the DMA, so it can be filled unlocked;
+    // a frame still waiting to be swapped in is simply replaced
+    uint32_t save = hal_lock_enter(frame_lock);
+    frame_pending = false;
+    hal_lock_exit(frame_lock, save);
+
+    uint8_t *out = back_planes;
+    for (uint i = 0; i < pixels; i++, out += BITS_PER_PIXEL)
+    {
+        transpose_pixel(i, out);
+    }
+
+    save = hal_lock_enter(frame_lock);
+    frame_pending = true;
+    if (dma_state == DMA_IDLE)
+    {
+        start_dma_if_ready();
+    }
+    hal_lock_exit(frame_lock, save);
+}
+
+bool ws2812_parallel_is_busy(void)
+{
+    return dma_state != DMA_IDLE;
+}
@@ -0,0 +1,45 @@
+#ifndef WS2812_PARALLEL_H
+#define WS2812_PARALLEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/hal/hal.h"
+
+// Drives up to 8 WS2812 strips on consecutive pins from one state machine
+// running the ws2812_parallel program. Every strip shifts out at the same
+// time, so a frame takes as long as the longest strip instead of the sum.
+//
+// Each strip has its own buffer of pre-shifted GRB words (same format as
+// ws2812). ws2812_parallel_present() transposes them into one byte per bit
+// time (bit n = strip n), and the DMA feeds those bytes to the PIO. An 8-bit
+// DMA write replicates the byte across the FIFO word, and the program only
+// drives the low pin_count bits. The output buffers stay at 24 bytes per
+// pixel row, whatever the number of strips.
+//
+// Boards describe their strips with a "strips" entry in boards/*.json
+// (WS2812_STRIPS in phac_board.h); led_render starts the driver and the
+// effect engine draws the base animation on them.
+
+#define WS2812_PARALLEL_MAX_STRIPS 8
+
+#ifndef WS2812_PARALLEL_MAX_PIXELS
+#define WS2812_PARALLEL_MAX_PIXELS 64 // Per strip
+#endif
+
+// The DMA IRQ and latch_pool's callbacks must run on the same core; pass
+// ws2812_get_latch_pool() to share ws2812's pool instead of taking another
+// hardware alarm.
+void ws2812_parallel_init(uint pin_base, uint strip_count, uint pixels_per_strip, hal_alarm_pool_t *latch_pool);
+void ws2812_parallel_cleanup(void);
+
+// Pixel buffer of one strip; pixels_per_strip words of GRB << 8
+uint32_t *ws2812_parallel_get_strip(uint strip);
+void ws2812_parallel_set_pixel(uint strip, uint index, uint32_t grb);
+
+// Transpose the strip buffers into the back bit-plane buffer and queue it.
+// The DMA picks it up as soon as the previous frame has latched.
+void ws2812_parallel_present(void);
+
+bool ws2812_parallel_is_busy(void);
+
+#endif
@@ -0,0 +1,99 @@
+#include "sched.h"
+#include <string.h>
+
+void sched_init(Scheduler *sched)
+{
+    memset(sched, 0, sizeof(*sched));
+}
+
+int sched_add(Scheduler *sched, const char *name, sched_fn fn, void *ctx,
+              uint32_t period_us, uint8_t priority)
+{
+    if (sched->count >= SCHED_MAX_TASKS)
+        return -1;
+
+    int handle = sched->count;
+    SchedTask *task = &sched->tasks[handle];
+    task->name = name;
+    task->fn = fn;
+    task->ctx = ctx;
+    task->period_us = period_us;
+    task->priority = priority;
+    task->next_us = hal_time_us_64();
+
+    // Insert behind tasks of the same priority so equal tasks keep their order
+    int pos = sched->count;
+    while (pos > 0 && sched->tasks[sched->order[pos - 1]].priority > priority)
+    {
+        sched->order[pos] = sched->order[pos - 1];
+        pos--;
+    }
+    sched->order[pos] = (uint8_t)handle;
+    sched->count++;
+    return handle;
+}
+
+void sched_set_period(Scheduler *sched, int handle, uint32_t period_us)
+{
+    if (handle >= 0 && handle < sched->count)
+    {
+        sched->tasks[handle].period_us = period_us;
+    }
+}
+
+bool sched_run_once(Scheduler *sched, uint64_t now_us)
+{
+    for (int i = 0; i < sched->count; i++)
+    {
+        SchedTask *task = &sched->tasks[sched->order[i]];
+        if (now_us < task->next_us)
+            continue;
+
+        uint32_t start = hal_time_us_32();
+        task->fn(task->ctx);
+        uint32_t runtime = hal_time_us_32() - start;
+
+        task->runs++;
+        if (runtime > task->max_runtime_us)
+            task->max_runtime_us = runtime;
+
+        // Stay on the original grid unless a whole period was lost
+        task->next_us += task->period_us;
+        if (task->next_us <= now_us)
+        {
+            if (task->period_us)
+                task->misses++;
+            task->next_us = now_us + task->period_us;
+        }
+        return true;
+    }
+    return false;
+}
+
+void sched_run(Scheduler *sched)
+{
+    while (1)
+    {
+        uint64_t now = hal_time_us_64();
+        if (sched_run_once(sched, now))
+            continue;
+
+        uint64_t wake = UINT64_MAX;
+        for (int i = 0; i < sched->count; i++)
+        {
+            if (sched->tasks[i].next_us < wake)
+                wake = sched->tasks[i].next_us;
+        }
+
+        // Interrupts (USB, DMA, alarms) also end the wait early
+        sched->idle_count++;
+        hal_idle_until(wake);
+    }
+}
+
+const SchedTask *sched_get_task(const Scheduler *sched, int handle)
+{
+    if (handle < 0 || handle >= sched->count)
+        return NULL;
+    return &sched->tasks[handle];
+}
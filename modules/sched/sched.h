@@ -0,0 +1,59 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "modules/hal/hal.h"
+
+// Cooperative deadline scheduler. Each core runs its own instance. Tasks
+// run to completion. Whenever a task finishes, the highest priority task
+// that is due runs next, so cosmetic work never delays a due input or USB
+// task by more than one task body. When nothing is due the core sleeps in
+// WFE until the earliest deadline or an interrupt.
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 8
+#endif
+
+typedef void (*sched_fn)(void *ctx);
+
+typedef struct
+{
+    const char *name;
+    sched_fn fn;
+    void *ctx;
+    uint32_t period_us;
+    uint8_t priority; // 0 is most urgent
+    uint64_t next_us;
+
+    uint32_t runs;
+    uint32_t misses;         // Started a full period or more after its deadline
+    uint32_t max_runtime_us;
+} SchedTask;
+
+typedef struct
+{
+    SchedTask tasks[SCHED_MAX_TASKS]; // Indexed by handle
+    uint8_t order[SCHED_MAX_TASKS];   // Handles sorted by priority
+    uint8_t count;
+    uint32_t idle_count; // Times the core went to sleep
+} Scheduler;
+
+void sched_init(Scheduler *sched);
+
+// Returns a task handle, or -1 if the table is full
+int sched_add(Scheduler *sched, const char *name, sched_fn fn, void *ctx,
+              uint32_t period_us, uint8_t priority);
+
+// Takes effect after the task's next run
+void sched_set_period(Scheduler *sched, int handle, uint32_t period_us);
+
+// Run the most urgent due task; false if nothing was due
+bool sched_run_once(Scheduler *sched, uint64_t now_us);
+
+// Never returns
+void sched_run(Scheduler *sched);
+
+const SchedTask *sched_get_task(const Scheduler *sched, int handle);
+
+#endif
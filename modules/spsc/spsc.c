@@ -0,0 +1,48 @@
+#include "spsc.h"
+#include <string.h>
+#include "modules/hal/hal.h"
+
+void spsc_init(SpscRing *ring, void *storage, uint16_t elem_size, uint32_t capacity)
+{
+    // Capacity must be a power of two so the free-running indices wrap cleanly
+    hal_assert(capacity && !(capacity & (capacity - 1)));
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->storage = storage;
+    ring->dropped = 0;
+}
+
+bool HAL_RAM_FUNC(spsc_push)(SpscRing *ring, const void *elem)
+{
+    uint32_t head = ring->head;
+    if (head - ring->tail > ring->mask)
+    {
+        ring->dropped++;
+        return false;
+    }
+
+    memcpy(ring->storage + (head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+
+    // Payload must be visible before the consumer can see the new head
+    hal_fence_release();
+    ring->head = head + 1;
+    return true;
+}
+
+bool HAL_RAM_FUNC(spsc_pop)(SpscRing *ring, void *elem)
+{
+    uint32_t tail = ring->tail;
+    if (tail == ring->head)
+        return false;
+
+    hal_fence_acquire();
+    memcpy(elem, ring->storage + (tail & ring->mask) * ring->elem_size, ring->elem_size);
+
+    // Finish reading the slot before handing it back to the producer
+    hal_fence_release();
+    ring->tail = tail + 1;
+    return true;
+}
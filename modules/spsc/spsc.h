@@ -0,0 +1,42 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Lock-free single-producer/single-consumer ring for passing fixed-size
+// messages between the two cores (or a core and its own IRQ). head is only
+// written by the producer and tail only by the consumer; the memory fences
+// order the payload copy against the index update.
+
+typedef struct
+{
+    volatile uint32_t head; // Free-running write index
+    volatile uint32_t tail; // Free-running read index
+    uint32_t mask;          // capacity - 1, capacity is a power of two
+    uint16_t elem_size;
+    uint8_t *storage;
+    volatile uint32_t dropped; // Pushes rejected because the ring was full
+} SpscRing;
+
+// storage must hold capacity * elem_size bytes
+void spsc_init(SpscRing *ring, void *storage, uint16_t elem_size, uint32_t capacity);
+
+// Producer side; returns false (and counts a drop) when full
+bool spsc_push(SpscRing *ring, const void *elem);
+
+// Consumer side; returns false when empty
+bool spsc_pop(SpscRing *ring, void *elem);
+
+static inline uint32_t spsc_count(const SpscRing *ring)
+{
+    return ring->head - ring->tail;
+}
+
+static inline bool spsc_empty(const SpscRing *ring)
+{
+    return ring->head == ring->tail;
+}
+
+#endif
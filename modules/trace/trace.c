@@ -0,0 +1,110 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include <stdio.h>
+#include "modules/hal/hal.h"
+#include "modules/spsc/spsc.h"
+#include "modules/be/be.h"
+
+#define TRACE_CORES 2
+
+static TraceRecord storage[TRACE_CORES][TRACE_RECORDS];
+
+// Set up statically so events from before main() reaches any init call
+// still land somewhere. Producer: the owning core; consumer: core 0.
+static SpscRing rings[TRACE_CORES] = {
+    {.mask = TRACE_RECORDS - 1, .elem_size = sizeof(TraceRecord), .storage = (uint8_t *)storage[0]},
+    {.mask = TRACE_RECORDS - 1, .elem_size = sizeof(TraceRecord), .storage = (uint8_t *)storage[1]},
+};
+
+_Static_assert((TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "TRACE_RECORDS must be a power of two");
+
+void HAL_RAM_FUNC(trace_event)(TraceEvent event, uint16_t arg0, uint32_t arg1)
+{
+    uint core = hal_core_num();
+
+    // Thread and IRQ code on this core share the producer side; stamp the
+    // time inside so each ring stays in time order
+    uint32_t save = hal_irq_save();
+    TraceRecord record = {
+        .timestamp_us = hal_time_us_32(),
+        .event = event,
+        .core = (uint8_t)core,
+        .arg0 = arg0,
+        .arg1 = arg1};
+    spsc_push(&rings[core], &record);
+    hal_irq_restore(save);
+}
+
+static bool pop(TraceRecord *record)
+{
+    for (int core = 0; core < TRACE_CORES; core++)
+    {
+        if (spsc_pop(&rings[core], record))
+            return true;
+    }
+    return false;
+}
+
+size_t trace_write_report(const uint8_t *request, size_t len, uint8_t *buffer, size_t max_len)
+{
+    const size_t status_len = 2 + TRACE_CORES * (2 + 4);
+    if (len < 2 || max_len < status_len)
+        return 0;
+
+    uint8_t *p = buffer;
+    *p++ = TRACE_COMMAND;
+    *p++ = request[1];
+
+    switch (request[1])
+    {
+    case 0x01:
+    {
+        size_t room = (max_len - 3) / TRACE_RECORD_SIZE;
+        uint8_t *count = p++;
+        TraceRecord record;
+        size_t n = 0;
+        for (; n < room && pop(&record); n++, p += TRACE_RECORD_SIZE)
+            trace_encode(&record, p);
+        *count = (uint8_t)n;
+        return (size_t)(p - buffer);
+    }
+    case 0x02:
+    {
+        TraceRecord record;
+        while (pop(&record))
+            ;
+        break;
+    }
+    default:
+        break;
+    }
+
+    for (int core = 0; core < TRACE_CORES; core++)
+    {
+        uint32_t pending = spsc_count(&rings[core]);
+        p = put_be16(p, pending > 0xFFFF ? 0xFFFF : (uint16_t)pending);
+    }
+    for (int core = 0; core < TRACE_CORES; core++)
+        p = put_be32(p, rings[core].dropped);
+    return (size_t)(p - buffer);
+}
+
+void trace_print(uint32_t max)
+{
+    TraceRecord record;
+    for (uint32_t i = 0; i < max && pop(&record); i++)
+    {
+        uint8_t bytes[TRACE_RECORD_SIZE];
+        trace_encode(&record, bytes);
+
+        char line[sizeof("trace ") + 2 * TRACE_RECORD_SIZE];
+        int pos = snprintf(line, sizeof(line), "trace ");
+        for (int b = 0; b < TRACE_RECORD_SIZE; b++)
+            pos += snprintf(line + pos, sizeof(line) - pos, "%02x", bytes[b]);
+        puts(line);
+    }
+}
+
+#endif
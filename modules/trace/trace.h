@@ -0,0 +1,105 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "trace_ids.h"
+
+// Binary event tracer. TRACE_EVENT() stamps a fixed-size record (event,
+// core, two arguments, us timestamp) into a RAM ring from thread or IRQ
+// context on either core. Each core has its own ring and only masks its own
+// interrupts for the push, so the cores never wait on each other; core 0
+// drains both. A full ring drops new events and counts them. Records leave
+// over raw HID (0x87) or, with TRACE_UART 1, as "trace <hex>" lines on
+// stdio, and host/phac_trace.c turns either into Chrome/Perfetto trace JSON.
+// With TRACE_ENABLE 0 every trace point compiles to nothing.
+//
+// Raw HID 0x87, sub-command:
+//   0x00 status -> [0x87, 0x00, pending (BE16) x2, dropped (BE32) x2], core 0 first
+//   0x01 read   -> [0x87, 0x01, n, n records]; removes them, core 0 before core 1
+//   0x02 clear  -> status, after discarding every pending record
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+// Per core, a power of two
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS 512 // 6KB per core
+#endif
+
+// UART drain: up to TRACE_UART_BATCH records every TRACE_UART_MS. stdio
+// blocks on the UART unless LOG_ENABLE routes it through the DMA log, so
+// otherwise prefer raw HID when timing matters.
+#ifndef TRACE_UART
+#define TRACE_UART 0
+#endif
+
+#ifndef TRACE_UART_MS
+#define TRACE_UART_MS 50
+#endif
+
+#ifndef TRACE_UART_BATCH
+#define TRACE_UART_BATCH 8
+#endif
+
+#define TRACE_COMMAND 0x87
+#define TRACE_RECORD_SIZE 12
+
+typedef struct
+{
+    uint32_t timestamp_us; // hal_time_us_32(), wraps every ~71 minutes
+    uint8_t event;         // TraceEvent
+    uint8_t core;
+    uint16_t arg0;
+    uint32_t arg1;
+} TraceRecord;
+
+// Wire format of one record: timestamp (BE32), event, core, arg0 (BE16),
+// arg1 (BE32). Shared with the host tools.
+static inline void trace_encode(const TraceRecord *record, uint8_t *p)
+{
+    p[0] = record->timestamp_us >> 24;
+    p[1] = record->timestamp_us >> 16;
+    p[2] = record->timestamp_us >> 8;
+    p[3] = record->timestamp_us;
+    p[4] = record->event;
+    p[5] = record->core;
+    p[6] = record->arg0 >> 8;
+    p[7] = record->arg0;
+    p[8] = record->arg1 >> 24;
+    p[9] = record->arg1 >> 16;
+    p[10] = record->arg1 >> 8;
+    p[11] = record->arg1;
+}
+
+static inline void trace_decode(const uint8_t *p, TraceRecord *record)
+{
+    record->timestamp_us = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    record->event = p[4];
+    record->core = p[5];
+    record->arg0 = (uint16_t)((p[6] << 8) | p[7]);
+    record->arg1 = ((uint32_t)p[8] << 24) | ((uint32_t)p[9] << 16) | ((uint32_t)p[10] << 8) | p[11];
+}
+
+#if TRACE_ENABLE
+
+// Any core, thread or IRQ context
+void trace_event(TraceEvent event, uint16_t arg0, uint32_t arg1);
+
+// Core 0: handles a 0x87 raw HID request; returns reply bytes written
+size_t trace_write_report(const uint8_t *request, size_t len, uint8_t *buffer, size_t max_len);
+
+// Core 0: prints up to max pending records as "trace <hex>" lines
+void trace_print(uint32_t max);
+
+#define TRACE_EVENT(id, arg0, arg1) trace_event(TRACE_##id, (uint16_t)(arg0), (uint32_t)(arg1))
+
+#else
+
+#define TRACE_EVENT(id, arg0, arg1) ((void)0)
+
+#endif
+
+#endif
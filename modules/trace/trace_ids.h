@@ -0,0 +1,26 @@
+#ifndef TRACE_IDS_H
+#define TRACE_IDS_H
+
+// Trace events: X(id, name, phase, arg0, arg1). phase is the Chrome trace
+// phase the host decoder emits: 'i' instant, 'b'/'e' begin/end of a span
+// matched by name and arg0. Argument names are NULL when unused. Shared with
+// the host tools, so new events go at the end to keep the numbering stable.
+#define TRACE_EVENTS(X)                                          \
+    X(DEBOUNCE, "debounce", 'i', "button", "pressed")            \
+    X(ENCODER, "encoder", 'i', "pin_a", "delta")                 \
+    X(REPORT_QUEUED, "report", 'b', "itf", NULL)                 \
+    X(REPORT_DONE, "report", 'e', "itf", "len")                  \
+    X(LED_DMA_START, "led_dma", 'b', "chan", "words")            \
+    X(LED_DMA_DONE, "led_dma", 'e', "chan", NULL)                \
+    X(FLASH_WRITE_BEGIN, "flash_write", 'b', NULL, "offset")     \
+    X(FLASH_WRITE_END, "flash_write", 'e', NULL, NULL)
+
+typedef enum
+{
+#define TRACE_ID_ENUM(id, name, phase, arg0, arg1) TRACE_##id,
+    TRACE_EVENTS(TRACE_ID_ENUM)
+#undef TRACE_ID_ENUM
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+#endif
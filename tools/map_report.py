@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""Placement report from the linker map (PHAC-Firmware.elf.map).
+
+Lists the code placed in SRAM with HAL_RAM_FUNC (.time_critical.phac.*),
+the rest of the SRAM-resident code, the largest functions still executing
+from flash, and totals per region. Run through the map_report build target:
+
+    cmake --build build --target map_report
+
+RAM code is also kept in flash as its load image; only its run address
+counts here.
+
+With --footprint, prints flash and RAM use per module instead (the
+mem_report target). There the flash column does include the load images
+of .data and RAM code, and the stack and heap reservations from crt0 are
+listed on their own line.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+FLASH = (0x10000000, 0x11000000)
+SRAM = (0x20000000, 0x20042000)
+
+# RP2040 with the 2MB W25Q16 on the board
+FLASH_SIZE = 2 * 1024 * 1024
+SRAM_SIZE = 264 * 1024
+
+RAM_PREFIX = ".time_critical.phac."
+
+SECTION_ONLY = re.compile(r"^ (\.\S+|COMMON)\s*$")
+SECTION_FULL = re.compile(r"^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$")
+SECTION_REST = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$")
+
+
+def region(address):
+    if FLASH[0] <= address < FLASH[1]:
+        return "flash"
+    if SRAM[0] <= address < SRAM[1]:
+        return "sram"
+    return None
+
+
+def object_name(path):
+    # libfoo.a(bar.c.obj) -> bar.c, .../debounce.c.obj -> debounce.c
+    member = re.search(r"\(([^)]+)\)$", path)
+    name = os.path.basename(member.group(1) if member else path)
+    return re.sub(r"\.(obj|o)$", "", name)
+
+
+def parse(path):
+    """Yields (section, address, size, object) for every input section."""
+    with open(path) as f:
+        lines = iter(f.read().split("\n"))
+
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            break
+
+    pending = None
+    for line in lines:
+        if pending:
+            m = SECTION_REST.match(line)
+            if m:
+                yield pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3).strip()
+            pending = None
+            continue
+
+        m = SECTION_FULL.match(line)
+        if m:
+            yield m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4).strip()
+            continue
+        m = SECTION_ONLY.match(line)
+        if m:
+            pending = m.group(1)
+
+
+def kind(section):
+    if section.startswith(".time_critical"):
+        return "code"
+    if section == "COMMON":
+        return "bss"
+    if section.startswith((".stack", ".heap")):
+        # .stack, .stack1, .heap: reservations from crt0
+        return "reserve"
+    for prefix, name in ((".text", "code"), (".rodata", "rodata"), (".data", "data"), (".bss", "bss")):
+        if section == prefix or section.startswith(prefix + "."):
+            return name
+    return "other"
+
+
+def module_name(path):
+    # Firmware objects keep their source path under PHAC-Firmware.dir; the
+    # SDK and TinyUSB sources are compiled into the same target
+    path = path.replace("\\", "/")
+    if "tinyusb" in path:
+        return "tinyusb"
+    if "pico-sdk" in path or "/sdk/" in path or "libpico_" in path or "crt0" in path:
+        return "sdk"
+    if re.search(r"lib(c|g|gcc|m|nosys|stdc\+\+)\.a\(|/arm-none-eabi/", path):
+        return "toolchain"
+    m = re.search(r"/modules/([^/]+)/", path)
+    if m:
+        return m.group(1)
+    if re.search(r"(^|/)main\.c\.(obj|o)$", path):
+        return "main"
+    return "other"
+
+
+def print_footprint(sections):
+    modules = {}
+    reserve = 0
+    for section, address, size, obj in sections:
+        k = kind(section)
+        if k == "reserve":
+            reserve += size
+            continue
+        row = modules.setdefault(module_name(obj), [0, 0])
+        if region(address) == "flash":
+            row[0] += size
+        elif k != "bss":
+            # .data and RAM code occupy SRAM and also load from flash
+            row[0] += size
+            row[1] += size
+        else:
+            row[1] += size
+
+    print("  %-14s %9s %9s" % ("module", "flash", "ram"))
+    for name, (flash, ram) in sorted(modules.items(), key=lambda m: -(m[1][0] + m[1][1])):
+        print("  %-14s %9d %9d" % (name, flash, ram))
+    print("  %-14s %9s %9d" % ("stack + heap", "", reserve))
+
+    flash = sum(m[0] for m in modules.values())
+    ram = sum(m[1] for m in modules.values()) + reserve
+    print("  %-14s %9d %9d" % ("total", flash, ram))
+    print("  %-14s %8.1f%% %8.1f%%" % ("of device", 100.0 * flash / FLASH_SIZE, 100.0 * ram / SRAM_SIZE))
+
+
+def function_name(section):
+    for prefix in (RAM_PREFIX, ".time_critical.", ".text."):
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return section
+
+
+def print_table(title, rows):
+    print(title)
+    if not rows:
+        print("  (none)")
+        print()
+        return
+    print("  %-10s %7s  %-36s %s" % ("address", "size", "function", "object"))
+    for section, address, size, obj in rows:
+        print("  0x%08x %7d  %-36s %s" % (address, size, function_name(section), object_name(obj)))
+    print("  %-10s %7d bytes" % ("total", sum(r[2] for r in rows)))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--top", type=int, default=20, help="largest flash functions to list")
+    parser.add_argument("--footprint", action="store_true", help="flash and RAM use per module")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.map):
+        sys.exit("map_report: %s not found (is the firmware built?)" % args.map)
+
+    sections = [s for s in parse(args.map) if s[2] > 0 and region(s[1])]
+
+    if args.footprint:
+        print("Memory footprint (bytes): %s" % args.map)
+        print()
+        print_footprint(sections)
+        return
+
+    ours = [s for s in sections if s[0].startswith(RAM_PREFIX)]
+    other_ram = [s for s in sections
+                 if kind(s[0]) == "code" and region(s[1]) == "sram" and not s[0].startswith(RAM_PREFIX)]
+    flash_code = [s for s in sections if kind(s[0]) == "code" and region(s[1]) == "flash"]
+
+    print("Placement report: %s" % args.map)
+    print()
+    print_table("Code in SRAM via HAL_RAM_FUNC (.time_critical.phac.*)", sorted(ours, key=lambda s: s[1]))
+    print_table("Other code in SRAM (SDK)", sorted(other_ram, key=lambda s: -s[2]))
+    print_table("Largest code in flash (top %d)" % args.top, sorted(flash_code, key=lambda s: -s[2])[:args.top])
+
+    print("Totals (bytes)")
+    for name, reg, k in (("flash code", "flash", "code"), ("flash rodata", "flash", "rodata"),
+                         ("sram code", "sram", "code"), ("sram data", "sram", "data"),
+                         ("sram bss", "sram", "bss")):
+        total = sum(s[2] for s in sections if region(s[1]) == reg and kind(s[0]) == k)
+        print("  %-14s %8d" % (name, total))
+
+
+if __name__ == "__main__":
+    main()